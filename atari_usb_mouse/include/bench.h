@@ -0,0 +1,19 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+
+/**
+ * Runs the micro and macro benchmarks of the event pipeline.
+ *
+ * GPIO writes are stubbed out by the null output backend. Results are
+ * printed on stdout as one JSON object per benchmark. Allocation and
+ * syscall counts are only available in the binary built by `make bench`,
+ * which wraps the relevant libc entry points at link time.
+ *
+ * @param replay_file Optional event recording used as macrobenchmark input (may be NULL).
+ * @return 0 on success, -1 on failure.
+ */
+int run_benchmarks(const char *replay_file);
+
+
+#endif // BENCH_H
\ No newline at end of file
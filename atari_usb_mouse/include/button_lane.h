@@ -0,0 +1,51 @@
+#ifndef BUTTON_LANE_H
+#define BUTTON_LANE_H
+
+
+#include <linux/input.h>
+
+#include "gpio_control.h"
+
+
+// Events read ahead while a pulse train is in flight
+#define BUTTON_LANE_QUEUE_SIZE 256
+
+
+/**
+ * Attaches the button lane to the input device.
+ *
+ * While attached, the waits between the edges of a pulse train watch the
+ * device: a button event is applied at once when no motion read before it
+ * is queued, any other event is queued for the event loop in arrival
+ * order. Button transitions thus come after the steps already emitted and
+ * before the remaining ones, and never overtake motion read ahead.
+ *
+ * @param fd    Input device file descriptor, -1 to detach (drops queued events).
+ * @param state Quadrature state passed to process_mouse_event().
+ */
+void button_lane_attach(int fd, quadrature_state_t *state);
+
+/**
+ * Tells whether the button lane watches an input device.
+ *
+ * @return 1 if attached, 0 otherwise.
+ */
+int button_lane_active(void);
+
+/**
+ * Waits between two edges while servicing button events.
+ *
+ * @param delay_us Delay in microseconds.
+ */
+void button_lane_wait(int delay_us);
+
+/**
+ * Takes the oldest event read ahead during a pulse train.
+ *
+ * @param ie Receives the event.
+ * @return 1 if an event was returned, 0 if the queue is empty.
+ */
+int button_lane_pop(struct input_event *ie);
+
+
+#endif // BUTTON_LANE_H
\ No newline at end of file
@@ -0,0 +1,79 @@
+#ifndef CALIBRATE_H
+#define CALIBRATE_H
+
+
+#include "config.h"
+#include "gpio_control.h"
+
+
+// Name of the curve holding the calibrated edge periods
+#define CALIBRATED_CURVE_NAME "calibrated"
+
+// Number of line writes and of sleeps measured
+#define CALIBRATE_WRITES 2000
+#define CALIBRATE_SLEEPS 1000
+
+// Shortest level the IKBD must see, in IKBD samples
+#define CALIBRATE_LEVEL_SAMPLES 2
+
+// Added to the sleep overshoot to size the precision spin window (in microseconds)
+#define CALIBRATE_SPIN_MARGIN_US 20
+
+
+/**
+ * Measurements of the output path and the parameters derived from them.
+ */
+typedef struct {
+	unsigned int write_p50_us;	// Cost of one line write
+	unsigned int write_p99_us;
+	unsigned int sleep_min_us;	// Overshoot of the sleep between two edges
+	unsigned int sleep_p50_us;
+	unsigned int sleep_p99_us;
+	int min_delay_us;		// Edge period of the fastest trains
+	int max_delay_us;		// Edge period of the slowest trains
+	int spin_us;			// Busy-wait window of the precision emitter
+} calibration_t;
+
+
+/**
+ * Measures line writes on the active output backend and the sleep
+ * overshoot of the kernel, then derives the edge period bounds.
+ *
+ * The X lines are toggled back and forth, so the ST may see the cursor
+ * jitter by one count while this runs (about a second).
+ *
+ * @param state Current quadrature state, restored on return.
+ * @param cal   Receives the measurements and derived parameters.
+ * @return 0 on success, -1 if the output is not initialized.
+ */
+int calibrate_measure(quadrature_state_t *state, calibration_t *cal);
+
+/**
+ * Installs the calibrated curve in a configuration and selects it. The
+ * gain table of the previously active curve is kept.
+ *
+ * @param cal Calibration results.
+ * @param cfg Configuration to update.
+ * @return 0 on success, -1 if the curve cannot be built.
+ */
+int calibrate_apply(const calibration_t *cal, config_t *cfg);
+
+/**
+ * Writes the calibrated curve, its selection, the spin window and the
+ * measurements to a JSON configuration file, keeping its other settings.
+ *
+ * @param cal         Calibration results.
+ * @param config_path Configuration file, created if missing.
+ * @return 0 on success, -1 on failure.
+ */
+int calibrate_save(const calibration_t *cal, const char *config_path);
+
+/**
+ * Prints the measurements and derived parameters.
+ *
+ * @param cal Calibration results.
+ */
+void calibrate_print(const calibration_t *cal);
+
+
+#endif // CALIBRATE_H
\ No newline at end of file
@@ -2,6 +2,113 @@
 #define CONFIG_H
 
 
+#include "curve.h"
+
+
+// Additional outputs driven by the same process
+#define MAX_OUTPUTS 4
+
+// Lines of the joystick output: up, down, left, right, fire
+#define JOYSTICK_LINES 5
+
+// Stages of the motion filter chain
+#define MAX_FILTERS 8
+
+// Device profiles
+#define MAX_PROFILES 8
+
+// Output pacing modes
+enum {
+	PACING_BURST = 0,	// Each event's pulse train is emitted as soon as it arrives
+	PACING_TICK = 1,	// A fixed-rate ticker emits at most one step per axis per tick
+	PACING_FRAME = 2	// Each frame's steps are spread over the input frame interval
+};
+
+// Motion filter stages
+enum {
+	FILTER_INVERT = 0,	// Negates the axes in axes
+	FILTER_SWAP = 1,	// Exchanges X and Y
+	FILTER_DEADZONE = 2,	// Drops frames moving at most value counts on both axes
+	FILTER_SMOOTH = 3,	// Moving average, value = weight of the new frame in percent
+	FILTER_CURVE = 4,	// Gain of the active curve and sensitivity
+	FILTER_RATE_CAP = 5	// Clamps each axis to value counts per millisecond
+};
+
+/**
+ * One stage of the motion filter chain.
+ *
+ * - stage: FILTER_* type
+ * - axes: axes the stage applies to (bit 0 = X, bit 1 = Y)
+ * - value: parameter of the stage, see FILTER_*
+ */
+typedef struct {
+	int stage;
+	int axes;
+	int value;
+} filter_config_t;
+
+/**
+ * Settings applied while a matching input device is connected, resolved
+ * when the configuration is loaded.
+ *
+ * - key: profile key as written in the configuration
+ * - vendor, product: USB ids the device must have (-1 = not matched on ids)
+ * - pattern: shell pattern the device name must match (empty = not matched on name)
+ * - sensitivity, curve_index, pacing, tick_us: replace the top-level ones (-1 = kept)
+ * - filters: motion filter chain of the profile (num_filters = -1: the top-level one)
+ */
+typedef struct {
+	char key[64];
+	int vendor;
+	int product;
+	char pattern[64];
+	int sensitivity;
+	int curve_index;
+	int pacing;
+	int tick_us;
+	filter_config_t filters[MAX_FILTERS];
+	int num_filters;
+} profile_config_t;
+
+/**
+ * An additional output: its own lines, input device and timing.
+ *
+ * - name: label used in logs and statistics
+ * - gpio_chip: GPIO chip device driving the lines
+ * - pins: GPIO pins in line order (xa, xb, ya, yb, left_button, right_button)
+ * - device_path: input device bound to this output
+ * - sensitivity: sensitivity factor applied to its movement
+ * - curve_index: curve used for its gain
+ * - tick_us: period of its fixed-rate output
+ * - cpu: CPU its worker thread is pinned to (-1 = none)
+ */
+typedef struct {
+	char name[32];
+	char gpio_chip[64];
+	int pins[6];
+	char device_path[256];
+	int sensitivity;
+	int curve_index;
+	int tick_us;
+	int cpu;
+} output_config_t;
+
+/**
+ * The joystick output: a gamepad driving the direction and fire lines of
+ * a joystick port.
+ *
+ * - device_path: gamepad input device (empty = no joystick output)
+ * - gpio_chip: GPIO chip device driving the lines
+ * - pins: GPIO pins in line order (up, down, left, right, fire)
+ * - threshold: stick deflection, in percent of its travel from the centre, that closes a direction
+ */
+typedef struct {
+	char device_path[256];
+	char gpio_chip[64];
+	int pins[JOYSTICK_LINES];
+	int threshold;
+} joystick_config_t;
+
 /**
  * Structure holding the configuration for the program.
  *
@@ -11,6 +118,24 @@
  * - pin_right_button: GPIO pin for the right mouse button.
  * - sensitivity: sensitivity factor applied to mouse movement.
  * - device_path: path to the input device
+ * - gpio_chip: path to the GPIO chip device driving the lines
+ * - curves: named gain/period curves, the built-in one at index 0
+ * - curve_index: curve used for the output
+ * - pacing: output pacing mode (PACING_BURST, PACING_TICK or PACING_FRAME)
+ * - tick_us: tick period of the PACING_TICK mode
+ * - precision: 1 to drive edges with the sleep-then-spin emitter
+ * - spin_us: busy-wait window of the precision emitter before each edge
+ * - precision_cpu: CPU the precision emitter is pinned to (-1 = none)
+ * - calibrate_at_startup: 1 to measure the output path and use the calibrated curve
+ * - control_socket: path of the control socket (empty = disabled)
+ * - stall_us: time a pipeline stage may stay busy without progress (0 = no stall detection)
+ * - outputs: additional outputs, each with its own worker thread
+ * - remote_listen: UDP address receiving the mouse input instead of a device (empty = local device)
+ * - remote_button_timeout_ms: silence of the remote sender after which held buttons are released
+ * - ikbd_device: serial device of the IKBD output backend (--output ikbd)
+ * - joystick: gamepad driving a joystick port
+ * - filters: motion filter chain run on every frame (num_filters = -1: gain applied per event)
+ * - profiles: settings of specific mice, picked when the device is opened
  */
 typedef struct {
 	int pin_xa;
@@ -21,6 +146,28 @@ typedef struct {
 	int pin_right_button;
 	int sensitivity;
 	char device_path[256];
+	char gpio_chip[64];
+	curve_t curves[MAX_CURVES];
+	int num_curves;
+	int curve_index;
+	int pacing;
+	int tick_us;
+	int precision;
+	int spin_us;
+	int precision_cpu;
+	int calibrate_at_startup;
+	char control_socket[108];
+	int stall_us;
+	output_config_t outputs[MAX_OUTPUTS];
+	int num_outputs;
+	char remote_listen[64];
+	int remote_button_timeout_ms;
+	char ikbd_device[64];
+	joystick_config_t joystick;
+	filter_config_t filters[MAX_FILTERS];
+	int num_filters;
+	profile_config_t profiles[MAX_PROFILES];
+	int num_profiles;
 } config_t;
 
 
@@ -39,6 +186,46 @@ typedef struct {
  */
 int load_config(const char *config_path, config_t *cfg);
 
+/**
+ * Finds a curve by name.
+ *
+ * @param cfg  Configuration holding the curves.
+ * @param name Curve name.
+ * @return Index of the curve in cfg->curves, or -1 if it does not exist.
+ */
+int find_curve(const config_t *cfg, const char *name);
+
+/**
+ * Finds the profile of an input device. A profile keyed by USB ids wins
+ * over one keyed by a name pattern; among the same kind, the first one in
+ * the configuration wins.
+ *
+ * @param cfg     Configuration holding the profiles.
+ * @param vendor  USB vendor id of the device.
+ * @param product USB product id of the device.
+ * @param name    Name of the device.
+ * @return Index of the profile in cfg->profiles, or -1 if none matches.
+ */
+int find_profile(const config_t *cfg, int vendor, int product, const char *name);
+
+/**
+ * Returns the PACING_* value of a pacing mode name.
+ *
+ * @param name "burst", "tick" or "frame".
+ * @return Pacing mode, or -1 if the name is unknown.
+ */
+int parse_pacing(const char *name);
+
+/**
+ * Returns the name of a PACING_* value.
+ */
+const char *pacing_name(int pacing);
+
+/**
+ * Returns the name of a FILTER_* value, as written in the configuration.
+ */
+const char *filter_name(int stage);
+
 /**
  * Prints the current configuration to stdout.
  */
@@ -55,5 +242,12 @@ extern const config_t default_config;
  */
 extern config_t config;
 
+/**
+ * Returns the curve used for the output.
+ */
+static inline const curve_t *active_curve(void) {
+	return &config.curves[config.curve_index];
+}
+
 
 #endif // CONFIG_H
\ No newline at end of file
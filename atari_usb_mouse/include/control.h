@@ -0,0 +1,76 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+
+#include <sys/select.h>
+
+#include "config.h"
+
+
+// Clients served at the same time
+#define CONTROL_MAX_CLIENTS 4
+
+// Longest command line accepted
+#define CONTROL_LINE_SIZE 128
+
+// Permissions of the socket file: commands retune the daemon, only its owner may connect
+#define CONTROL_SOCKET_MODE 0600
+
+
+/**
+ * Callback publishing a modified configuration to the running pipeline.
+ *
+ * @param next Configuration to publish.
+ * @param ctx  Opaque pointer passed to control_service().
+ */
+typedef void (*control_publish_t)(config_t *next, void *ctx);
+
+
+/**
+ * Opens the control socket. Commands are one per line:
+ *
+ *   get PARAM            prints a live parameter
+ *   set PARAM VALUE...   changes it from the next frame
+ *   status               prints the output state, latencies and input counters
+ *   outputs              prints the statistics of the additional outputs
+ *   joystick             prints the state and line latency of the joystick output
+ *   reset                clears the latency counters
+ *   help                 lists commands and parameters
+ *
+ * Parameters: sensitivity, gain, curve, period, pacing, tick_us, log.
+ * Every command gets one line back, starting with "ok" or "error". The
+ * socket file gets CONTROL_SOCKET_MODE whatever the umask.
+ *
+ * @param path Filesystem path of the Unix-domain socket (replaced if stale).
+ * @return 0 on success, -1 on failure.
+ */
+int control_init(const char *path);
+
+/**
+ * Adds the listening and client sockets to a select() set.
+ *
+ * @param set    Set to fill.
+ * @param max_fd Highest descriptor already in the set.
+ * @return Highest descriptor in the set afterwards.
+ */
+int control_fill_fds(fd_set *set, int max_fd);
+
+/**
+ * Accepts clients and runs the complete commands they sent.
+ *
+ * Runs in the event loop between two frames, the only place the
+ * configuration is read, so changes never wait on a lock.
+ *
+ * @param set     Descriptors reported readable by select().
+ * @param publish Function publishing a modified configuration.
+ * @param ctx     Opaque pointer passed to publish.
+ */
+void control_service(const fd_set *set, control_publish_t publish, void *ctx);
+
+/**
+ * Closes the clients and removes the socket.
+ */
+void control_cleanup(void);
+
+
+#endif // CONTROL_H
\ No newline at end of file
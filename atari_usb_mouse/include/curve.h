@@ -0,0 +1,127 @@
+#ifndef CURVE_H
+#define CURVE_H
+
+
+#include <stdint.h>
+
+
+#define MAX_CURVES 8            // Named curves a configuration can declare
+#define MAX_CURVE_POINTS 16     // Control points per curve
+#define CURVE_NAME_SIZE 32
+
+// Gain table: indexed by input speed in 1/4 counts per millisecond (0..63.75)
+#define CURVE_SPEED_SHIFT 2
+#define CURVE_GAIN_SIZE 256
+// Period table: indexed by the number of steps in a pulse train
+#define CURVE_PERIOD_SIZE 64
+
+// Speed estimate bounds: 8 kHz polling at best, idle gaps count as slow motion
+#define MIN_EVENT_INTERVAL_US 125
+#define MAX_EVENT_INTERVAL_US 100000
+
+// Fixed-point format of the gain table (Q16.16)
+#define CURVE_GAIN_SHIFT 16
+#define CURVE_GAIN_ONE (1u << CURVE_GAIN_SHIFT)
+
+// Built-in edge period ramp: slow trains at the maximum period, fast trains
+// down to the minimum one
+#define DEFAULT_SPEED_THRESHOLD 5   // Trains up to this length use DEFAULT_MAX_DELAY
+#define DEFAULT_MIN_DELAY 500       // Minimum delay (500µs for fast movements)
+#define DEFAULT_MAX_DELAY 2000      // Maximum delay (2ms for slow movements)
+#define DEFAULT_RAMP_STEPS 10       // Steps from the maximum to the minimum delay
+
+// Name of the built-in curve, always present at index 0
+#define DEFAULT_CURVE_NAME "linear"
+
+
+/**
+ * Control point of a piecewise linear curve.
+ */
+typedef struct {
+	double x;
+	double y;
+} curve_point_t;
+
+/**
+ * A named curve compiled into lookup tables.
+ *
+ * gain_q16 maps the input speed (counts/ms) to the number of ST counts
+ * emitted per input count, before the sensitivity divider. period_us maps
+ * the length of a pulse train to the delay between two of its edges.
+ */
+typedef struct {
+	char name[CURVE_NAME_SIZE];
+	uint32_t gain_q16[CURVE_GAIN_SIZE];
+	uint16_t period_us[CURVE_PERIOD_SIZE];
+	uint16_t min_period_us;		// Shortest entry of period_us
+} curve_t;
+
+/**
+ * Per-axis state of the gain stage.
+ */
+typedef struct {
+	uint64_t last_time_us;  // Timestamp of the previous movement on this axis
+	int64_t remainder;      // Fraction of a count carried to the next event (Q16.16)
+} curve_axis_t;
+
+
+/**
+ * Initializes a curve with the built-in tables: unity gain and the default
+ * edge period ramp.
+ *
+ * @param curve Curve to initialize.
+ * @param name  Name given to the curve.
+ */
+void curve_init_default(curve_t *curve, const char *name);
+
+/**
+ * Compiles a gain curve into the gain table.
+ *
+ * @param curve  Curve receiving the table.
+ * @param points Control points (x = counts/ms, y = gain), sorted by x.
+ * @param count  Number of control points (at least 1).
+ * @return 0 on success, -1 if the points are invalid.
+ */
+int curve_build_gain(curve_t *curve, const curve_point_t *points, int count);
+
+/**
+ * Compiles an edge period curve into the period table.
+ *
+ * @param curve  Curve receiving the table.
+ * @param points Control points (x = steps in the train, y = period in µs), sorted by x.
+ * @param count  Number of control points (at least 1).
+ * @return 0 on success, -1 if the points are invalid.
+ */
+int curve_build_period(curve_t *curve, const curve_point_t *points, int count);
+
+/**
+ * Converts a relative movement into ST counts through the gain table.
+ * Fractions of a count are carried over to the next event of the axis.
+ *
+ * @param curve       Active curve.
+ * @param axis        Gain stage state of the axis.
+ * @param value       Relative movement reported by the input device.
+ * @param time_us     Event timestamp in microseconds.
+ * @param sensitivity Divider applied after the gain (>= 1).
+ * @return Signed number of ST counts to emit.
+ */
+int curve_apply_gain(const curve_t *curve, curve_axis_t *axis, int value, uint64_t time_us, int sensitivity);
+
+/**
+ * Returns the delay between two edges of a pulse train.
+ *
+ * @param curve  Active curve.
+ * @param pulses Number of steps in the train.
+ * @return Delay in microseconds.
+ */
+static inline int curve_period_us(const curve_t *curve, int pulses) {
+	if (pulses >= CURVE_PERIOD_SIZE) {
+		pulses = CURVE_PERIOD_SIZE - 1;
+	} else if (pulses < 0) {
+		pulses = 0;
+	}
+	return curve->period_us[pulses];
+}
+
+
+#endif // CURVE_H
\ No newline at end of file
@@ -2,8 +2,14 @@
 #define DEVICE_DETECTION_H
 
 
+#include <stddef.h>
+
+
 #define MAX_DEVICES 32
 
+// Last mouse device found by auto-detection, tried first at the next start
+#define DEVICE_CACHE_PATH "/var/cache/atari_usb_mouse.device"
+
 
 /**
  * Tests whether the device at the given path is a compatible mouse.
@@ -29,5 +35,63 @@ char* find_mouse_device(void);
  */
 char* wait_for_mouse_device(void);
 
+/**
+ * Returns the mouse device cached by a previous run, if it is still a
+ * compatible mouse.
+ *
+ * @return Path of the device (static buffer), or NULL.
+ */
+char *cached_mouse_device(void);
+
+/**
+ * Remembers a mouse device for the next start. The cache file is only
+ * rewritten when the device changes.
+ *
+ * @param device_path Path of the device.
+ */
+void cache_mouse_device(const char *device_path);
+
+/**
+ * Starts opening the input device in the background: the configured one,
+ * else the cached one, else the first mouse found. Nothing is retried:
+ * if no device is available, the event loop waits for one.
+ *
+ * @param device_path Configured device, empty for auto-detection.
+ * @return 0 on success, -1 if the discovery thread cannot start.
+ */
+int discovery_start(const char *device_path);
+
+/**
+ * Waits for the background discovery to finish.
+ *
+ * @param device_path Receives the path of the opened device.
+ * @param size        Size of device_path.
+ * @return Open descriptor of the device, -1 if none was found.
+ */
+int discovery_join(char *device_path, size_t size);
+
+/**
+ * Switches the event timestamps of an input device to CLOCK_MONOTONIC, so
+ * they compare directly with the output clock and do not jump with the
+ * wall clock.
+ *
+ * @param fd Open input device.
+ * @return 0 on success, -1 if the kernel refused (timestamps stay on CLOCK_REALTIME).
+ */
+int set_monotonic_timestamps(int fd);
+
+/**
+ * Reads the USB vendor and product identifiers and the name of an input
+ * device, which select its profile.
+ *
+ * @param fd      Open input device.
+ * @param vendor  Receives the vendor identifier.
+ * @param product Receives the product identifier.
+ * @param name    Receives the device name, empty if unknown.
+ * @param size    Size of name.
+ * @return 0 on success, -1 if fd is not an input device.
+ */
+int read_device_identity(int fd, int *vendor, int *product, char *name, size_t size);
+
 
 #endif // DEVICE_DETECTION_H
\ No newline at end of file
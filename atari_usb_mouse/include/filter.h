@@ -0,0 +1,89 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+
+#include <stdint.h>
+
+#include "config.h"
+#include "curve.h"
+
+
+// How a chain runs, chosen when it is built
+enum {
+	FILTER_PATH_MAP = 0,		// Invert and swap stages only, folded into one mapping
+	FILTER_PATH_MAP_CURVE = 1,	// The mapping, then the curve
+	FILTER_PATH_GENERIC = 2		// Every stage in turn
+};
+
+
+/**
+ * Motion of one input frame, in mouse orientation (X to the right, Y
+ * downwards).
+ */
+typedef struct {
+	int32_t d[2];		// Counts on X and Y
+	uint64_t time_us;	// Time of the frame (SYN_REPORT)
+} motion_frame_t;
+
+/**
+ * One stage of a built chain: its configuration and its state.
+ */
+typedef struct {
+	filter_config_t cfg;
+	int64_t average[2];	// Smoothing: moving average (Q16.16)
+	int64_t carry[2];	// Smoothing: fraction not emitted yet (Q16.16)
+	curve_axis_t gain[2];	// Curve: gain stage state
+	uint64_t last_us;	// Smoothing and rate cap: time of the previous frame
+} filter_stage_t;
+
+/**
+ * A motion filter chain: a flat array of stages, run without allocation
+ * or function pointers.
+ */
+typedef struct {
+	filter_stage_t stages[MAX_FILTERS];
+	int count;
+	int path;		// FILTER_PATH_*
+
+	// Invert and swap stages folded together: out[i] = sign[i] * in[source[i]]
+	int source[2];
+	int sign[2];
+} filter_chain_t;
+
+
+/**
+ * Builds a chain from its configuration and picks the fastest way to run
+ * it: a chain of invert and swap stages, optionally followed by the curve,
+ * runs as one mapping.
+ *
+ * @param chain   Chain to build, state cleared.
+ * @param filters Stages in order.
+ * @param count   Number of stages (0 = pass-through).
+ */
+void filter_chain_build(filter_chain_t *chain, const filter_config_t *filters, int count);
+
+/**
+ * Clears the state of every stage of a chain, as if no frame went through
+ * it yet. The configuration of the stages is kept.
+ *
+ * @param chain Built chain.
+ */
+void filter_chain_reset(filter_chain_t *chain);
+
+/**
+ * Runs a frame through a chain, in place.
+ *
+ * @param chain       Built chain.
+ * @param frame       Frame to filter.
+ * @param curve       Curve of the curve stages.
+ * @param sensitivity Divider of the curve stages.
+ */
+void filter_chain_run(filter_chain_t *chain, motion_frame_t *frame, const curve_t *curve, int sensitivity);
+
+/**
+ * Returns the name of a FILTER_PATH_* value.
+ */
+const char *filter_path_name(int path);
+
+
+#endif // FILTER_H
\ No newline at end of file
@@ -0,0 +1,63 @@
+#ifndef FRAME_PACING_H
+#define FRAME_PACING_H
+
+
+#include <stdint.h>
+
+#include "gpio_control.h"
+
+
+// Interval assumed until the polling rate of the mouse is known (1000 Hz)
+#define FRAME_DEFAULT_INTERVAL_US 1000
+
+// Gaps longer than this are pauses in the motion, not polling intervals
+#define FRAME_MAX_INTERVAL_US 20000
+
+
+/**
+ * Accounts the end of an input frame (SYN_REPORT) and updates the polling
+ * rate estimate published in stats.polling_rate_hz and
+ * stats.frame_interval_us.
+ *
+ * @param time_us Timestamp of the SYN_REPORT event in microseconds.
+ */
+void frame_rate_update(uint64_t time_us);
+
+/**
+ * Returns the expected interval until the next input frame: the nominal
+ * interval of the detected polling rate, or the measured average when the
+ * rate matches no standard USB polling rate.
+ *
+ * @return Interval in microseconds.
+ */
+unsigned int frame_interval_us(void);
+
+/**
+ * Queues quadrature steps of the current frame.
+ *
+ * @param axis  0 for X, 1 for Y.
+ * @param steps Signed number of steps.
+ */
+void frame_add(int axis, int steps);
+
+/**
+ * Emits the steps of the current frame, X and Y interleaved and evenly
+ * spread over the expected frame interval. When the steps do not fit at
+ * the fastest edge period of the active curve, the remainder is carried
+ * to the next frame instead of delaying it. The carry is bounded to what
+ * one frame can emit, the excess being counted in stats.steps_dropped.
+ *
+ * @param state Pointer to the current quadrature state.
+ */
+void frame_emit(quadrature_state_t *state);
+
+/**
+ * Emits the steps carried over from previous frames, for when the input
+ * goes idle and no next frame will pick them up.
+ *
+ * @param state Pointer to the current quadrature state.
+ */
+void frame_flush(quadrature_state_t *state);
+
+
+#endif // FRAME_PACING_H
\ No newline at end of file
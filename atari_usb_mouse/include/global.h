@@ -18,6 +18,9 @@
 #define HIDE_CURSOR "\033[?25l"
 #define SHOW_CURSOR "\033[?25h"
 
+// Stream of info and debug messages: stderr while stdout carries a machine-readable feed
+#define INFO_STREAM (stdout_reserved ? stderr : stdout)
+
 // Macro for debug messages
 #define DEBUG_PRINT(fmt, ...) \
     do { \
@@ -25,7 +28,7 @@
             if (daemon_mode) { \
                 syslog(LOG_DEBUG, "[DEBUG] " fmt, ##__VA_ARGS__); \
             } else { \
-                printf("[DEBUG] " fmt, ##__VA_ARGS__); \
+                fprintf(INFO_STREAM, "[DEBUG] " fmt, ##__VA_ARGS__); \
             } \
         } \
     } while(0)
@@ -46,13 +49,14 @@
         if (daemon_mode) { \
             syslog(LOG_INFO, "[INFO] " fmt, ##__VA_ARGS__); \
         } else { \
-            printf(fmt, ##__VA_ARGS__); \
+            fprintf(INFO_STREAM, fmt, ##__VA_ARGS__); \
         } \
     } while(0)
 
 // Global variables
 extern int debug_mode;
 extern int daemon_mode;
+extern int stdout_reserved;
 // Global variable for signal handler
 extern volatile sig_atomic_t running;
 
@@ -2,6 +2,41 @@
 #define GPIO_CONTROL_H
 
 
+#include <stdint.h>
+
+
+// Line indices, also used as bit positions in edge trace line masks
+enum {
+	LINE_XA = 0,
+	LINE_XB = 1,
+	LINE_YA = 2,
+	LINE_YB = 3,
+	LINE_LEFT_BUTTON = 4,
+	LINE_RIGHT_BUTTON = 5,
+	NUM_LINES = 6
+};
+
+// Lines driven by the quadrature generator, as a line mask
+#define QUADRATURE_LINES ((1u << LINE_XA) | (1u << LINE_XB) | (1u << LINE_YA) | (1u << LINE_YB))
+
+// Output backends
+enum {
+	OUTPUT_GPIO = 0,	// Drive the real GPIO lines
+	OUTPUT_NULL = 1,	// No hardware, pacing delays advance a virtual clock
+	OUTPUT_IKBD = 2		// IKBD mouse packets on a serial line (see ikbd_serial.h)
+};
+
+// Magic string at the start of an edge trace file
+#define EDGE_TRACE_MAGIC "AUMEDGE1"
+
+
+/**
+ * Line set of an additional output (see outputs.h), independent of the
+ * lines driven by the functions below.
+ */
+typedef struct output_lines output_lines_t;
+
+
 /**
  * Structure to track the current state of the X and Y quadrature signals
  */
@@ -14,6 +49,18 @@ typedef struct {
 	int y_phase;	// Current phase of Y quadrature signal
 } quadrature_state_t;
 
+/**
+ * One record of an edge trace file: the line levels after a transition.
+ *
+ * With the null backend, time_ns comes from the virtual output clock, so a
+ * given input stream always produces a byte-identical trace.
+ */
+typedef struct {
+	uint64_t time_ns;	// Output clock timestamp of the transition
+	uint32_t lines;		// Levels of all lines after the transition (bit n = line n)
+	uint32_t changed;	// Lines that toggled in this transition
+} edge_record_t;
+
 
 /**
  * Initializes GPIOs used for quadrature signal generation.
@@ -23,6 +70,158 @@ typedef struct {
  */
 int init_gpio(void);
 
+/**
+ * Applies pin changes of the configuration to the requested lines.
+ *
+ * Lines whose pin did not change stay requested and are not written. Pins
+ * leaving the port are set to their idle level, then released, or turned
+ * into inputs when they belong to the request made at start. A moved line
+ * takes a pin of that request left free, or is requested on its own with
+ * its current level.
+ *
+ * @return Number of lines moved to a new pin, -1 if the new pins cannot be
+ *         requested (the previous ones are kept).
+ */
+int reconfigure_gpio_lines(void);
+
+/**
+ * Opens a GPIO chip and requests the lines of an additional output, driven
+ * to their idle levels. With the null backend no line is requested.
+ *
+ * @param chip_path GPIO chip device.
+ * @param offsets   Pin of every line, in line order.
+ * @return Line set, or NULL on failure.
+ */
+output_lines_t *output_lines_open(const char *chip_path, const unsigned int *offsets);
+
+/**
+ * Opens a GPIO chip and requests a line set of any size up to NUM_LINES,
+ * driven to the given idle levels, again when it is closed. With the null
+ * backend no line is requested.
+ *
+ * @param chip_path   GPIO chip device.
+ * @param offsets     Pin of every line, in line order.
+ * @param count       Number of lines.
+ * @param idle_levels Levels when opened and closed (bit n = line n).
+ * @return Line set, or NULL on failure.
+ */
+output_lines_t *output_lines_request(const char *chip_path, const unsigned int *offsets, int count, uint32_t idle_levels);
+
+/**
+ * Drives the lines of an additional output. Not thread-safe: each line set
+ * is written by a single thread.
+ *
+ * @param lines  Line set.
+ * @param levels New line levels (bit n = line n).
+ */
+void output_lines_write(output_lines_t *lines, uint32_t levels);
+
+/**
+ * Drives the lines of an additional output to their idle levels and
+ * releases them.
+ *
+ * @param lines Line set, may be NULL.
+ */
+void output_lines_close(output_lines_t *lines);
+
+/**
+ * Returns line levels with the lines of one axis set to a quadrature phase.
+ *
+ * @param levels Current line levels.
+ * @param axis   0 for X, 1 for Y.
+ * @param phase  Quadrature phase (0-3).
+ * @return Updated line levels.
+ */
+uint32_t quadrature_levels(uint32_t levels, int axis, int phase);
+
+/**
+ * Takes over the lines requested by a previous instance of the daemon. The
+ * request keeps driving the levels it had: nothing is written here.
+ *
+ * @param line_fd Line request descriptor received from the previous instance
+ *                (ignored with the null backend).
+ * @param offsets Pin of every line, in line order.
+ * @param levels  Current levels of the lines (bit n = line n).
+ * @return 0 on success, -1 on failure.
+ */
+int adopt_gpio_lines(int line_fd, const unsigned int *offsets, uint32_t levels);
+
+/**
+ * Returns the descriptor of the line request, to hand it to another instance.
+ *
+ * @return Line request descriptor, -1 with the null backend or once lines
+ *         moved to other pins (the request no longer holds line n at bit n).
+ */
+int gpio_line_fd(void);
+
+/**
+ * Returns the pins of the lines and the levels they are driven to.
+ *
+ * @param offsets Receives NUM_LINES pins, in line order.
+ * @param levels  Receives the line levels (bit n = line n).
+ */
+void gpio_get_lines(unsigned int *offsets, uint32_t *levels);
+
+/**
+ * Releases the GPIOs after handing them to another instance. Unlike
+ * cleanup_gpio(), the lines are not driven to their idle levels.
+ */
+void detach_gpio(void);
+
+/**
+ * Starts watching for the next line transition, to time the first pulse.
+ */
+void output_watch_first_edge(void);
+
+/**
+ * Returns when the transition watched for happened.
+ *
+ * @return CLOCK_MONOTONIC time in nanoseconds, 0 if no line moved yet.
+ */
+uint64_t output_first_edge_ns(void);
+
+/**
+ * Opens a file receiving every line transition as edge_record_t entries.
+ *
+ * @param path Path of the trace file to create.
+ * @return 0 on success, -1 on failure.
+ */
+int open_edge_trace(const char *path);
+
+/**
+ * Flushes and closes the edge trace file, if any.
+ */
+void close_edge_trace(void);
+
+/**
+ * Opens a Value Change Dump receiving every line transition (see vcd.h).
+ *
+ * @param path Path of the VCD file to create.
+ * @return 0 on success, -1 on failure.
+ */
+int open_vcd_dump(const char *path);
+
+/**
+ * Writes out the queued transitions and closes the VCD dump, if any.
+ */
+void close_vcd_dump(void);
+
+/**
+ * Moves the virtual output clock of the null backend forward to an input timestamp.
+ * Has no effect with the GPIO backend.
+ *
+ * @param time_ns Input event timestamp in nanoseconds.
+ */
+void output_sync_clock(uint64_t time_ns);
+
+/**
+ * Returns the output clock used to timestamp edges: the virtual clock with
+ * the null backend, CLOCK_MONOTONIC otherwise.
+ *
+ * @return Current output time in nanoseconds.
+ */
+uint64_t output_clock_ns(void);
+
 /**
  * Cleans up and releases GPIOs.
  * Should be called before program exit.
@@ -47,6 +246,57 @@ void set_x_quadrature(quadrature_state_t *state, int xa, int xb);
  */
 void set_y_quadrature(quadrature_state_t *state, int ya, int yb);
 
+/**
+ * Waits between two quadrature transitions: sleeps with the GPIO backend
+ * (servicing button events when the button lane is attached), advances
+ * the virtual clock with the null backend.
+ *
+ * @param delay_us Delay in microseconds.
+ */
+void edge_delay(int delay_us);
+
+/**
+ * Drives some lines to new levels. Changed lines are written with a single
+ * request and the transition is appended to the edge trace. Lines outside
+ * the mask keep their current level, so a button set meanwhile by the
+ * button lane is not written back.
+ *
+ * @param levels New levels (bit n = line n).
+ * @param mask   Lines to drive.
+ */
+void output_write_levels(uint32_t levels, uint32_t mask);
+
+/**
+ * Emits a train of steps, one slot every period_us. Goes through the
+ * precision emitter when it is enabled.
+ *
+ * @param state     Pointer to the current quadrature state.
+ * @param steps     Per slot, the X and Y step (-1, 0 or 1).
+ * @param count     Number of slots.
+ * @param period_us Time between two slots in microseconds.
+ * @param trailing  Non-zero to also wait one period after the last slot.
+ */
+void emit_step_train(quadrature_state_t *state, const int8_t (*steps)[2], int count, int period_us, int trailing);
+
+/**
+ * Moves one axis a single quadrature step forward or backward.
+ *
+ * @param state     Pointer to the current quadrature state.
+ * @param axis      0 for X, 1 for Y.
+ * @param direction Positive for a forward step, negative for a backward one.
+ */
+void quadrature_step(quadrature_state_t *state, int axis, int direction);
+
+/**
+ * Computes the delay between transitions based on the number of pulses,
+ * from the period table of the active curve. Longer pulse trains are
+ * emitted faster.
+ *
+ * @param pulses Number of quadrature steps in the train.
+ * @return Delay between two transitions, in microseconds.
+ */
+int calculate_delay(int pulses);
+
 /**
  * Generates quadrature pulses along the X axis.
  *
@@ -80,5 +330,8 @@ void set_right_button(int state);
 // Flag indicating whether GPIO has been successfully initialized
 extern int gpio_initialized;
 
+// Selected output backend (OUTPUT_GPIO, OUTPUT_NULL or OUTPUT_IKBD)
+extern int output_backend;
+
 
 #endif // GPIO_CONTROL_H
\ No newline at end of file
@@ -0,0 +1,27 @@
+#ifndef GPIO_SIM_H
+#define GPIO_SIM_H
+
+
+// Exit status of the harness when gpio-sim or uinput is not available
+#define GPIO_SIM_SKIPPED 77
+
+
+/**
+ * Runs the daemon end to end against a gpio-sim chip and a uinput mouse.
+ *
+ * Creates a simulated gpiochip through configfs, starts this binary on it
+ * with a virtual mouse as input, injects known motion and decodes the
+ * quadrature lines read back from the simulator. The decoded count,
+ * direction, Gray-code legality and edge spacing are checked against the
+ * injected motion. The daemon under test runs on a generated configuration
+ * (linear curve, sensitivity 1, burst pacing, no filters nor profiles), so
+ * the installed one cannot skew the checks. Requires root and the gpio-sim
+ * kernel module.
+ *
+ * @return 0 if every check passed, 1 on failure, GPIO_SIM_SKIPPED if the
+ *         environment does not support the harness.
+ */
+int run_gpio_sim_check(void);
+
+
+#endif // GPIO_SIM_H
\ No newline at end of file
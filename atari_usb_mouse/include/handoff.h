@@ -0,0 +1,67 @@
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "gpio_control.h"
+#include "calibrate.h"
+
+
+// Magic string at the start of a hand-off message
+#define HANDOFF_MAGIC "AUMHAND1"
+
+// Time given to the running instance to hand over (in milliseconds)
+#define HANDOFF_TIMEOUT_MS 2000
+
+// Permissions of the hand-off socket file, whatever the umask
+#define HANDOFF_SOCKET_MODE 0600
+
+
+/**
+ * State handed from the running instance to its replacement, along with
+ * the input device and line request descriptors.
+ */
+typedef struct {
+	char magic[8];				// HANDOFF_MAGIC
+	uint64_t sent_ns;			// CLOCK_MONOTONIC when the sender stopped its output
+	quadrature_state_t quad;		// Levels and phases of both axes
+	uint32_t line_levels;			// Levels of all lines (bit n = line n)
+	unsigned int line_offsets[NUM_LINES];	// Pin of every line
+	char device_path[256];			// Input device the descriptor belongs to
+	int calibrated;				// Set if calibration holds startup measurements
+	calibration_t calibration;		// Reused instead of toggling the lines again
+} handoff_state_t;
+
+
+/**
+ * Asks a running instance for its descriptors and output state, then
+ * waits for them on a Unix socket next to the PID file. Only that process
+ * is trusted: other peers, identified by SO_PEERCRED, are turned away.
+ *
+ * @param pid      Process ID of the running instance.
+ * @param state    Receives the output state.
+ * @param input_fd Receives the input device descriptor.
+ * @param line_fd  Receives the line request descriptor, -1 if the sender
+ *                 had none (null backend).
+ * @return 0 on success, -1 if the instance did not hand over in time.
+ */
+int handoff_receive(pid_t pid, handoff_state_t *state, int *input_fd, int *line_fd);
+
+/**
+ * Hands the input device, the line request and the output state to the
+ * instance that asked for them. The output must be idle: no pulse is
+ * pending and no other thread writes the lines.
+ *
+ * @param input_fd    Input device descriptor.
+ * @param device_path Path of the input device.
+ * @param quad        Current quadrature state.
+ * @param cal         Startup calibration, NULL if none was made.
+ * @return 0 once the new instance holds the descriptors, -1 on failure
+ *         (the caller keeps running).
+ */
+int handoff_send(int input_fd, const char *device_path, const quadrature_state_t *quad, const calibration_t *cal);
+
+
+#endif // HANDOFF_H
\ No newline at end of file
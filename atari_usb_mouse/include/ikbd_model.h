@@ -0,0 +1,56 @@
+#ifndef IKBD_MODEL_H
+#define IKBD_MODEL_H
+
+
+/**
+ * Default interval between two samples of the mouse lines by the IKBD
+ * (in microseconds). The HD6301 firmware polls the lines in software, so
+ * this is an estimate; measure it on a real ST and pass --ikbd-sample-us.
+ */
+#define IKBD_SAMPLE_US 150
+
+
+/**
+ * Parameters of the IKBD sampling model.
+ */
+typedef struct {
+	unsigned int sample_us;	// Interval between two samples of the lines
+	unsigned int jitter_us;	// Maximum random delay added to each sample
+	long max_error;		// Largest tolerated cursor error in counts (-1 = report only)
+} ikbd_params_t;
+
+/**
+ * What the ST registered on one axis, compared with what was driven.
+ */
+typedef struct {
+	long driven_net;	// Net count driven on the lines (every edge decoded)
+	long registered_net;	// Net count registered by the sampled model
+	long transitions;	// Quadrature transitions driven
+	long missed;		// Transitions the IKBD never saw (undone between two samples)
+	long misread;		// Samples where both lines changed (direction unknown, counts lost)
+	long close_edges;	// Edges closer than one sample interval to the previous one
+} ikbd_axis_result_t;
+
+
+/**
+ * Runs the IKBD sampling model over an edge trace.
+ *
+ * @param trace_path Edge trace written with --edge-trace.
+ * @param params     Sampling model parameters.
+ * @param result     Per-axis results, index 0 for X and 1 for Y.
+ * @return 0 on success, -1 if the trace cannot be read.
+ */
+int ikbd_model_run(const char *trace_path, const ikbd_params_t *params, ikbd_axis_result_t result[2]);
+
+/**
+ * Runs the model over an edge trace and prints the report.
+ *
+ * @param trace_path Edge trace written with --edge-trace.
+ * @param params     Sampling model parameters.
+ * @return 0 if the cursor error is within params->max_error, 1 if it is
+ *         not, -1 if the trace cannot be read.
+ */
+int run_ikbd_model(const char *trace_path, const ikbd_params_t *params);
+
+
+#endif // IKBD_MODEL_H
\ No newline at end of file
@@ -0,0 +1,100 @@
+#ifndef IKBD_SERIAL_H
+#define IKBD_SERIAL_H
+
+
+#include <stdint.h>
+
+
+// Line rate of the keyboard ACIA (500 kHz / 64), 8N1: 10 bits per byte
+#define IKBD_BAUD_NUM 15625
+#define IKBD_BAUD_DEN 2
+#define IKBD_BYTE_NS (10ULL * 1000000000ULL * IKBD_BAUD_DEN / IKBD_BAUD_NUM)
+
+// Relative mouse packet: header, X, Y
+#define IKBD_PACKET_SIZE 3
+#define IKBD_PACKET_NS (IKBD_PACKET_SIZE * IKBD_BYTE_NS)
+
+// Header of a relative mouse packet, button bits below
+#define IKBD_HEADER 0xF8
+#define IKBD_HEADER_LEFT 0x02
+#define IKBD_HEADER_RIGHT 0x01
+
+// Largest count per axis in one packet
+#define IKBD_MAX_COUNT 127
+
+// Button changes waiting for a packet, beyond which the latest replaces the last
+#define IKBD_BUTTON_QUEUE 16
+
+
+/**
+ * Counters of the serial output.
+ */
+typedef struct {
+	unsigned long long packets;	// Packets written
+	unsigned long long counts;	// Counts carried by the packets (both axes)
+	unsigned long long saturated;	// Packets with an axis at +-127, rest carried over
+	unsigned long long write_errors;	// Packets the tty did not take (retried)
+} ikbd_serial_stats_t;
+
+
+/**
+ * Builds a relative mouse packet.
+ *
+ * @param dx      X count, clamped to +-127 (positive to the right).
+ * @param dy      Y count, clamped to +-127 (positive downwards).
+ * @param buttons Button state, IKBD_HEADER_LEFT | IKBD_HEADER_RIGHT.
+ * @param packet  Destination, IKBD_PACKET_SIZE bytes.
+ */
+void ikbd_build_packet(int dx, int dy, uint8_t buttons, uint8_t *packet);
+
+/**
+ * Opens a UART (or a pty) at the IKBD rate and starts the packet writer.
+ *
+ * Instead of quadrature edges, counts are accumulated and sent as IKBD
+ * relative mouse packets, paced at the line rate: a packet leaves as soon
+ * as the line is free and carries everything accumulated meanwhile, up to
+ * +-127 counts per axis. The device stands in for the keyboard processor:
+ * bytes sent by the ST are read and ignored.
+ *
+ * @param path Serial device (e.g. /dev/serial0) or pty slave.
+ * @return 0 on success, -1 on failure.
+ */
+int ikbd_serial_open(const char *path);
+
+/**
+ * Adds counts to the next packets.
+ *
+ * @param axis  0 for X, 1 for Y.
+ * @param count Signed counts in IKBD orientation.
+ */
+void ikbd_serial_add(int axis, int count);
+
+/**
+ * Sets the state of a button, sent with the next packet (at once if the
+ * line is free). Each change gets its own packet, so a press and release
+ * within one packet interval still reach the ST as a click.
+ *
+ * @param button  IKBD_HEADER_LEFT or IKBD_HEADER_RIGHT.
+ * @param pressed 1 if pressed.
+ */
+void ikbd_serial_button(uint8_t button, int pressed);
+
+/**
+ * Waits until every accumulated count and button change has been sent.
+ */
+void ikbd_serial_flush(void);
+
+/**
+ * Copies the counters of the serial output.
+ *
+ * @param stats Receives the counters.
+ */
+void ikbd_serial_get_stats(ikbd_serial_stats_t *stats);
+
+/**
+ * Stops the packet writer, prints its counters and closes the device.
+ */
+void ikbd_serial_close(void);
+
+
+#endif // IKBD_SERIAL_H
\ No newline at end of file
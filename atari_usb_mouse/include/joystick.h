@@ -0,0 +1,104 @@
+#ifndef JOYSTICK_H
+#define JOYSTICK_H
+
+
+#include <stddef.h>
+#include <stdint.h>
+#include <linux/input.h>
+
+#include "config.h"
+
+
+// Joystick lines, also bit positions in line levels (active low)
+enum {
+	JOY_UP = 0,
+	JOY_DOWN = 1,
+	JOY_LEFT = 2,
+	JOY_RIGHT = 3,
+	JOY_FIRE = 4
+};
+
+// Levels of the joystick lines when nothing is pressed
+#define JOYSTICK_IDLE_LEVELS ((1u << JOYSTICK_LINES) - 1)
+
+// Default stick deflection closing a direction (in percent of its travel)
+#define JOYSTICK_DEFAULT_THRESHOLD 50
+
+// Delay before reopening a vanished gamepad (in seconds)
+#define JOYSTICK_REOPEN_S 1
+
+
+/**
+ * Direction of one absolute axis, precomputed from its range when the
+ * gamepad is opened.
+ */
+typedef struct {
+	int8_t axis;	// 0 for left/right, 1 for up/down, -1 if the axis is not mapped
+	int32_t low;	// At or below: left or up
+	int32_t high;	// At or above: right or down
+} joystick_threshold_t;
+
+/**
+ * State of a gamepad as the joystick lines see it.
+ */
+typedef struct {
+	joystick_threshold_t table[ABS_CNT];	// Indexed by ABS_* code
+	int8_t direction[ABS_CNT];		// -1, 0 or 1 per mapped axis
+	uint32_t dpad;				// Held BTN_DPAD_* buttons, bit n = line n
+	uint32_t fire;				// Held buttons, bit n = BTN_JOYSTICK + n
+} joystick_map_t;
+
+
+/**
+ * Precomputes the thresholds of the stick (ABS_X, ABS_Y) and the hat
+ * (ABS_HAT0X, ABS_HAT0Y) and clears the state.
+ *
+ * @param map       Map to fill.
+ * @param device_fd Gamepad device to read the axis ranges from, or -1 to
+ *                  assume the usual ones (+-32767 for sticks, +-1 for hats).
+ * @param threshold Deflection closing a direction, in percent of the
+ *                  travel from the centre.
+ */
+void joystick_map_init(joystick_map_t *map, int device_fd, int threshold);
+
+/**
+ * Applies an input event to a map.
+ *
+ * Stick, hat and d-pad buttons add up, so opposite directions cancel out;
+ * any gamepad or joystick button (BTN_JOYSTICK to BTN_THUMBR) holds fire.
+ *
+ * @param map Gamepad state.
+ * @param ie  Input event.
+ * @return Joystick line levels after the event (active low).
+ */
+uint32_t joystick_map_event(joystick_map_t *map, const struct input_event *ie);
+
+/**
+ * Starts the joystick output of the configuration, if it has a device.
+ *
+ * A thread of its own reads the gamepad and writes the lines as soon as an
+ * event changes them, without going through the pulse pipeline, and records
+ * the time from the event timestamp to the line write. The gamepad is
+ * reopened when it vanishes, the lines released meanwhile.
+ *
+ * @param cfg Joystick configuration, copied.
+ * @return 0 on success or without joystick device, -1 on failure.
+ */
+int joystick_start(const joystick_config_t *cfg);
+
+/**
+ * Formats the state and statistics of the joystick output on one line.
+ *
+ * @param buffer Destination buffer.
+ * @param size   Size of the buffer.
+ * @return 1 if the joystick output runs, 0 otherwise.
+ */
+int joystick_status(char *buffer, size_t size);
+
+/**
+ * Stops the joystick output, releases its lines and prints its latency.
+ */
+void joystick_stop(void);
+
+
+#endif // JOYSTICK_H
\ No newline at end of file
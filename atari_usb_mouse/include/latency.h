@@ -0,0 +1,85 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+
+#include <stdint.h>
+#include <sys/time.h>
+
+
+// Histogram buckets: exact below 16 us, then 4 per power of two up to ~16 s
+#define LATENCY_LINEAR_BUCKETS 16
+#define LATENCY_BUCKETS 96
+
+
+/**
+ * Log-linear histogram of latencies in microseconds.
+ */
+typedef struct {
+	uint64_t count;				// Number of recorded samples
+	uint64_t max_us;			// Largest recorded latency
+	uint32_t buckets[LATENCY_BUCKETS];	// Sample counts per bucket
+} latency_hist_t;
+
+
+/**
+ * Selects the clock stamping input events on real hardware.
+ *
+ * @param monotonic 1 once the device reports CLOCK_MONOTONIC timestamps
+ *                  (the default), 0 if it still uses CLOCK_REALTIME.
+ */
+void event_clock_set_monotonic(int monotonic);
+
+/**
+ * Reads the clock used by input event timestamps (the virtual output clock
+ * with the null backend, the device clock otherwise).
+ *
+ * @return Current time in nanoseconds.
+ */
+uint64_t event_clock_ns(void);
+
+/**
+ * Returns the time elapsed since an input event was stamped.
+ *
+ * @param tv Input event timestamp.
+ * @return Latency in nanoseconds, 0 if the timestamp is in the future.
+ */
+uint64_t event_latency_ns(const struct timeval *tv);
+
+/**
+ * Adds a sample to a histogram.
+ *
+ * @param hist       Histogram to update.
+ * @param latency_ns Latency in nanoseconds.
+ */
+void latency_record(latency_hist_t *hist, uint64_t latency_ns);
+
+/**
+ * Returns a percentile of a histogram, as the upper bound of its bucket.
+ *
+ * @param hist Histogram.
+ * @param pct  Percentile (0-100).
+ * @return Latency in microseconds, 0 if the histogram is empty.
+ */
+uint64_t latency_percentile(const latency_hist_t *hist, unsigned int pct);
+
+/**
+ * Prints count, p50, p90, p99 and max of a histogram on one line.
+ *
+ * @param name Label printed before the figures.
+ * @param hist Histogram.
+ */
+void latency_report(const char *name, const latency_hist_t *hist);
+
+
+/**
+ * Input-to-output latency of button transitions.
+ */
+extern latency_hist_t button_latency;
+
+/**
+ * Input-to-output latency of motion events, up to the start of their pulses.
+ */
+extern latency_hist_t motion_latency;
+
+
+#endif // LATENCY_H
\ No newline at end of file
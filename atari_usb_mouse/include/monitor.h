@@ -3,23 +3,40 @@
 
 
 #include <stddef.h>
+#include <stdint.h>
 
 #include "gpio_control.h"
 
 
+/**
+ * @brief Monitor output modes selected with --monitor[=MODE].
+ */
+enum {
+	MONITOR_OFF = 0,	/**< No monitor output */
+	MONITOR_ANSI = 1,	/**< Interactive ANSI status screen */
+	MONITOR_JSONL = 2	/**< Streaming JSON-lines telemetry on stdout */
+};
+
+
 /**
  * @struct monitor_stats_t
  * @brief Holds statistics about the latest mouse events.
  *
  * This structure stores the most recent deltas on X and Y axes,
  * the states of the mouse buttons, and the timestamp of the last event.
+ * The timestamp is kept raw and only formatted when the monitor is drawn.
  */
 typedef struct {
 	int last_x_delta;		/**< Last movement delta on the X axis */
 	int last_y_delta;		/**< Last movement delta on the Y axis */
 	int left_button_state;		/**< State of the left mouse button (1 = pressed, 0 = released) */
 	int right_button_state;		/**< State of the right mouse button (1 = pressed, 0 = released) */
-	char last_event_time[32];	/**< Timestamp of the last detected event */
+	uint64_t last_event_ns;		/**< Event clock timestamp of the last detected event (0 = none) */
+	unsigned int polling_rate_hz;	/**< Detected polling rate of the mouse (0 = unknown) */
+	unsigned int frame_interval_us;	/**< Smoothed interval between input frames */
+	unsigned long long frames;	/**< Input frames processed (SYN_REPORT) */
+	unsigned long long syn_dropped;	/**< Kernel queue overflows reported by SYN_DROPPED */
+	unsigned long long steps_dropped;	/**< Steps dropped because the output queue was full */
 } monitor_stats_t;
 
 
@@ -36,16 +53,17 @@ void display_monitor_status(quadrature_state_t *state);
 void cleanup_screen(void);
 
 /**
- * @brief Fills a buffer with the current time as a formatted string.
+ * @brief Formats an event clock timestamp as local wall clock time.
  *
+ * @param event_ns Event clock timestamp in nanoseconds (0 = none).
  * @param buffer Pointer to the character buffer to fill.
  * @param size Size of the buffer.
  */
-void get_current_time(char *buffer, size_t size);
+void format_event_time(uint64_t event_ns, char *buffer, size_t size);
 
 
 /**
- * @brief Enables or disables monitor mode.
+ * @brief Selected monitor mode (one of the MONITOR_* values).
  */
 extern int monitor_mode;
 
@@ -0,0 +1,56 @@
+#ifndef MOUSE_EVENT_H
+#define MOUSE_EVENT_H
+
+
+#include <linux/input.h>
+
+#include "gpio_control.h"
+#include "config.h"
+
+
+#define DEFAULT_SENSITIVITY 2  // Default sensitivity (divides movement by 2)
+
+// Shortest interval between two SYN_DROPPED messages (in microseconds of event time)
+#define SYN_DROPPED_REPORT_US 1000000ULL
+
+
+/**
+ * Processes an input event and generates the corresponding GPIO signals.
+ *
+ * @param ie          Input event read from the mouse device.
+ * @param state       Pointer to the current quadrature state.
+ * @param sensitivity Divider applied to relative movements (0 = default).
+ */
+void process_mouse_event(struct input_event *ie, quadrature_state_t *state, int sensitivity);
+
+/**
+ * Builds the motion filter chains of a configuration: the top-level one
+ * and those of its device profiles. Without a chain (num_filters = -1)
+ * the gain of the active curve is applied to every event as it arrives;
+ * with one, the motion of each frame goes through the chain at SYN_REPORT.
+ * The selected profile is kept if the configuration still has it.
+ *
+ * @param cfg Configuration holding the chains.
+ */
+void mouse_event_configure(const config_t *cfg);
+
+/**
+ * Selects the filter chain of a device profile, built by
+ * mouse_event_configure(): no parsing nor allocation happens here. The
+ * state of the chain is cleared.
+ *
+ * @param index Profile index in the configuration, or -1 for the top-level chain.
+ */
+void mouse_event_select_profile(int index);
+
+/**
+ * Attaches the input device events are read from. After SYN_DROPPED, the
+ * rest of the frame is skipped and the buttons are read back from this
+ * device, so a release lost with the dropped events does not stay held.
+ *
+ * @param fd Input device, or -1 when detached or not an evdev device.
+ */
+void mouse_event_attach(int fd);
+
+
+#endif // MOUSE_EVENT_H
\ No newline at end of file
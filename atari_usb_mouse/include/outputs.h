@@ -0,0 +1,73 @@
+#ifndef OUTPUTS_H
+#define OUTPUTS_H
+
+
+#include <stddef.h>
+#include <sys/select.h>
+
+#include "config.h"
+
+
+// Steps queued per axis beyond which motion is dropped
+#define OUTPUT_MAX_PENDING 4096
+
+// Delay before reopening the input device of an output (in seconds)
+#define OUTPUT_REOPEN_S 1
+
+
+/**
+ * Starts the additional outputs of the configuration.
+ *
+ * Each output requests its own lines and runs a worker thread emitting at
+ * most one step per axis every tick_us, pinned to its CPU if one is set.
+ * Their input devices are read by the main event loop with
+ * outputs_fill_fds() and outputs_service(), and reopened when they vanish.
+ *
+ * @param cfg Configuration holding the outputs, copied.
+ * @return 0 on success, -1 on failure (no output is left running).
+ */
+int outputs_start(const config_t *cfg);
+
+/**
+ * Adds the input devices of the outputs to a select() set, reopening
+ * those that were disconnected.
+ *
+ * @param set    Set to fill.
+ * @param max_fd Highest descriptor already in the set.
+ * @return Highest descriptor in the set afterwards.
+ */
+int outputs_fill_fds(fd_set *set, int max_fd);
+
+/**
+ * Reads the pending events of the outputs and queues their motion and
+ * button changes for the workers.
+ *
+ * @param set Descriptors reported readable by select().
+ */
+void outputs_service(const fd_set *set);
+
+/**
+ * Services the outputs for up to a given time, for loops that wait
+ * without a select() of their own.
+ *
+ * @param timeout_ms Time to wait in milliseconds.
+ */
+void outputs_wait(int timeout_ms);
+
+/**
+ * Formats the statistics of every output on one line.
+ *
+ * @param buffer Destination buffer.
+ * @param size   Size of the buffer.
+ * @return Number of outputs.
+ */
+int outputs_status(char *buffer, size_t size);
+
+/**
+ * Stops the workers, drives the lines idle, releases them and prints the
+ * statistics of every output.
+ */
+void outputs_stop(void);
+
+
+#endif // OUTPUTS_H
\ No newline at end of file
@@ -0,0 +1,74 @@
+#ifndef PRECISION_H
+#define PRECISION_H
+
+
+#include <stdint.h>
+#include <pthread.h>
+
+
+// Default time spent busy-waiting before each edge (in microseconds)
+#define PRECISION_DEFAULT_SPIN_US 100
+
+// Largest number of edges in one schedule
+#define PRECISION_MAX_EDGES 256
+
+
+/**
+ * One entry of an edge schedule: the levels of the lines to drive at a
+ * given offset from the start of the schedule.
+ */
+typedef struct {
+	uint32_t offset_us;	// Time of the edge relative to the first one
+	uint32_t levels;	// Line levels after the edge (bit n = line n)
+	uint32_t mask;		// Lines the edge drives, the others keep their live level
+} edge_slot_t;
+
+
+/**
+ * Enables the precision emitter.
+ *
+ * Pulse trains are then compiled into edge schedules and each edge is
+ * reached by sleeping until spin_us before it, then busy-waiting on
+ * CLOCK_MONOTONIC_RAW. Meant for a core reserved with isolcpus=.
+ *
+ * Only the calling thread is pinned. Threads created afterwards with
+ * precision_thread_attr() run on the other CPUs, and only the memory
+ * mapped so far is locked, so their stacks are not.
+ *
+ * @param spin_us Busy-wait window before each edge, in microseconds.
+ * @param cpu     CPU to pin the emitting thread to, -1 to leave it free.
+ * @return 0 on success, -1 on failure.
+ */
+int precision_init(int spin_us, int cpu);
+
+/**
+ * Returns the attributes helper threads are created with, so that they
+ * stay off the CPU of the precision emitter.
+ *
+ * @return Attributes for pthread_create(), NULL while no CPU is reserved.
+ */
+const pthread_attr_t *precision_thread_attr(void);
+
+/**
+ * Tells whether pulse trains go through the precision emitter.
+ *
+ * @return 1 if enabled (GPIO backend only), 0 otherwise.
+ */
+int precision_enabled(void);
+
+/**
+ * Runs an edge schedule, the first edge immediately.
+ *
+ * @param slots  Edges to drive, sorted by offset.
+ * @param count  Number of edges.
+ * @param end_us Offset at which the schedule ends (no edge may follow before it).
+ */
+void precision_run(const edge_slot_t *slots, int count, uint32_t end_us);
+
+/**
+ * Prints the achieved edge jitter and the CPU cost of the emitter.
+ */
+void precision_report(void);
+
+
+#endif // PRECISION_H
\ No newline at end of file
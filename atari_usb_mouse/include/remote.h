@@ -0,0 +1,147 @@
+#ifndef REMOTE_H
+#define REMOTE_H
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+// Datagram identification and format version
+#define REMOTE_MAGIC_0 'A'
+#define REMOTE_MAGIC_1 'M'
+#define REMOTE_VERSION 1
+
+// Size of a datagram on the wire
+#define REMOTE_PACKET_SIZE 28
+
+// Interval of the sender keep-alive datagrams (in milliseconds)
+#define REMOTE_KEEPALIVE_MS 100
+
+// Default silence after which held buttons are released (in milliseconds)
+#define REMOTE_DEFAULT_BUTTON_TIMEOUT_MS 300
+
+// Sequence numbers remembered to tell late datagrams from duplicates
+#define REMOTE_WINDOW 64
+
+// Button states waiting for the event loop before the newest replaces the last
+#define REMOTE_BUTTON_QUEUE 16
+
+// Button bits of a datagram
+#define REMOTE_BUTTON_LEFT 0x01
+#define REMOTE_BUTTON_RIGHT 0x02
+
+
+/**
+ * One datagram, decoded. On the wire every field is big-endian, in this
+ * order: magic (2 bytes), version (1), buttons (1), session (4),
+ * sequence (4), dx (4), dy (4), sent_us (8).
+ */
+typedef struct {
+	uint8_t buttons;	// REMOTE_BUTTON_* held at the time of sending
+	uint32_t session;	// Random number drawn by the sender at startup
+	uint32_t seq;		// Datagram number within the session
+	int32_t dx;		// Motion since the previous datagram
+	int32_t dy;
+	uint64_t sent_us;	// Sender CLOCK_MONOTONIC time (comparable on the same host only)
+} remote_packet_t;
+
+/**
+ * Counters of the receiver.
+ */
+typedef struct {
+	unsigned long long received;	// Valid datagrams
+	unsigned long long lost;	// Sequence numbers never received
+	unsigned long long late;	// Datagrams received after a later one (motion applied)
+	unsigned long long duplicates;	// Datagrams received twice (ignored)
+	unsigned long long stale;	// Datagrams too old to check for duplicates (ignored)
+	unsigned long long invalid;	// Datagrams of the wrong size, magic or version
+	unsigned long long coalesced;	// Datagrams merged because the event loop was busy
+	unsigned long long button_timeouts;	// Buttons released for lack of datagrams
+} remote_stats_t;
+
+
+/**
+ * Encodes a datagram.
+ *
+ * @param packet Datagram to encode.
+ * @param buffer Destination, REMOTE_PACKET_SIZE bytes.
+ */
+void remote_encode(const remote_packet_t *packet, uint8_t *buffer);
+
+/**
+ * Decodes a datagram.
+ *
+ * @param buffer Received bytes.
+ * @param size   Number of received bytes.
+ * @param packet Receives the datagram.
+ * @return 0 on success, -1 if the datagram is invalid.
+ */
+int remote_decode(const uint8_t *buffer, size_t size, remote_packet_t *packet);
+
+/**
+ * Starts receiving datagrams on a UDP socket.
+ *
+ * A thread checks the sequence numbers and turns each datagram into an
+ * evdev frame (REL_X, REL_Y, BTN_LEFT, BTN_RIGHT, SYN_REPORT) stamped with
+ * CLOCK_MONOTONIC, written to a pipe. The event loop reads the pipe as it
+ * reads a device. Late datagrams only add their motion; held buttons are
+ * released when the sender goes silent for button_timeout_ms.
+ *
+ * @param listen            Address to bind: "HOST:PORT", ":PORT" or "PORT".
+ * @param button_timeout_ms Silence after which held buttons are released.
+ * @return Read end of the event pipe, or -1 on failure.
+ */
+int remote_start(const char *listen, int button_timeout_ms);
+
+/**
+ * Tells whether the input comes from the UDP receiver.
+ *
+ * @return 1 if remote_start() succeeded and remote_stop() was not called.
+ */
+int remote_active(void);
+
+/**
+ * Returns the UDP port the receiver is bound to.
+ *
+ * @return Port number, 0 if the receiver is not started.
+ */
+int remote_port(void);
+
+/**
+ * Copies the counters of the receiver.
+ *
+ * @param stats Receives the counters.
+ */
+void remote_get_stats(remote_stats_t *stats);
+
+/**
+ * Prints the counters of the receiver on one line.
+ */
+void remote_report(void);
+
+/**
+ * Stops the receiver. The read end of the pipe returned by remote_start()
+ * is left to the caller.
+ */
+void remote_stop(void);
+
+/**
+ * Opens a UDP socket connected to a receiver.
+ *
+ * @param target Receiver address: "HOST:PORT".
+ * @return Socket, or -1 on failure.
+ */
+int remote_connect(const char *target);
+
+/**
+ * Forwards the events of a local device to a receiver, one datagram per
+ * frame plus keep-alives, until the program is asked to stop.
+ *
+ * @param device_path Input device to forward.
+ * @param target      Receiver address: "HOST:PORT".
+ * @return 0 on success, -1 on failure.
+ */
+int remote_forward(const char *device_path, const char *target);
+
+
+#endif // REMOTE_H
\ No newline at end of file
@@ -0,0 +1,84 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+
+#include <stddef.h>
+#include <stdint.h>
+#include <linux/input.h>
+
+
+// Magic string at the start of an event recording
+#define RECORD_MAGIC "AUMREC01"
+
+// Name of the virtual mouse created by uinput replays
+#define REPLAY_DEVICE_NAME "Atari USB mouse replay"
+
+
+/**
+ * One recorded input event, with the original device timestamp.
+ */
+typedef struct {
+	uint64_t time_us;	// Original event timestamp in microseconds
+	uint16_t type;		// Event type (EV_REL, EV_KEY, EV_SYN...)
+	uint16_t code;		// Event code (REL_X, BTN_LEFT...)
+	int32_t value;		// Event value
+} record_event_t;
+
+/**
+ * Callback receiving replayed events.
+ *
+ * @param ie  Event with its original timestamp.
+ * @param ctx Opaque pointer passed to replay_events().
+ */
+typedef void (*replay_handler_t)(struct input_event *ie, void *ctx);
+
+
+/**
+ * Captures the event stream of an input device into a recording file.
+ * Runs until the program is asked to stop.
+ *
+ * @param device_path Input device to capture (e.g. "/dev/input/event1").
+ * @param path        Recording file to create.
+ * @return 0 on success, -1 on failure.
+ */
+int record_events(const char *device_path, const char *path);
+
+/**
+ * Feeds a recording to a handler, paced against the original timestamps.
+ *
+ * @param path    Recording file to read.
+ * @param speed   Playback speed factor (1.0 = real time, 0 = as fast as possible).
+ * @param handler Function called for every event.
+ * @param ctx     Opaque pointer passed to the handler.
+ * @return Number of replayed events, or -1 on failure.
+ */
+long replay_events(const char *path, double speed, replay_handler_t handler, void *ctx);
+
+/**
+ * Replays a recording through a uinput virtual mouse.
+ *
+ * @param path  Recording file to read.
+ * @param speed Playback speed factor (1.0 = real time, 0 = as fast as possible).
+ * @return 0 on success, -1 on failure.
+ */
+int replay_to_uinput(const char *path, double speed);
+
+/**
+ * Creates a uinput virtual mouse with relative axes and three buttons.
+ *
+ * @param name       Device name announced to the input subsystem.
+ * @param event_path Buffer receiving the event device path (may be NULL).
+ * @param size       Size of the event_path buffer.
+ * @return uinput file descriptor on success, -1 on failure.
+ */
+int create_uinput_mouse(const char *name, char *event_path, size_t size);
+
+/**
+ * Destroys a virtual mouse created with create_uinput_mouse().
+ *
+ * @param fd uinput file descriptor.
+ */
+void destroy_uinput_mouse(int fd);
+
+
+#endif // REPLAY_H
\ No newline at end of file
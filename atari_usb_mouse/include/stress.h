@@ -0,0 +1,91 @@
+#ifndef STRESS_H
+#define STRESS_H
+
+
+#include <stdint.h>
+
+
+// Traffic patterns of the stress generator
+enum {
+	STRESS_CONSTANT = 0,	// Constant velocity, diagonal
+	STRESS_CIRCLE = 1,	// One circle per second
+	STRESS_FLICK = 2,	// Fast bursts, alternating direction, silent in between
+	STRESS_JITTER = 3,	// Sensor noise: a few counts each way, every frame
+	STRESS_BUTTONS = 4,	// Button storm: every frame toggles a button
+	NUM_STRESS_PATTERNS = 5
+};
+
+// Frame rates accepted by the generator (in frames per second)
+#define STRESS_MAX_RATE 8000
+#define STRESS_DEFAULT_RATE 1000
+
+// Default duration of a run (in seconds)
+#define STRESS_DEFAULT_SECONDS 10
+
+// Interval between two status reads from the daemon under test (in milliseconds)
+#define STRESS_SAMPLE_MS 100
+
+
+/**
+ * Parameters of a stress run.
+ */
+typedef struct {
+	int pattern;		// STRESS_*
+	int rate_hz;		// Frames per second while the pattern moves
+	int seconds;		// Duration of the traffic
+} stress_params_t;
+
+/**
+ * One generated input frame.
+ */
+typedef struct {
+	int send;		// 0 when the pattern is idle for this frame
+	int dx;			// REL_X
+	int dy;			// REL_Y
+	int buttons;		// Bit 0 = left, bit 1 = right
+} stress_frame_t;
+
+
+/**
+ * Parses a pattern name.
+ *
+ * @return STRESS_* value, or -1 if the name is unknown.
+ */
+int parse_stress_pattern(const char *name);
+
+/**
+ * Returns the name of a STRESS_* value.
+ */
+const char *stress_pattern_name(int pattern);
+
+/**
+ * Computes frame number index of a pattern. The sequence depends only on
+ * the pattern, the rate and the index, so every run of a profile sends the
+ * same events.
+ *
+ * @param pattern STRESS_* value.
+ * @param rate_hz Frame rate of the run.
+ * @param index   Frame number from the start of the run.
+ * @param frame   Receives the frame.
+ */
+void stress_frame(int pattern, int rate_hz, uint64_t index, stress_frame_t *frame);
+
+/**
+ * Runs this binary as the daemon under test on a uinput mouse and sends it
+ * a traffic pattern.
+ *
+ * The daemon gets the configuration file, the virtual mouse and a private
+ * control socket, which is read every STRESS_SAMPLE_MS to follow its
+ * backlog. The report gives, on stdout as one JSON object: frames sent and
+ * refused by uinput, frames the daemon processed, SYN_DROPPED reports,
+ * the largest backlog, the daemon p99 input-to-output latency and its CPU
+ * usage. Requires access to /dev/uinput.
+ *
+ * @param config_path Configuration file passed to the daemon under test.
+ * @param params      Pattern, rate and duration.
+ * @return 0 on success, -1 on failure.
+ */
+int run_stress(const char *config_path, const stress_params_t *params);
+
+
+#endif // STRESS_H
\ No newline at end of file
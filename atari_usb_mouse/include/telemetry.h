@@ -0,0 +1,59 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+
+#include <stdint.h>
+#include <sys/time.h>
+
+
+// Size of the bounded output queue between the event loop and the consumer
+#define TELEMETRY_QUEUE_SIZE 65536
+
+
+/**
+ * @brief Prepares the JSON-lines writer on stdout.
+ *
+ * The feed is written only as far as the consumer has room, so a slow
+ * consumer can never stall the event loop. Info messages go to stderr
+ * meanwhile: the feed must be the only writer of stdout.
+ *
+ * @param interval_ms Aggregation interval in milliseconds (0 = one record per frame).
+ * @return 0 on success, -1 on failure.
+ */
+int telemetry_init(unsigned int interval_ms);
+
+/**
+ * @brief Flushes what the consumer accepts.
+ */
+void telemetry_cleanup(void);
+
+/**
+ * @brief Accounts a motion event of the current frame.
+ *
+ * @param axis      0 for X, 1 for Y.
+ * @param rel       Raw delta reported by the input device.
+ * @param pulses    Number of quadrature steps emitted for it.
+ * @param event_tv  Input timestamp of the event.
+ */
+void telemetry_add_motion(int axis, int rel, int pulses, const struct timeval *event_tv);
+
+/**
+ * @brief Closes the current input frame and queues a record when due.
+ *
+ * @param buttons   Current button bitmask (bit 0 = left, bit 1 = right).
+ * @param event_tv  Input timestamp of the SYN_REPORT event.
+ */
+void telemetry_frame_end(int buttons, const struct timeval *event_tv);
+
+/**
+ * @brief Writes as much queued data as the consumer accepts without blocking.
+ */
+void telemetry_flush(void);
+
+/**
+ * @brief Number of records dropped because the consumer was too slow.
+ */
+extern uint64_t telemetry_dropped;
+
+
+#endif // TELEMETRY_H
\ No newline at end of file
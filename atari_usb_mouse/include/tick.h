@@ -0,0 +1,73 @@
+#ifndef TICK_H
+#define TICK_H
+
+
+#include <stdint.h>
+
+#include "gpio_control.h"
+#include "ikbd_model.h"
+
+
+/**
+ * Default tick period (in microseconds): two IKBD samples per step, so
+ * every quadrature level is seen at least once.
+ */
+#define TICK_DEFAULT_US (2 * IKBD_SAMPLE_US)
+
+// Accepted range of the tick period
+#define TICK_MIN_US 50
+#define TICK_MAX_US 100000
+
+// Steps queued per axis beyond which motion is dropped
+#define TICK_MAX_PENDING 4096
+
+
+/**
+ * Starts the fixed-rate output: from now on motion is queued with
+ * tick_add() and emitted at most one step per axis and per tick.
+ *
+ * With the GPIO backend a thread drives the lines on CLOCK_MONOTONIC and
+ * sleeps while nothing is queued. With the null backend ticks are run
+ * from tick_advance() on the virtual clock, so traces stay deterministic.
+ *
+ * @param state     Quadrature state updated by the ticks.
+ * @param period_us Tick period in microseconds.
+ * @return 0 on success, -1 on failure.
+ */
+int tick_start(quadrature_state_t *state, unsigned int period_us);
+
+/**
+ * Stops the tick thread. Queued motion is dropped.
+ */
+void tick_stop(void);
+
+/**
+ * Queues quadrature steps on one axis. Steps beyond TICK_MAX_PENDING are
+ * dropped and counted in stats.steps_dropped.
+ *
+ * @param axis  0 for X, 1 for Y.
+ * @param steps Signed number of steps.
+ */
+void tick_add(int axis, int steps);
+
+/**
+ * Runs the ticks due up to an output clock time (null backend only).
+ *
+ * @param time_ns Output clock time in nanoseconds.
+ */
+void tick_advance(uint64_t time_ns);
+
+/**
+ * Waits until every queued step has been emitted.
+ */
+void tick_flush(void);
+
+/**
+ * Tells whether the fixed-rate output is running.
+ *
+ * @return 1 if tick_start() succeeded and tick_stop() was not called.
+ */
+int tick_enabled(void);
+
+
+#endif // TICK_H
\ No newline at end of file
@@ -0,0 +1,69 @@
+#ifndef VCD_H
+#define VCD_H
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+// Transitions queued between the output path and the writer thread
+#define VCD_QUEUE_SIZE 8192
+
+// Idle time shown before the first transition, which the dump is timed from (in nanoseconds)
+#define VCD_LEAD_NS 1000ULL
+
+// Longest the writer sleeps before draining a partly filled queue (in milliseconds)
+#define VCD_DRAIN_MS 20
+
+
+/**
+ * Formats one transition as VCD text: the timestamp, unless it equals the
+ * previous one, then one value change per toggled line.
+ *
+ * @param buffer   Destination, at least 32 + 4 * NUM_LINES bytes.
+ * @param time_ns  Time of the transition in the dump.
+ * @param last_ns  Timestamp written last, updated.
+ * @param levels   Levels of all lines after the transition.
+ * @param changed  Lines that toggled.
+ * @return Number of bytes written, without terminator.
+ */
+size_t vcd_format_change(char *buffer, uint64_t time_ns, uint64_t *last_ns, uint32_t levels, uint32_t changed);
+
+/**
+ * Creates a VCD file with one wire per mouse line and starts its writer.
+ *
+ * Transitions are queued by vcd_record() and written by a thread of their
+ * own, so the output path never waits on the file. When lossless is set
+ * the output path waits for room instead of dropping transitions, which
+ * suits replays on the null backend where every edge matters and no
+ * hardware deadline is at stake.
+ *
+ * Times in the file are relative to the first transition, which comes
+ * VCD_LEAD_NS after the initial levels: the output clock of the null
+ * backend follows the input timestamps, far from its value when the dump
+ * is opened.
+ *
+ * @param path     Path of the file to create.
+ * @param levels   Line levels at the start of the dump.
+ * @param lossless Wait for room rather than drop transitions when the queue is full.
+ * @return 0 on success, -1 on failure.
+ */
+int vcd_open(const char *path, uint32_t levels, int lossless);
+
+/**
+ * Queues a line transition. Does nothing when no dump is open.
+ *
+ * @param time_ns Output clock timestamp of the transition.
+ * @param levels  Levels of all lines after the transition.
+ * @param changed Lines that toggled.
+ */
+void vcd_record(uint64_t time_ns, uint32_t levels, uint32_t changed);
+
+/**
+ * Writes the queued transitions, stops the writer and closes the file.
+ * A failed write or close is reported, as are dropped transitions.
+ */
+void vcd_close(void);
+
+
+#endif // VCD_H
\ No newline at end of file
@@ -0,0 +1,72 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+
+#include <stdint.h>
+
+
+// Default time a stage may stay busy without progress (in microseconds)
+#define WATCHDOG_DEFAULT_STALL_US 20000
+
+// Pipeline stages watched by the stall detector
+enum {
+	STAGE_INPUT = 0,	// Event loop, from select() returning to the next select()
+	STAGE_OUTPUT = 1,	// One line write, including the GPIO ioctl
+	NUM_STAGES = 2
+};
+
+
+/**
+ * Starts the stall detector and reads the systemd watchdog period.
+ *
+ * A stage busy for more than stall_us without progress is reported with
+ * its name and duration, and suspends watchdog pings until it recovers,
+ * so systemd restarts a daemon stuck in a GPIO ioctl.
+ *
+ * @param stall_us Stall threshold in microseconds, 0 to disable the detector.
+ * @return 0 on success, -1 if the detector thread cannot start.
+ */
+int watchdog_init(int stall_us);
+
+/**
+ * Stops the stall detector and closes the notification socket.
+ */
+void watchdog_cleanup(void);
+
+/**
+ * Sends a state string to systemd ("READY=1", "RELOADING=1"...).
+ * Does nothing when the daemon was not started with Type=notify.
+ *
+ * @param state Newline-separated assignments, as for sd_notify().
+ */
+void watchdog_notify(const char *state);
+
+/**
+ * Pings the systemd watchdog from the event loop, at half its period.
+ * Pings are withheld while a stage is stalled.
+ */
+void watchdog_ping(void);
+
+/**
+ * Marks a stage busy from now.
+ *
+ * @param stage STAGE_* value.
+ */
+void stall_enter(int stage);
+
+/**
+ * Marks a stage idle, reporting the end of a stall.
+ *
+ * @param stage STAGE_* value.
+ */
+void stall_leave(int stage);
+
+/**
+ * Restarts the stall deadline of a busy stage that made progress.
+ *
+ * @param stage STAGE_* value.
+ */
+void stall_progress(int stage);
+
+
+#endif // WATCHDOG_H
\ No newline at end of file
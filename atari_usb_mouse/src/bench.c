@@ -0,0 +1,710 @@
+/**
+ * @file bench.c
+ * @brief Micro and macro benchmarks of the event pipeline.
+ *
+ * Every benchmark runs the real code against the null output backend, so
+ * no GPIO line is touched and pacing delays cost nothing (the IKBD output
+ * is measured on a pty, at its real line rate). Each one prints
+ * a single JSON object with wall and CPU time per operation. When built
+ * with BENCH_COUNTERS (see `make bench`), allocations and syscall entry
+ * points called from our code are counted through linker wrappers.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <linux/input.h>
+
+#include "bench.h"
+#include "config.h"
+#include "device_detection.h"
+#include "filter.h"
+#include "gpio_control.h"
+#include "ikbd_serial.h"
+#include "joystick.h"
+#include "latency.h"
+#include "monitor.h"
+#include "mouse_event.h"
+#include "remote.h"
+#include "replay.h"
+#include "vcd.h"
+#include "global.h"
+
+
+// Minimum measuring time of a benchmark (in nanoseconds)
+#define BENCH_MIN_NS 200000000ULL
+
+// Number of frames in the synthetic event stream
+#define SYNTHETIC_FRAMES 4096
+
+
+#ifdef BENCH_COUNTERS
+
+static unsigned long alloc_count = 0;
+static unsigned long syscall_count = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+	alloc_count++;
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size) {
+	alloc_count++;
+	return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+	alloc_count++;
+	return __real_realloc(ptr, size);
+}
+
+// Defines a linker wrapper counting calls to a libc entry point that enters the kernel
+#define COUNTED_SYSCALL(ret, name, proto, args) \
+	ret __real_##name proto; \
+	ret __wrap_##name proto { \
+		syscall_count++; \
+		return __real_##name args; \
+	}
+
+COUNTED_SYSCALL(ssize_t, read, (int fd, void *buf, size_t count), (fd, buf, count))
+COUNTED_SYSCALL(ssize_t, write, (int fd, const void *buf, size_t count), (fd, buf, count))
+COUNTED_SYSCALL(ssize_t, writev, (int fd, const struct iovec *iov, int iovcnt), (fd, iov, iovcnt))
+COUNTED_SYSCALL(int, close, (int fd), (fd))
+COUNTED_SYSCALL(int, select, (int nfds, fd_set *r, fd_set *w, fd_set *e, struct timeval *t), (nfds, r, w, e, t))
+COUNTED_SYSCALL(int, usleep, (useconds_t usec), (usec))
+COUNTED_SYSCALL(int, nanosleep, (const struct timespec *req, struct timespec *rem), (req, rem))
+COUNTED_SYSCALL(int, clock_nanosleep, (clockid_t clk, int flags, const struct timespec *req, struct timespec *rem), (clk, flags, req, rem))
+COUNTED_SYSCALL(FILE *, fopen, (const char *path, const char *mode), (path, mode))
+COUNTED_SYSCALL(int, fclose, (FILE *fp), (fp))
+
+int __real_open(const char *path, int flags, ...);
+int __wrap_open(const char *path, int flags, ...) {
+	mode_t mode = 0;
+
+	if (flags & O_CREAT) {
+		va_list ap;
+		va_start(ap, flags);
+		mode = va_arg(ap, mode_t);
+		va_end(ap);
+	}
+	syscall_count++;
+	return __real_open(path, flags, mode);
+}
+
+int __real_ioctl(int fd, unsigned long request, ...);
+int __wrap_ioctl(int fd, unsigned long request, ...) {
+	va_list ap;
+	va_start(ap, request);
+	void *arg = va_arg(ap, void *);
+	va_end(ap);
+	syscall_count++;
+	return __real_ioctl(fd, request, arg);
+}
+
+#endif
+
+
+/**
+ * Measurements of one benchmark run.
+ */
+typedef struct {
+	const char *name;	// Benchmarked function
+	const char *input;	// Input description (synthetic, recording...)
+	const char *op;		// Unit of work counted in ops
+	unsigned long ops;	// Number of operations performed
+	uint64_t wall_ns;	// Elapsed wall time
+	uint64_t cpu_ns;	// CPU time consumed by the process
+	unsigned long allocs;	// Allocations during the run
+	unsigned long syscalls;	// Syscall entry points called during the run
+} bench_result_t;
+
+// Events fed to the event pipeline benchmarks
+typedef struct {
+	struct input_event *events;
+	size_t count;
+	size_t capacity;
+} event_stream_t;
+
+static volatile int bench_sink;
+
+
+// Reads a clock in nanoseconds.
+static uint64_t clock_ns(clockid_t clk) {
+	struct timespec ts;
+	clock_gettime(clk, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Starts measuring a benchmark.
+static void bench_start(bench_result_t *r, const char *name, const char *input, const char *op) {
+	memset(r, 0, sizeof(*r));
+	r->name = name;
+	r->input = input;
+	r->op = op;
+#ifdef BENCH_COUNTERS
+	r->allocs = alloc_count;
+	r->syscalls = syscall_count;
+#endif
+	r->cpu_ns = clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+	r->wall_ns = clock_ns(CLOCK_MONOTONIC);
+}
+
+// Returns non-zero while a benchmark has not run long enough.
+static int bench_running(const bench_result_t *r) {
+	return clock_ns(CLOCK_MONOTONIC) - r->wall_ns < BENCH_MIN_NS;
+}
+
+// Stops measuring a benchmark.
+static void bench_stop(bench_result_t *r) {
+	r->wall_ns = clock_ns(CLOCK_MONOTONIC) - r->wall_ns;
+	r->cpu_ns = clock_ns(CLOCK_PROCESS_CPUTIME_ID) - r->cpu_ns;
+#ifdef BENCH_COUNTERS
+	r->allocs = alloc_count - r->allocs;
+	r->syscalls = syscall_count - r->syscalls;
+#endif
+}
+
+// Prints a stopped benchmark as a JSON object.
+static void bench_print(const bench_result_t *r) {
+	double ops = r->ops ? (double)r->ops : 1.0;
+
+	printf("{\"bench\":\"%s\",\"input\":\"%s\",\"op\":\"%s\",\"ops\":%lu,"
+		"\"ns_per_op\":%.1f,\"ops_per_s\":%.0f,\"cpu_ns_per_op\":%.1f,",
+		r->name, r->input, r->op, r->ops,
+		(double)r->wall_ns / ops, ops * 1e9 / (double)(r->wall_ns ? r->wall_ns : 1),
+		(double)r->cpu_ns / ops);
+#ifdef BENCH_COUNTERS
+	printf("\"allocs_per_op\":%.3f,\"syscalls_per_op\":%.3f}\n",
+		(double)r->allocs / ops, (double)r->syscalls / ops);
+#else
+	printf("\"allocs_per_op\":null,\"syscalls_per_op\":null}\n");
+#endif
+	fflush(stdout);
+}
+
+// Stops measuring and prints the result.
+static void bench_report(bench_result_t *r) {
+	bench_stop(r);
+	bench_print(r);
+}
+
+// Appends an event to a stream.
+static int stream_push(event_stream_t *s, uint64_t time_us, int type, int code, int value) {
+	if (s->count == s->capacity) {
+		size_t capacity = s->capacity ? s->capacity * 2 : 1024;
+		struct input_event *events = realloc(s->events, capacity * sizeof(*events));
+		if (events == NULL) {
+			return -1;
+		}
+		s->events = events;
+		s->capacity = capacity;
+	}
+
+	struct input_event *ie = &s->events[s->count++];
+	memset(ie, 0, sizeof(*ie));
+	ie->time.tv_sec = (time_t)(time_us / 1000000ULL);
+	ie->time.tv_usec = (suseconds_t)(time_us % 1000000ULL);
+	ie->type = type;
+	ie->code = code;
+	ie->value = value;
+	return 0;
+}
+
+// Collects replayed events into a stream.
+static void stream_handler(struct input_event *ie, void *ctx) {
+	event_stream_t *s = ctx;
+	stream_push(s, (uint64_t)ie->time.tv_sec * 1000000ULL + (uint64_t)ie->time.tv_usec, ie->type, ie->code, ie->value);
+}
+
+// Builds a synthetic 1 kHz stream mixing slow and fast motion with clicks.
+static int build_synthetic_stream(event_stream_t *s) {
+	uint64_t t = 1000000;
+
+	for (int i = 0; i < SYNTHETIC_FRAMES; i++, t += 1000) {
+		int speed = (i / 256) % 2 ? 24 : 3;	// Alternate slow and fast phases
+		int dx = (i % 64 < 32) ? speed : -speed;
+		int dy = (i % 128 < 64) ? speed / 2 + 1 : -(speed / 2 + 1);
+
+		if (stream_push(s, t, EV_REL, REL_X, dx) < 0 ||
+			stream_push(s, t, EV_REL, REL_Y, dy) < 0) {
+			return -1;
+		}
+		if (i % 64 == 0 && stream_push(s, t, EV_KEY, BTN_LEFT, (i / 64) % 2) < 0) {
+			return -1;
+		}
+		if (stream_push(s, t, EV_SYN, SYN_REPORT, 0) < 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+// Runs an event stream through process_mouse_event().
+static void bench_process_events(const event_stream_t *s, const char *input) {
+	quadrature_state_t state = {0, 0, 0, 0, 0, 0};
+	bench_result_t r;
+
+	bench_start(&r, "process_mouse_event", input, "event");
+	do {
+		for (size_t i = 0; i < s->count; i++) {
+			struct input_event ie = s->events[i];
+			process_mouse_event(&ie, &state, config.sensitivity);
+		}
+		r.ops += s->count;
+	} while (bench_running(&r));
+	bench_report(&r);
+}
+
+// Benchmarks the quadrature pulse generators, one step per operation.
+static void bench_pulses(void) {
+	quadrature_state_t state = {0, 0, 0, 0, 0, 0};
+	bench_result_t r;
+
+	bench_start(&r, "generate_x_pulses", "deltas 1..16", "step");
+	do {
+		for (int delta = 1; delta <= 16; delta++) {
+			generate_x_pulses(&state, delta);
+			generate_x_pulses(&state, -delta);
+			r.ops += 2 * delta;
+		}
+	} while (bench_running(&r));
+	bench_report(&r);
+
+	bench_start(&r, "generate_y_pulses", "deltas 1..16", "step");
+	do {
+		for (int delta = 1; delta <= 16; delta++) {
+			generate_y_pulses(&state, delta);
+			generate_y_pulses(&state, -delta);
+			r.ops += 2 * delta;
+		}
+	} while (bench_running(&r));
+	bench_report(&r);
+}
+
+// Benchmarks the adaptive delay computation.
+static void bench_calculate_delay(void) {
+	bench_result_t r;
+
+	bench_start(&r, "calculate_delay", "pulses 0..63", "call");
+	do {
+		for (int pulses = 0; pulses < 64; pulses++) {
+			bench_sink += calculate_delay(pulses);
+		}
+		r.ops += 64;
+	} while (bench_running(&r));
+	bench_report(&r);
+}
+
+// Benchmarks the motion filter chain on synthetic frames, one result per chain.
+static void bench_filters(void) {
+	static const struct {
+		const char *name;
+		int count;
+		filter_config_t stages[4];
+	} chains[] = {
+		{ "pass-through", 0, { { 0, 0, 0 } } },
+		{ "curve", 1, { { FILTER_CURVE, 3, 0 } } },
+		{ "invert+swap+curve", 3, { { FILTER_INVERT, 1, 0 }, { FILTER_SWAP, 3, 0 }, { FILTER_CURVE, 3, 0 } } },
+		{ "deadzone+smooth+curve+rate_cap", 4, { { FILTER_DEADZONE, 3, 1 }, { FILTER_SMOOTH, 3, 50 },
+			{ FILTER_CURVE, 3, 0 }, { FILTER_RATE_CAP, 3, 40 } } }
+	};
+	static filter_chain_t chain;
+	bench_result_t r;
+
+	for (size_t i = 0; i < sizeof(chains) / sizeof(chains[0]); i++) {
+		motion_frame_t frame = { { 0, 0 }, 0 };
+		uint64_t time_us = 1000000;
+
+		filter_chain_build(&chain, chains[i].stages, chains[i].count);
+		bench_start(&r, "filter_chain_run", chains[i].name, "frame");
+		do {
+			// 1 kHz frames sweeping slow to fast motion
+			for (int step = 0; step < 64; step++) {
+				time_us += 1000;
+				frame.d[0] = step - 32;
+				frame.d[1] = (step * 7) % 23 - 11;
+				frame.time_us = time_us;
+				filter_chain_run(&chain, &frame, active_curve(), DEFAULT_SENSITIVITY);
+				bench_sink += frame.d[0] + frame.d[1];
+			}
+			r.ops += 64;
+		} while (bench_running(&r));
+		bench_report(&r);
+	}
+}
+
+// Benchmarks the joystick mapping: stick sweeps and fire presses through the threshold table.
+static void bench_joystick(void) {
+	static const int sweep[] = { -32767, -20000, -8000, 0, 8000, 20000, 32767, 0 };
+	struct input_event ie = { { 0, 0 }, EV_ABS, ABS_X, 0 };
+	joystick_map_t map;
+	bench_result_t r;
+
+	joystick_map_init(&map, -1, JOYSTICK_DEFAULT_THRESHOLD);
+	bench_start(&r, "joystick_map_event", "sweep", "event");
+	do {
+		for (size_t i = 0; i < sizeof(sweep) / sizeof(sweep[0]); i++) {
+			ie.type = EV_ABS;
+			ie.code = (i & 1) ? ABS_Y : ABS_X;
+			ie.value = sweep[i];
+			bench_sink += (int)joystick_map_event(&map, &ie);
+			ie.type = EV_KEY;
+			ie.code = BTN_SOUTH;
+			ie.value = (int)(i & 1);
+			bench_sink += (int)joystick_map_event(&map, &ie);
+		}
+		r.ops += 2 * sizeof(sweep) / sizeof(sweep[0]);
+	} while (bench_running(&r));
+	bench_report(&r);
+}
+
+// Cost of the VCD dump: formatting, and queueing as seen by the output path.
+static void bench_vcd(void) {
+	char text[32 + 4 * NUM_LINES];
+	uint64_t last_ns = 0;
+	uint32_t levels = 0;
+	bench_result_t r;
+
+	bench_start(&r, "vcd_format_change", "quadrature", "edge");
+	do {
+		for (int i = 0; i < 256; i++) {
+			uint32_t changed = 1u << (i & 1);
+			levels ^= changed;
+			bench_sink += (int)vcd_format_change(text, r.ops * 1250ULL + (uint64_t)i, &last_ns, levels, changed);
+		}
+		r.ops += 256;
+	} while (bench_running(&r));
+	bench_report(&r);
+
+	// Dropping mode, as on a live run: the writer keeps up or records are lost
+	if (vcd_open("/dev/null", 0, 0) < 0) {
+		return;
+	}
+	bench_start(&r, "vcd_record", "quadrature", "edge");
+	do {
+		for (int i = 0; i < 256; i++) {
+			uint32_t changed = 1u << (i & 1);
+			levels ^= changed;
+			vcd_record(clock_ns(CLOCK_MONOTONIC), levels, changed);
+		}
+		r.ops += 256;
+	} while (bench_running(&r));
+	bench_report(&r);
+	vcd_close();
+}
+
+// Benchmarks functions printing on stdout, with stdout sent to /dev/null.
+static void bench_quiet_output(void) {
+	quadrature_state_t state = {0, 0, 0, 0, 0, 0};
+	int saved_monitor = monitor_mode;
+	bench_result_t display, scan;
+
+	fflush(stdout);
+	int saved_stdout = dup(STDOUT_FILENO);
+	int devnull = open("/dev/null", O_WRONLY);
+	if (saved_stdout < 0 || devnull < 0) {
+		ERROR_PRINT("Cannot redirect stdout for benchmarks\n");
+		return;
+	}
+	dup2(devnull, STDOUT_FILENO);
+
+	monitor_mode = MONITOR_ANSI;
+	bench_start(&display, "display_monitor_status", "ansi", "refresh");
+	do {
+		display_monitor_status(&state);
+		display.ops++;
+	} while (bench_running(&display));
+	bench_stop(&display);
+	monitor_mode = saved_monitor;
+
+	bench_start(&scan, "find_mouse_device", "/proc/bus/input/devices", "scan");
+	do {
+		bench_sink += (find_mouse_device() != NULL);
+		scan.ops++;
+	} while (bench_running(&scan));
+	fflush(stdout);
+	bench_stop(&scan);
+
+	dup2(saved_stdout, STDOUT_FILENO);
+	close(saved_stdout);
+	close(devnull);
+
+	bench_print(&display);
+	bench_print(&scan);
+}
+
+// Waits up to 100 ms for events on the remote input pipe and drains them.
+static int drain_remote(int fd, int wait) {
+	struct input_event events[64];
+	fd_set readfds;
+	struct timeval timeout = { 0, wait ? 100000 : 0 };
+	int count = 0;
+
+	FD_ZERO(&readfds);
+	FD_SET(fd, &readfds);
+	if (select(fd + 1, &readfds, NULL, NULL, &timeout) <= 0) {
+		return 0;
+	}
+	ssize_t bytes;
+	while ((bytes = read(fd, events, sizeof(events))) > 0) {
+		count += (int)((size_t)bytes / sizeof(events[0]));
+	}
+	return count;
+}
+
+// Benchmarks the UDP input over loopback: added latency, then datagram rate.
+static void bench_remote(void) {
+	remote_packet_t packet = { 0, 1, 0, 1, 0, 0 };
+	uint8_t buffer[REMOTE_PACKET_SIZE];
+	latency_hist_t latency;
+	remote_stats_t before, after;
+	bench_result_t r;
+	char target[32];
+
+	int fd = remote_start("127.0.0.1:0", REMOTE_DEFAULT_BUTTON_TIMEOUT_MS);
+	if (fd < 0) {
+		return;
+	}
+	snprintf(target, sizeof(target), "127.0.0.1:%d", remote_port());
+	int sock = remote_connect(target);
+	if (sock < 0) {
+		remote_stop();
+		close(fd);
+		return;
+	}
+
+	// One datagram in flight: time from send() to its frame in the pipe
+	memset(&latency, 0, sizeof(latency));
+	bench_start(&r, "remote_receive", "loopback", "datagram");
+	do {
+		uint64_t sent_ns = clock_ns(CLOCK_MONOTONIC);
+		remote_encode(&packet, buffer);
+		send(sock, buffer, sizeof(buffer), 0);
+		packet.seq++;
+		if (drain_remote(fd, 1) == 0) {
+			break;
+		}
+		latency_record(&latency, clock_ns(CLOCK_MONOTONIC) - sent_ns);
+		r.ops++;
+	} while (bench_running(&r));
+	bench_report(&r);
+	printf("{\"bench\":\"remote_latency\",\"input\":\"loopback\",\"samples\":%llu,"
+		"\"p50_us\":%llu,\"p99_us\":%llu,\"max_us\":%llu}\n",
+		(unsigned long long)latency.count, (unsigned long long)latency_percentile(&latency, 50),
+		(unsigned long long)latency_percentile(&latency, 99), (unsigned long long)latency.max_us);
+
+	// Back-to-back datagrams: rate the receiver keeps up with
+	remote_get_stats(&before);
+	bench_start(&r, "remote_throughput", "loopback", "datagram");
+	do {
+		for (int i = 0; i < 32; i++) {
+			remote_encode(&packet, buffer);
+			send(sock, buffer, sizeof(buffer), 0);
+			packet.seq++;
+		}
+		drain_remote(fd, 0);
+	} while (bench_running(&r));
+	while (drain_remote(fd, 1) > 0);
+	remote_get_stats(&after);
+	r.ops = (unsigned long)(after.received - before.received);
+	bench_report(&r);
+	printf("{\"bench\":\"remote_throughput_losses\",\"input\":\"loopback\",\"lost\":%llu,"
+		"\"late\":%llu,\"coalesced\":%llu}\n",
+		after.lost - before.lost, after.late - before.late, after.coalesced - before.coalesced);
+	fflush(stdout);
+
+	close(sock);
+	remote_stop();
+	close(fd);
+}
+
+// Packets read back from the master side of the IKBD pty
+typedef struct {
+	uint8_t partial[IKBD_PACKET_SIZE];
+	int filled;
+	unsigned long packets;
+	long counts;	// X counts carried, summed
+} ikbd_reader_t;
+
+// Waits up to 100 ms for IKBD bytes on the pty master and decodes the packets.
+static int drain_ikbd(int fd, int wait, ikbd_reader_t *reader) {
+	uint8_t bytes[256];
+	fd_set readfds;
+	struct timeval timeout = { 0, wait ? 100000 : 0 };
+	int packets = 0;
+
+	FD_ZERO(&readfds);
+	FD_SET(fd, &readfds);
+	if (select(fd + 1, &readfds, NULL, NULL, &timeout) <= 0) {
+		return 0;
+	}
+	ssize_t size;
+	while ((size = read(fd, bytes, sizeof(bytes))) > 0) {
+		for (ssize_t i = 0; i < size; i++) {
+			reader->partial[reader->filled++] = bytes[i];
+			if (reader->filled == IKBD_PACKET_SIZE) {
+				reader->counts += (int8_t)reader->partial[1];
+				reader->packets++;
+				reader->filled = 0;
+				packets++;
+			}
+		}
+	}
+	return packets;
+}
+
+// Benchmarks the IKBD serial output over a pty: packet latency and rate, and
+// the time a flick takes as packets against quadrature edges.
+static void bench_ikbd(void) {
+	static const int flicks[] = { 64, 254, 1000, 4000 };
+	quadrature_state_t state = { 0 };
+	ikbd_reader_t reader = { { 0 }, 0, 0, 0 };
+	latency_hist_t latency;
+	bench_result_t r;
+	int saved_backend = output_backend;
+
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) {
+		ERROR_PRINT("Cannot open a pty for the IKBD benchmark: %s\n", strerror(errno));
+		if (master >= 0) {
+			close(master);
+		}
+		return;
+	}
+	fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+	if (ikbd_serial_open(ptsname(master)) < 0) {
+		close(master);
+		return;
+	}
+	output_backend = OUTPUT_IKBD;
+
+	// One small move on an idle line: time until its packet is readable
+	memset(&latency, 0, sizeof(latency));
+	bench_start(&r, "ikbd_packet", "pty", "packet");
+	do {
+		uint64_t sent_ns = clock_ns(CLOCK_MONOTONIC);
+		generate_x_pulses(&state, (r.ops & 1) ? 1 : -1);
+		if (drain_ikbd(master, 1, &reader) == 0) {
+			break;
+		}
+		latency_record(&latency, clock_ns(CLOCK_MONOTONIC) - sent_ns);
+		r.ops++;
+		// Next move after the line is free again
+		usleep((useconds_t)(IKBD_PACKET_NS / 1000ULL));
+	} while (bench_running(&r));
+	bench_report(&r);
+	printf("{\"bench\":\"ikbd_latency\",\"input\":\"pty\",\"samples\":%llu,"
+		"\"p50_us\":%llu,\"p99_us\":%llu,\"max_us\":%llu}\n",
+		(unsigned long long)latency.count, (unsigned long long)latency_percentile(&latency, 50),
+		(unsigned long long)latency_percentile(&latency, 99), (unsigned long long)latency.max_us);
+
+	// Continuous motion: packets per second at the line rate
+	reader.packets = 0;
+	bench_start(&r, "ikbd_throughput", "pty", "packet");
+	do {
+		generate_x_pulses(&state, -IKBD_MAX_COUNT);
+		drain_ikbd(master, 1, &reader);
+	} while (bench_running(&r));
+	bench_stop(&r);
+	r.ops = reader.packets;
+	bench_print(&r);
+	ikbd_serial_flush();
+	while (drain_ikbd(master, 1, &reader) > 0);
+
+	// A flick: last packet against the quadrature train of the same counts
+	for (size_t i = 0; i < sizeof(flicks) / sizeof(flicks[0]); i++) {
+		reader.counts = 0;
+		uint64_t start_ns = clock_ns(CLOCK_MONOTONIC);
+		generate_x_pulses(&state, -flicks[i]);
+		while (reader.counts < flicks[i] && drain_ikbd(master, 1, &reader) > 0);
+		uint64_t ikbd_ns = clock_ns(CLOCK_MONOTONIC) - start_ns;
+		printf("{\"bench\":\"ikbd_flick\",\"input\":\"pty\",\"counts\":%d,\"received\":%ld,"
+			"\"ikbd_us\":%llu,\"quadrature_us\":%llu}\n",
+			flicks[i], reader.counts, (unsigned long long)(ikbd_ns / 1000ULL),
+			(unsigned long long)flicks[i] * (unsigned long long)calculate_delay(flicks[i]));
+	}
+	fflush(stdout);
+
+	output_backend = saved_backend;
+	ikbd_serial_close();
+	close(master);
+}
+
+// Clears the pipeline counters, so a benchmark does not inherit the clock or samples of the previous one.
+static void reset_counters(void) {
+	memset(&button_latency, 0, sizeof(button_latency));
+	memset(&motion_latency, 0, sizeof(motion_latency));
+	memset(&stats, 0, sizeof(stats));
+}
+
+// Runs the micro and macro benchmarks of the event pipeline.
+int run_benchmarks(const char *replay_file) {
+	event_stream_t synthetic = { NULL, 0, 0 };
+	event_stream_t recorded = { NULL, 0, 0 };
+	int saved_monitor = monitor_mode;
+	int saved_debug = debug_mode;
+	latency_hist_t saved_button_latency = button_latency;
+	latency_hist_t saved_motion_latency = motion_latency;
+	monitor_stats_t saved_stats = stats;
+
+	// Measure the pipeline itself, not the debug or monitor output
+	monitor_mode = MONITOR_OFF;
+	debug_mode = 0;
+
+	if (build_synthetic_stream(&synthetic) < 0) {
+		ERROR_PRINT("Cannot build synthetic event stream\n");
+		free(synthetic.events);
+		return -1;
+	}
+	if (replay_file != NULL && replay_events(replay_file, 0, stream_handler, &recorded) < 0) {
+		free(synthetic.events);
+		return -1;
+	}
+
+	reset_counters();
+	bench_calculate_delay();
+	reset_counters();
+	bench_pulses();
+	reset_counters();
+	bench_filters();
+	reset_counters();
+	bench_joystick();
+	reset_counters();
+	bench_vcd();
+	reset_counters();
+	bench_process_events(&synthetic, "synthetic");
+	if (recorded.count > 0) {
+		reset_counters();
+		bench_process_events(&recorded, replay_file);
+	}
+	reset_counters();
+	bench_quiet_output();
+	reset_counters();
+	bench_remote();
+	reset_counters();
+	bench_ikbd();
+
+	// Samples taken on the virtual clock of the benchmarks mean nothing to the caller
+	button_latency = saved_button_latency;
+	motion_latency = saved_motion_latency;
+	stats = saved_stats;
+	monitor_mode = saved_monitor;
+	debug_mode = saved_debug;
+	free(synthetic.events);
+	free(recorded.events);
+	return 0;
+}
\ No newline at end of file
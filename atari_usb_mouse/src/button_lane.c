@@ -0,0 +1,137 @@
+/**
+ * @file button_lane.c
+ * @brief Applies button transitions during pulse trains.
+ *
+ * The event loop is blocked while a pulse train is emitted, so a click
+ * arriving during a long flick used to wait for the whole train. Here the
+ * delays between edges poll the input device instead of sleeping blindly.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "button_lane.h"
+#include "mouse_event.h"
+#include "config.h"
+#include "global.h"
+
+
+static int lane_fd = -1;
+static quadrature_state_t *lane_state = NULL;
+
+// Ring of events read ahead, in arrival order
+static struct input_event queue[BUTTON_LANE_QUEUE_SIZE];
+static unsigned int queue_head = 0;
+static unsigned int queue_len = 0;
+
+// Motion events in the ring: a button behind them waits its turn
+static unsigned int queued_motion = 0;
+
+
+// Reads CLOCK_MONOTONIC in nanoseconds.
+static uint64_t monotonic_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Sleeps until an absolute CLOCK_MONOTONIC deadline.
+static void sleep_until_ns(uint64_t deadline) {
+	struct timespec ts = {
+		.tv_sec = (time_t)(deadline / 1000000000ULL),
+		.tv_nsec = (long)(deadline % 1000000000ULL)
+	};
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR && running);
+}
+
+// Tells whether an event is a button transition handled by the lane.
+static inline int is_button_event(const struct input_event *ie) {
+	return ie->type == EV_KEY && (ie->code == BTN_LEFT || ie->code == BTN_RIGHT);
+}
+
+// Attaches the button lane to the input device.
+void button_lane_attach(int fd, quadrature_state_t *state) {
+	lane_fd = fd;
+	lane_state = state;
+	if (fd < 0) {
+		queue_head = queue_len = queued_motion = 0;
+	}
+}
+
+// Tells whether the button lane watches an input device.
+int button_lane_active(void) {
+	return lane_fd >= 0;
+}
+
+// Waits between two edges while servicing button events.
+void button_lane_wait(int delay_us) {
+	uint64_t deadline = monotonic_ns() + (uint64_t)delay_us * 1000ULL;
+	struct input_event events[16];
+
+	for (;;) {
+		uint64_t now = monotonic_ns();
+		if (now >= deadline) {
+			return;
+		}
+
+		// Queue full or device gone: leave the rest to the event loop
+		if (queue_len == BUTTON_LANE_QUEUE_SIZE) {
+			sleep_until_ns(deadline);
+			return;
+		}
+
+		struct pollfd pfd = { .fd = lane_fd, .events = POLLIN };
+		struct timespec timeout = {
+			.tv_sec = (time_t)((deadline - now) / 1000000000ULL),
+			.tv_nsec = (long)((deadline - now) % 1000000000ULL)
+		};
+		int result = ppoll(&pfd, 1, &timeout, NULL);
+		if (result == 0) {
+			return;
+		}
+		if (result < 0 || (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))) {
+			if (result < 0 && errno == EINTR && running) continue;
+			sleep_until_ns(deadline);
+			return;
+		}
+
+		size_t room = BUTTON_LANE_QUEUE_SIZE - queue_len;
+		if (room > sizeof(events) / sizeof(events[0])) {
+			room = sizeof(events) / sizeof(events[0]);
+		}
+		ssize_t bytes_read = read(lane_fd, events, room * sizeof(events[0]));
+		if (bytes_read <= 0) {
+			if (bytes_read < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+			sleep_until_ns(deadline);
+			return;
+		}
+
+		// A button goes out at once only when no motion read before it is waiting
+		for (size_t i = 0; i < (size_t)bytes_read / sizeof(events[0]); i++) {
+			if (is_button_event(&events[i]) && queued_motion == 0) {
+				process_mouse_event(&events[i], lane_state, config.sensitivity);
+			} else {
+				queue[(queue_head + queue_len) % BUTTON_LANE_QUEUE_SIZE] = events[i];
+				queue_len++;
+				queued_motion += (events[i].type == EV_REL);
+			}
+		}
+	}
+}
+
+// Takes the oldest event read ahead during a pulse train.
+int button_lane_pop(struct input_event *ie) {
+	if (queue_len == 0) {
+		return 0;
+	}
+	*ie = queue[queue_head];
+	queue_head = (queue_head + 1) % BUTTON_LANE_QUEUE_SIZE;
+	queue_len--;
+	queued_motion -= (ie->type == EV_REL);
+	return 1;
+}
@@ -0,0 +1,245 @@
+/**
+ * @file calibrate.c
+ * @brief Measures the output path and derives the edge period bounds.
+ *
+ * The built-in ramp (2000 us down to 500 us) was tuned by hand on one
+ * board. A level lasts the requested delay plus the sleep overshoot and
+ * part of the line writes, and both vary a lot between a Pi Zero and a
+ * Pi 5, so the shortest delay that still gives the IKBD two samples per
+ * level is derived from measurements on the running system instead.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <json-c/json.h>
+
+#include "calibrate.h"
+#include "ikbd_model.h"
+#include "latency.h"
+#include "global.h"
+
+
+// Sleep lengths measured in turn, spanning the usual edge periods (in microseconds)
+static const int sleep_lengths[] = { 100, 250, 500, 1000, 2000 };
+
+
+// Reads CLOCK_MONOTONIC in nanoseconds.
+static uint64_t monotonic_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Times line writes by toggling XA back and forth.
+static void measure_writes(quadrature_state_t *state, latency_hist_t *hist) {
+	int xa = state->xa_state;
+	int xb = state->xb_state;
+
+	for (int i = 0; i < CALIBRATE_WRITES / 2 && running; i++) {
+		uint64_t start = monotonic_ns();
+		set_x_quadrature(state, !xa, xb);
+		uint64_t middle = monotonic_ns();
+		set_x_quadrature(state, xa, xb);
+		uint64_t end = monotonic_ns();
+
+		latency_record(hist, middle - start);
+		latency_record(hist, end - middle);
+	}
+}
+
+// Times the overshoot of the sleep used between edges, returns the smallest one.
+static uint64_t measure_sleeps(latency_hist_t *hist) {
+	uint64_t min_ns = UINT64_MAX;
+	int lengths = (int)(sizeof(sleep_lengths) / sizeof(sleep_lengths[0]));
+
+	// Measured on the kernel directly: the null backend does not sleep
+	for (int i = 0; i < CALIBRATE_SLEEPS && running; i++) {
+		uint64_t length_ns = (uint64_t)sleep_lengths[i % lengths] * 1000ULL;
+		uint64_t start = monotonic_ns();
+		usleep(sleep_lengths[i % lengths]);
+		uint64_t elapsed = monotonic_ns() - start;
+
+		uint64_t overshoot = (elapsed > length_ns) ? elapsed - length_ns : 0;
+		latency_record(hist, overshoot);
+		if (overshoot < min_ns) {
+			min_ns = overshoot;
+		}
+	}
+	return min_ns;
+}
+
+// Measures the output path and derives the edge period bounds.
+int calibrate_measure(quadrature_state_t *state, calibration_t *cal) {
+	latency_hist_t writes = {0};
+	latency_hist_t sleeps = {0};
+
+	if (!gpio_initialized) {
+		ERROR_PRINT("Output not initialized, cannot calibrate\n");
+		return -1;
+	}
+
+	measure_writes(state, &writes);
+	uint64_t sleep_min_ns = measure_sleeps(&sleeps);
+	if (!running) {
+		return -1;
+	}
+
+	memset(cal, 0, sizeof(*cal));
+	cal->write_p50_us = (unsigned int)latency_percentile(&writes, 50);
+	cal->write_p99_us = (unsigned int)latency_percentile(&writes, 99);
+	cal->sleep_min_us = (unsigned int)(sleep_min_ns / 1000ULL);
+	cal->sleep_p50_us = (unsigned int)latency_percentile(&sleeps, 50);
+	cal->sleep_p99_us = (unsigned int)latency_percentile(&sleeps, 99);
+
+	// Every level gets at least the minimum overshoot; write jitter can move either edge
+	int min_delay = CALIBRATE_LEVEL_SAMPLES * IKBD_SAMPLE_US - (int)cal->sleep_min_us
+		+ (int)(cal->write_p99_us - cal->write_p50_us);
+	if (min_delay < IKBD_SAMPLE_US) {
+		min_delay = IKBD_SAMPLE_US;
+	} else if (min_delay > DEFAULT_MAX_DELAY) {
+		min_delay = DEFAULT_MAX_DELAY;
+	}
+
+	// Keep the built-in ratio, but slow trains must not be dominated by sleep jitter
+	int max_delay = min_delay * DEFAULT_MAX_DELAY / DEFAULT_MIN_DELAY;
+	int jitter_bound = min_delay + 4 * (int)(cal->sleep_p99_us - cal->sleep_min_us);
+	if (max_delay < jitter_bound) {
+		max_delay = jitter_bound;
+	}
+	if (max_delay > UINT16_MAX) {
+		max_delay = UINT16_MAX;
+	}
+
+	cal->min_delay_us = min_delay;
+	cal->max_delay_us = max_delay;
+	cal->spin_us = (int)cal->sleep_p99_us + CALIBRATE_SPIN_MARGIN_US;
+	return 0;
+}
+
+// Installs the calibrated curve in a configuration and selects it.
+int calibrate_apply(const calibration_t *cal, config_t *cfg) {
+	const curve_point_t ramp[] = {
+		{ DEFAULT_SPEED_THRESHOLD, cal->max_delay_us },
+		{ DEFAULT_SPEED_THRESHOLD + DEFAULT_RAMP_STEPS, cal->min_delay_us }
+	};
+
+	// Start from the active curve to keep its gain table
+	curve_t curve = cfg->curves[cfg->curve_index];
+	snprintf(curve.name, sizeof(curve.name), "%s", CALIBRATED_CURVE_NAME);
+	if (curve_build_period(&curve, ramp, 2) < 0) {
+		return -1;
+	}
+
+	int index = find_curve(cfg, CALIBRATED_CURVE_NAME);
+	if (index < 0) {
+		if (cfg->num_curves == MAX_CURVES) {
+			ERROR_PRINT("Too many curves, at most %d are supported\n", MAX_CURVES);
+			return -1;
+		}
+		index = cfg->num_curves++;
+	}
+	cfg->curves[index] = curve;
+	cfg->curve_index = index;
+	cfg->spin_us = cal->spin_us;
+	return 0;
+}
+
+// Returns a new [x, y] JSON pair.
+static json_object *new_point(int x, int y) {
+	json_object *pair = json_object_new_array();
+	json_object_array_add(pair, json_object_new_int(x));
+	json_object_array_add(pair, json_object_new_int(y));
+	return pair;
+}
+
+// Returns the object stored under a key, adding an empty one if missing.
+static json_object *child_object(json_object *parent, const char *key) {
+	json_object *child;
+	if (!json_object_object_get_ex(parent, key, &child) || !json_object_is_type(child, json_type_object)) {
+		child = json_object_new_object();
+		json_object_object_add(parent, key, child);
+	}
+	return child;
+}
+
+// Reads the board model from the device tree, empty if unknown.
+static void read_board_model(char *model, size_t size) {
+	model[0] = '\0';
+	FILE *fp = fopen("/proc/device-tree/model", "r");
+	if (fp == NULL) {
+		return;
+	}
+	size_t length = fread(model, 1, size - 1, fp);
+	model[length] = '\0';
+	fclose(fp);
+}
+
+// Writes the calibration to a JSON configuration file.
+int calibrate_save(const calibration_t *cal, const char *config_path) {
+	json_object *root;
+	struct stat st;
+
+	if (stat(config_path, &st) == 0) {
+		root = json_object_from_file(config_path);
+		if (root == NULL || !json_object_is_type(root, json_type_object)) {
+			ERROR_PRINT("Invalid JSON in config file %s\n", config_path);
+			json_object_put(root);
+			return -1;
+		}
+	} else {
+		root = json_object_new_object();
+	}
+
+	json_object *curves = child_object(root, "curves");
+	json_object *calibrated = json_object_new_object();
+
+	// Keep the gain of the selected curve
+	json_object *name_obj, *curve_obj, *gain_obj;
+	if (json_object_object_get_ex(root, "curve", &name_obj)
+			&& json_object_object_get_ex(curves, json_object_get_string(name_obj), &curve_obj)
+			&& json_object_object_get_ex(curve_obj, "gain", &gain_obj)) {
+		json_object_object_add(calibrated, "gain", json_object_get(gain_obj));
+	}
+
+	json_object *period = json_object_new_array();
+	json_object_array_add(period, new_point(DEFAULT_SPEED_THRESHOLD, cal->max_delay_us));
+	json_object_array_add(period, new_point(DEFAULT_SPEED_THRESHOLD + DEFAULT_RAMP_STEPS, cal->min_delay_us));
+	json_object_object_add(calibrated, "period", period);
+	json_object_object_add(curves, CALIBRATED_CURVE_NAME, calibrated);
+	json_object_object_add(root, "curve", json_object_new_string(CALIBRATED_CURVE_NAME));
+
+	json_object_object_add(child_object(root, "precision"), "spin_us", json_object_new_int(cal->spin_us));
+
+	// Measurements are kept for reference, only at_startup is read back
+	char model[128];
+	read_board_model(model, sizeof(model));
+	json_object *calibration = child_object(root, "calibration");
+	json_object_object_add(calibration, "board", json_object_new_string(model));
+	json_object_object_add(calibration, "write_p50_us", json_object_new_int((int32_t)cal->write_p50_us));
+	json_object_object_add(calibration, "write_p99_us", json_object_new_int((int32_t)cal->write_p99_us));
+	json_object_object_add(calibration, "sleep_min_us", json_object_new_int((int32_t)cal->sleep_min_us));
+	json_object_object_add(calibration, "sleep_p50_us", json_object_new_int((int32_t)cal->sleep_p50_us));
+	json_object_object_add(calibration, "sleep_p99_us", json_object_new_int((int32_t)cal->sleep_p99_us));
+
+	int result = json_object_to_file_ext(config_path, root, JSON_C_TO_STRING_PRETTY);
+	json_object_put(root);
+	if (result < 0) {
+		ERROR_PRINT("Cannot write configuration file %s\n", config_path);
+		return -1;
+	}
+	return 0;
+}
+
+// Prints the measurements and derived parameters.
+void calibrate_print(const calibration_t *cal) {
+	INFO_PRINT("Line write: p50 %u us, p99 %u us\n", cal->write_p50_us, cal->write_p99_us);
+	INFO_PRINT("Sleep overshoot: min %u us, p50 %u us, p99 %u us\n",
+		cal->sleep_min_us, cal->sleep_p50_us, cal->sleep_p99_us);
+	INFO_PRINT("Edge period: %d us (slow trains) to %d us (fast trains), spin window %d us\n",
+		cal->max_delay_us, cal->min_delay_us, cal->spin_us);
+}
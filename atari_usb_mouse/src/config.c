@@ -1,5 +1,7 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <fnmatch.h>
 #include <sys/stat.h>
 #include <json-c/json.h>
 
@@ -7,10 +9,344 @@
 #include "global.h"
 
 
+// Reads an array of [x, y] pairs into curve control points.
+static int parse_points(json_object *array, curve_point_t *points) {
+	if (!json_object_is_type(array, json_type_array)) {
+		ERROR_PRINT("Curve points must be an array of [x, y] pairs\n");
+		return -1;
+	}
+
+	int count = (int)json_object_array_length(array);
+	if (count < 1 || count > MAX_CURVE_POINTS) {
+		ERROR_PRINT("A curve needs 1 to %d points\n", MAX_CURVE_POINTS);
+		return -1;
+	}
+
+	for (int i = 0; i < count; i++) {
+		json_object *pair = json_object_array_get_idx(array, i);
+		if (!json_object_is_type(pair, json_type_array) || json_object_array_length(pair) != 2) {
+			ERROR_PRINT("Curve points must be an array of [x, y] pairs\n");
+			return -1;
+		}
+		points[i].x = json_object_get_double(json_object_array_get_idx(pair, 0));
+		points[i].y = json_object_get_double(json_object_array_get_idx(pair, 1));
+	}
+	return count;
+}
+
+// Compiles one named curve of the "curves" object.
+static int parse_curve(const char *name, json_object *curve_obj, config_t *cfg) {
+	curve_point_t points[MAX_CURVE_POINTS];
+	json_object *points_obj;
+	int count;
+
+	// A curve named like an existing one replaces it
+	int index = find_curve(cfg, name);
+	if (index < 0) {
+		if (cfg->num_curves == MAX_CURVES) {
+			ERROR_PRINT("Too many curves, at most %d are supported\n", MAX_CURVES);
+			return -1;
+		}
+		index = cfg->num_curves++;
+	}
+
+	curve_t *curve = &cfg->curves[index];
+	curve_init_default(curve, name);
+
+	if (json_object_object_get_ex(curve_obj, "gain", &points_obj)) {
+		if ((count = parse_points(points_obj, points)) < 0 || curve_build_gain(curve, points, count) < 0) {
+			ERROR_PRINT("Invalid gain curve in curve %s\n", name);
+			return -1;
+		}
+	}
+	if (json_object_object_get_ex(curve_obj, "period", &points_obj)) {
+		if ((count = parse_points(points_obj, points)) < 0 || curve_build_period(curve, points, count) < 0) {
+			ERROR_PRINT("Invalid period curve in curve %s\n", name);
+			return -1;
+		}
+	}
+
+	DEBUG_PRINT("Curve %s compiled\n", name);
+	return 0;
+}
+
+// Names of the pacing modes, indexed by PACING_* value
+static const char *pacing_names[] = { "burst", "tick", "frame" };
+static const char *filter_names[] = { "invert", "swap", "deadzone", "smooth", "curve", "rate_cap" };
+
+// Reads one entry of the "outputs" array; curves must be parsed already.
+static int parse_output(json_object *output_obj, int index, config_t *cfg) {
+	static const char *pin_names[6] = { "xa", "xb", "ya", "yb", "left_button", "right_button" };
+	output_config_t *output = &cfg->outputs[index];
+	json_object *value_obj;
+	json_object *pins_obj;
+
+	snprintf(output->name, sizeof(output->name), "output%d", index + 1);
+	snprintf(output->gpio_chip, sizeof(output->gpio_chip), "%s", cfg->gpio_chip);
+	output->sensitivity = cfg->sensitivity;
+	output->curve_index = cfg->curve_index;
+	output->tick_us = cfg->tick_us;
+	output->cpu = -1;
+
+	if (json_object_object_get_ex(output_obj, "name", &value_obj)) {
+		snprintf(output->name, sizeof(output->name), "%s", json_object_get_string(value_obj));
+	}
+	if (json_object_object_get_ex(output_obj, "gpio_chip", &value_obj)) {
+		snprintf(output->gpio_chip, sizeof(output->gpio_chip), "%s", json_object_get_string(value_obj));
+	}
+	if (!json_object_object_get_ex(output_obj, "device_path", &value_obj)) {
+		ERROR_PRINT("Output %s has no device_path\n", output->name);
+		return -1;
+	}
+	snprintf(output->device_path, sizeof(output->device_path), "%s", json_object_get_string(value_obj));
+
+	// Every pin is required: defaults would collide with the main output
+	if (!json_object_object_get_ex(output_obj, "pins_gpio", &pins_obj)) {
+		ERROR_PRINT("Output %s has no pins_gpio\n", output->name);
+		return -1;
+	}
+	for (int pin = 0; pin < 6; pin++) {
+		if (!json_object_object_get_ex(pins_obj, pin_names[pin], &value_obj)) {
+			ERROR_PRINT("Output %s has no %s pin\n", output->name, pin_names[pin]);
+			return -1;
+		}
+		output->pins[pin] = json_object_get_int(value_obj);
+	}
+
+	if (json_object_object_get_ex(output_obj, "sensitivity", &value_obj)) {
+		output->sensitivity = json_object_get_int(value_obj);
+	}
+	if (json_object_object_get_ex(output_obj, "curve", &value_obj)) {
+		output->curve_index = find_curve(cfg, json_object_get_string(value_obj));
+		if (output->curve_index < 0) {
+			ERROR_PRINT("Unknown curve %s for output %s\n", json_object_get_string(value_obj), output->name);
+			return -1;
+		}
+	}
+	if (json_object_object_get_ex(output_obj, "tick_us", &value_obj)) {
+		output->tick_us = json_object_get_int(value_obj);
+	}
+	if (json_object_object_get_ex(output_obj, "cpu", &value_obj)) {
+		output->cpu = json_object_get_int(value_obj);
+	}
+
+	DEBUG_PRINT("Setting output %s on %s from %s\n", output->name, output->gpio_chip, output->device_path);
+	return 0;
+}
+
+// Parses the joystick output.
+static int parse_joystick(json_object *joystick_obj, config_t *cfg) {
+	static const char *pin_names[JOYSTICK_LINES] = { "up", "down", "left", "right", "fire" };
+	joystick_config_t *joystick = &cfg->joystick;
+	json_object *value_obj;
+	json_object *pins_obj;
+
+	snprintf(joystick->gpio_chip, sizeof(joystick->gpio_chip), "%s", cfg->gpio_chip);
+	if (json_object_object_get_ex(joystick_obj, "gpio_chip", &value_obj)) {
+		snprintf(joystick->gpio_chip, sizeof(joystick->gpio_chip), "%s", json_object_get_string(value_obj));
+	}
+	if (json_object_object_get_ex(joystick_obj, "threshold", &value_obj)) {
+		joystick->threshold = json_object_get_int(value_obj);
+	}
+	if (json_object_object_get_ex(joystick_obj, "device_path", &value_obj)) {
+		snprintf(joystick->device_path, sizeof(joystick->device_path), "%s", json_object_get_string(value_obj));
+	}
+	if (joystick->device_path[0] == '\0') {
+		return 0;
+	}
+
+	// Every pin is required: defaults would collide with the mouse lines
+	if (!json_object_object_get_ex(joystick_obj, "pins_gpio", &pins_obj)) {
+		ERROR_PRINT("Joystick has no pins_gpio\n");
+		return -1;
+	}
+	for (int pin = 0; pin < JOYSTICK_LINES; pin++) {
+		if (!json_object_object_get_ex(pins_obj, pin_names[pin], &value_obj)) {
+			ERROR_PRINT("Joystick has no %s pin\n", pin_names[pin]);
+			return -1;
+		}
+		joystick->pins[pin] = json_object_get_int(value_obj);
+	}
+
+	DEBUG_PRINT("Setting joystick on %s from %s\n", joystick->gpio_chip, joystick->device_path);
+	return 0;
+}
+
+// Reads one stage of a "filters" array.
+static int parse_filter(json_object *filter_obj, int index, filter_config_t *filter) {
+	json_object *value_obj;
+
+	filter->stage = -1;
+	filter->axes = 3;
+	filter->value = 0;
+	if (json_object_object_get_ex(filter_obj, "stage", &value_obj)) {
+		const char *name = json_object_get_string(value_obj);
+		for (int i = 0; i < (int)(sizeof(filter_names) / sizeof(filter_names[0])); i++) {
+			if (name != NULL && strcmp(name, filter_names[i]) == 0) {
+				filter->stage = i;
+			}
+		}
+	}
+	if (filter->stage < 0) {
+		ERROR_PRINT("Filter %d has no valid stage (invert, swap, deadzone, smooth, curve or rate_cap)\n", index + 1);
+		return -1;
+	}
+
+	if (json_object_object_get_ex(filter_obj, "axis", &value_obj)) {
+		const char *axis = json_object_get_string(value_obj);
+		if (axis != NULL && strcmp(axis, "x") == 0) {
+			filter->axes = 1;
+		} else if (axis != NULL && strcmp(axis, "y") == 0) {
+			filter->axes = 2;
+		} else if (axis == NULL || strcmp(axis, "xy") != 0) {
+			ERROR_PRINT("Filter %s: axis must be x, y or xy\n", filter_names[filter->stage]);
+			return -1;
+		}
+	}
+
+	// Parameter of the stages that take one
+	static const char *value_names[] = { NULL, NULL, "counts", "weight", NULL, "counts_per_ms" };
+	const char *value_name = value_names[filter->stage];
+	if (value_name != NULL) {
+		if (!json_object_object_get_ex(filter_obj, value_name, &value_obj)) {
+			ERROR_PRINT("Filter %s has no %s\n", filter_names[filter->stage], value_name);
+			return -1;
+		}
+		filter->value = json_object_get_int(value_obj);
+	}
+	if ((filter->stage == FILTER_DEADZONE && filter->value < 0)
+			|| (filter->stage == FILTER_SMOOTH && (filter->value < 1 || filter->value > 100))
+			|| (filter->stage == FILTER_RATE_CAP && filter->value < 1)) {
+		ERROR_PRINT("Filter %s: %s out of range\n", filter_names[filter->stage], value_name);
+		return -1;
+	}
+
+	DEBUG_PRINT("Setting filter %d=%s from config file\n", index + 1, filter_names[filter->stage]);
+	return 0;
+}
+
+// Reads a "filters" array into a chain.
+static int parse_filters(json_object *filters_obj, filter_config_t *filters, int *count) {
+	int length = json_object_is_type(filters_obj, json_type_array) ? (int)json_object_array_length(filters_obj) : -1;
+	if (length < 0 || length > MAX_FILTERS) {
+		ERROR_PRINT("filters must be an array of at most %d stages\n", MAX_FILTERS);
+		return -1;
+	}
+	for (int i = 0; i < length; i++) {
+		if (parse_filter(json_object_array_get_idx(filters_obj, i), i, &filters[i]) < 0) {
+			return -1;
+		}
+	}
+	*count = length;
+	return 0;
+}
+
+// Reads one entry of the "profiles" object; curves must be parsed already.
+static int parse_profile(const char *key, json_object *profile_obj, profile_config_t *profile, const config_t *cfg) {
+	json_object *value_obj;
+	unsigned int vendor, product;
+	char end;
+
+	memset(profile, 0, sizeof(*profile));
+	snprintf(profile->key, sizeof(profile->key), "%s", key);
+	profile->vendor = profile->product = -1;
+	profile->sensitivity = profile->curve_index = profile->pacing = profile->tick_us = -1;
+	profile->num_filters = -1;
+
+	// VID:PID in hexadecimal, anything else is a pattern on the device name
+	if (strlen(key) == 9 && sscanf(key, "%4x:%4x%c", &vendor, &product, &end) == 2) {
+		profile->vendor = (int)vendor;
+		profile->product = (int)product;
+	} else {
+		snprintf(profile->pattern, sizeof(profile->pattern), "%s", key);
+	}
+
+	if (json_object_object_get_ex(profile_obj, "sensitivity", &value_obj)) {
+		profile->sensitivity = json_object_get_int(value_obj);
+		if (profile->sensitivity < 1) {
+			ERROR_PRINT("Profile %s: sensitivity must be >= 1\n", key);
+			return -1;
+		}
+	}
+	if (json_object_object_get_ex(profile_obj, "curve", &value_obj)) {
+		profile->curve_index = find_curve(cfg, json_object_get_string(value_obj));
+		if (profile->curve_index < 0) {
+			ERROR_PRINT("Unknown curve %s for profile %s\n", json_object_get_string(value_obj), key);
+			return -1;
+		}
+	}
+	if (json_object_object_get_ex(profile_obj, "pacing", &value_obj)) {
+		profile->pacing = parse_pacing(json_object_get_string(value_obj));
+		if (profile->pacing < 0) {
+			ERROR_PRINT("Unknown pacing %s for profile %s (burst, tick or frame)\n", json_object_get_string(value_obj), key);
+			return -1;
+		}
+	}
+	if (json_object_object_get_ex(profile_obj, "tick_us", &value_obj)) {
+		profile->tick_us = json_object_get_int(value_obj);
+	}
+	if (json_object_object_get_ex(profile_obj, "filters", &value_obj)
+			&& parse_filters(value_obj, profile->filters, &profile->num_filters) < 0) {
+		return -1;
+	}
+
+	DEBUG_PRINT("Setting profile %s from config file\n", key);
+	return 0;
+}
+
+// Returns the PACING_* value of a pacing mode name.
+int parse_pacing(const char *name) {
+	for (int i = 0; i < (int)(sizeof(pacing_names) / sizeof(pacing_names[0])); i++) {
+		if (name != NULL && strcmp(name, pacing_names[i]) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+// Returns the name of a PACING_* value.
+const char *pacing_name(int pacing) {
+	return pacing_names[pacing];
+}
+
+// Returns the name of a FILTER_* value.
+const char *filter_name(int stage) {
+	return filter_names[stage];
+}
+
+// Finds a curve by name.
+int find_curve(const config_t *cfg, const char *name) {
+	for (int i = 0; i < cfg->num_curves; i++) {
+		if (strcmp(cfg->curves[i].name, name) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+// Finds the profile of an input device.
+int find_profile(const config_t *cfg, int vendor, int product, const char *name) {
+	int found = -1;
+
+	for (int i = 0; i < cfg->num_profiles; i++) {
+		const profile_config_t *profile = &cfg->profiles[i];
+		if (profile->vendor >= 0 && profile->vendor == vendor && profile->product == product) {
+			return i;
+		}
+		if (found < 0 && profile->pattern[0] != '\0' && fnmatch(profile->pattern, name, 0) == 0) {
+			found = i;
+		}
+	}
+	return found;
+}
+
 // Loads the configuration from a file.
 int load_config(const char *config_path, config_t *cfg) {
 	// Start with default configuration values
 	*cfg = default_config;
+	curve_init_default(&cfg->curves[0], DEFAULT_CURVE_NAME);
+	cfg->num_curves = 1;
+	cfg->curve_index = 0;
 
 	struct stat st;
 	if (stat(config_path, &st) != 0) {
@@ -104,6 +440,186 @@ int load_config(const char *config_path, config_t *cfg) {
 			DEBUG_PRINT("Setting device_path=%s from config file\n", cfg->device_path);
 		}
 	}
+	if (json_object_object_get_ex(root, "gpio_chip", &param_obj)) {
+		const char *path = json_object_get_string(param_obj);
+		if (path != NULL) {
+			// Copy with bounds checking
+			strncpy(cfg->gpio_chip, path, sizeof(cfg->gpio_chip) - 1);
+			cfg->gpio_chip[sizeof(cfg->gpio_chip) - 1] = '\0';
+			DEBUG_PRINT("Setting gpio_chip=%s from config file\n", cfg->gpio_chip);
+		}
+	}
+
+	if (json_object_object_get_ex(root, "control_socket", &param_obj)) {
+		const char *path = json_object_get_string(param_obj);
+		if (path != NULL) {
+			// Copy with bounds checking
+			strncpy(cfg->control_socket, path, sizeof(cfg->control_socket) - 1);
+			cfg->control_socket[sizeof(cfg->control_socket) - 1] = '\0';
+			DEBUG_PRINT("Setting control_socket=%s from config file\n", cfg->control_socket);
+		}
+	}
+
+	if (json_object_object_get_ex(root, "pacing", &param_obj)) {
+		const char *mode = json_object_get_string(param_obj);
+		cfg->pacing = parse_pacing(mode);
+		if (cfg->pacing < 0) {
+			ERROR_PRINT("Unknown pacing %s in config file (burst, tick or frame)\n", mode);
+			cfg->pacing = PACING_BURST;
+			json_object_put(root);
+			return -1;
+		}
+		DEBUG_PRINT("Setting pacing=%s from config file\n", mode);
+	}
+	if (json_object_object_get_ex(root, "tick_us", &param_obj)) {
+		cfg->tick_us = json_object_get_int(param_obj);
+		DEBUG_PRINT("Setting tick_us=%d from config file\n", cfg->tick_us);
+	}
+
+	// Parse precision emitter settings
+	json_object *precision_obj;
+	if (json_object_object_get_ex(root, "precision", &precision_obj)) {
+		json_object *value_obj;
+		if (json_object_object_get_ex(precision_obj, "enabled", &value_obj)) {
+			cfg->precision = json_object_get_boolean(value_obj);
+			DEBUG_PRINT("Setting precision=%d from config file\n", cfg->precision);
+		}
+		if (json_object_object_get_ex(precision_obj, "spin_us", &value_obj)) {
+			cfg->spin_us = json_object_get_int(value_obj);
+			DEBUG_PRINT("Setting spin_us=%d from config file\n", cfg->spin_us);
+		}
+		if (json_object_object_get_ex(precision_obj, "cpu", &value_obj)) {
+			cfg->precision_cpu = json_object_get_int(value_obj);
+			DEBUG_PRINT("Setting precision_cpu=%d from config file\n", cfg->precision_cpu);
+		}
+	}
+
+	// Parse calibration settings, the measurements stored with them are informative
+	json_object *calibration_obj;
+	if (json_object_object_get_ex(root, "calibration", &calibration_obj)) {
+		json_object *value_obj;
+		if (json_object_object_get_ex(calibration_obj, "at_startup", &value_obj)) {
+			cfg->calibrate_at_startup = json_object_get_boolean(value_obj);
+			DEBUG_PRINT("Setting calibrate_at_startup=%d from config file\n", cfg->calibrate_at_startup);
+		}
+	}
+
+	// Parse watchdog settings
+	json_object *watchdog_obj;
+	if (json_object_object_get_ex(root, "watchdog", &watchdog_obj)) {
+		json_object *value_obj;
+		if (json_object_object_get_ex(watchdog_obj, "stall_us", &value_obj)) {
+			cfg->stall_us = json_object_get_int(value_obj);
+			DEBUG_PRINT("Setting stall_us=%d from config file\n", cfg->stall_us);
+		}
+	}
+
+	// Parse remote input settings
+	json_object *remote_obj;
+	if (json_object_object_get_ex(root, "remote", &remote_obj)) {
+		json_object *value_obj;
+		if (json_object_object_get_ex(remote_obj, "listen", &value_obj)) {
+			const char *address = json_object_get_string(value_obj);
+			if (address != NULL) {
+				snprintf(cfg->remote_listen, sizeof(cfg->remote_listen), "%s", address);
+				DEBUG_PRINT("Setting remote_listen=%s from config file\n", cfg->remote_listen);
+			}
+		}
+		if (json_object_object_get_ex(remote_obj, "button_timeout_ms", &value_obj)) {
+			cfg->remote_button_timeout_ms = json_object_get_int(value_obj);
+			DEBUG_PRINT("Setting remote_button_timeout_ms=%d from config file\n", cfg->remote_button_timeout_ms);
+		}
+	}
+
+	// Parse IKBD serial output settings
+	json_object *ikbd_obj;
+	if (json_object_object_get_ex(root, "ikbd", &ikbd_obj)) {
+		json_object *value_obj;
+		if (json_object_object_get_ex(ikbd_obj, "device", &value_obj)) {
+			const char *device = json_object_get_string(value_obj);
+			if (device != NULL) {
+				snprintf(cfg->ikbd_device, sizeof(cfg->ikbd_device), "%s", device);
+				DEBUG_PRINT("Setting ikbd_device=%s from config file\n", cfg->ikbd_device);
+			}
+		}
+	}
+
+	// Parse named curves, then the selected one
+	json_object *curves_obj;
+	if (json_object_object_get_ex(root, "curves", &curves_obj)) {
+		json_object_object_foreach(curves_obj, name, curve_obj) {
+			if (parse_curve(name, curve_obj, cfg) < 0) {
+				json_object_put(root);
+				return -1;
+			}
+		}
+	}
+	if (json_object_object_get_ex(root, "curve", &param_obj)) {
+		const char *name = json_object_get_string(param_obj);
+		cfg->curve_index = find_curve(cfg, name);
+		if (cfg->curve_index < 0) {
+			ERROR_PRINT("Unknown curve %s in config file\n", name);
+			cfg->curve_index = 0;
+			json_object_put(root);
+			return -1;
+		}
+		DEBUG_PRINT("Setting curve=%s from config file\n", name);
+	}
+
+	// Parse additional outputs, which default to the settings above
+	json_object *outputs_obj;
+	if (json_object_object_get_ex(root, "outputs", &outputs_obj)) {
+		int count = json_object_is_type(outputs_obj, json_type_array) ? (int)json_object_array_length(outputs_obj) : -1;
+		if (count < 0 || count > MAX_OUTPUTS) {
+			ERROR_PRINT("outputs must be an array of at most %d outputs\n", MAX_OUTPUTS);
+			json_object_put(root);
+			return -1;
+		}
+		for (int i = 0; i < count; i++) {
+			if (parse_output(json_object_array_get_idx(outputs_obj, i), i, cfg) < 0) {
+				json_object_put(root);
+				return -1;
+			}
+		}
+		cfg->num_outputs = count;
+	}
+
+	// Parse the motion filter chain
+	json_object *filters_obj;
+	if (json_object_object_get_ex(root, "filters", &filters_obj)
+			&& parse_filters(filters_obj, cfg->filters, &cfg->num_filters) < 0) {
+		json_object_put(root);
+		return -1;
+	}
+
+	// Parse the device profiles, resolved now so that opening a device only picks one
+	json_object *profiles_obj;
+	if (json_object_object_get_ex(root, "profiles", &profiles_obj)) {
+		if (!json_object_is_type(profiles_obj, json_type_object)) {
+			ERROR_PRINT("profiles must be an object keyed by VID:PID or device name pattern\n");
+			json_object_put(root);
+			return -1;
+		}
+		json_object_object_foreach(profiles_obj, key, profile_obj) {
+			if (cfg->num_profiles == MAX_PROFILES) {
+				ERROR_PRINT("At most %d profiles\n", MAX_PROFILES);
+				json_object_put(root);
+				return -1;
+			}
+			if (parse_profile(key, profile_obj, &cfg->profiles[cfg->num_profiles], cfg) < 0) {
+				json_object_put(root);
+				return -1;
+			}
+			cfg->num_profiles++;
+		}
+	}
+
+	// Parse the joystick output, whose chip defaults to the one above
+	json_object *joystick_obj;
+	if (json_object_object_get_ex(root, "joystick", &joystick_obj) && parse_joystick(joystick_obj, cfg) < 0) {
+		json_object_put(root);
+		return -1;
+	}
 
 	// Release JSON object memory
 	json_object_put(root);
@@ -111,6 +627,20 @@ int load_config(const char *config_path, config_t *cfg) {
 	return 0;
 }
 
+// Prints a filter chain from the config file's "filters" array, one stage[:axis][:value] per stage.
+static void print_filters(const filter_config_t *filters, int count) {
+	for (int i = 0; i < count; i++) {
+		const filter_config_t *filter = &filters[i];
+		printf("%s%s", i ? "," : "", filter_name(filter->stage));
+		if (filter->axes != 3) {
+			printf(":%s", filter->axes == 1 ? "x" : "y");
+		}
+		if (filter->value != 0) {
+			printf(":%d", filter->value);
+		}
+	}
+}
+
 // Prints the current configuration to stdout.
 void print_config() {
 	printf("pin_xa=%d\n", config.pin_xa);
@@ -121,4 +651,47 @@ void print_config() {
 	printf("pin_right_button=%d\n", config.pin_right_button);
 	printf("sensitivity=%d\n", config.sensitivity);
 	printf("device_path=%s\n", config.device_path);
+	printf("gpio_chip=%s\n", config.gpio_chip);
+	printf("curve=%s\n", active_curve()->name);
+	printf("pacing=%s\n", pacing_name(config.pacing));
+	printf("tick_us=%d\n", config.tick_us);
+	printf("precision=%d\n", config.precision);
+	printf("spin_us=%d\n", config.spin_us);
+	printf("precision_cpu=%d\n", config.precision_cpu);
+	printf("calibrate_at_startup=%d\n", config.calibrate_at_startup);
+	printf("control_socket=%s\n", config.control_socket);
+	printf("stall_us=%d\n", config.stall_us);
+	printf("remote_listen=%s\n", config.remote_listen);
+	printf("remote_button_timeout_ms=%d\n", config.remote_button_timeout_ms);
+	printf("ikbd_device=%s\n", config.ikbd_device);
+	for (int i = 0; i < config.num_outputs; i++) {
+		const output_config_t *output = &config.outputs[i];
+		printf("output=%s chip=%s pins=%d,%d,%d,%d,%d,%d device=%s sensitivity=%d curve=%s tick_us=%d cpu=%d\n",
+			output->name, output->gpio_chip, output->pins[0], output->pins[1], output->pins[2], output->pins[3],
+			output->pins[4], output->pins[5], output->device_path, output->sensitivity,
+			config.curves[output->curve_index].name, output->tick_us, output->cpu);
+	}
+	if (config.num_filters >= 0) {
+		printf("filters=");
+		print_filters(config.filters, config.num_filters);
+		printf("\n");
+	}
+	for (int i = 0; i < config.num_profiles; i++) {
+		const profile_config_t *profile = &config.profiles[i];
+		printf("profile=%s sensitivity=%d curve=%s pacing=%s tick_us=%d filters=", profile->key, profile->sensitivity,
+			profile->curve_index >= 0 ? config.curves[profile->curve_index].name : "-",
+			profile->pacing >= 0 ? pacing_name(profile->pacing) : "-", profile->tick_us);
+		if (profile->num_filters >= 0) {
+			print_filters(profile->filters, profile->num_filters);
+		} else {
+			printf("-");
+		}
+		printf("\n");
+	}
+	if (config.joystick.device_path[0] != '\0') {
+		const joystick_config_t *joystick = &config.joystick;
+		printf("joystick=%s chip=%s pins=%d,%d,%d,%d,%d threshold=%d\n", joystick->device_path, joystick->gpio_chip,
+			joystick->pins[0], joystick->pins[1], joystick->pins[2], joystick->pins[3], joystick->pins[4],
+			joystick->threshold);
+	}
 }
\ No newline at end of file
@@ -0,0 +1,367 @@
+/**
+ * @file control.c
+ * @brief Unix-domain control socket for live tuning.
+ *
+ * Clients send one command per line and get one line back. Commands are
+ * run by the event loop between two frames: a change is made on a copy
+ * of the configuration and published whole, so the pulse path never sees
+ * a half-applied update and never waits for the socket.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "control.h"
+#include "latency.h"
+#include "monitor.h"
+#include "tick.h"
+#include "outputs.h"
+#include "joystick.h"
+#include "global.h"
+
+
+/**
+ * A connected client and its partial command line.
+ */
+typedef struct {
+	int fd;				// Client socket, -1 if the slot is free
+	size_t len;			// Bytes buffered in line
+	char line[CONTROL_LINE_SIZE];
+} control_client_t;
+
+static int listen_fd = -1;
+static char socket_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+static control_client_t clients[CONTROL_MAX_CLIENTS];
+
+
+// Opens the control socket.
+int control_init(const char *path) {
+	struct sockaddr_un addr;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		ERROR_PRINT("Control socket path too long: %s\n", path);
+		return -1;
+	}
+	for (int i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+		clients[i].fd = -1;
+	}
+
+	listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (listen_fd < 0) {
+		ERROR_PRINT("Cannot create control socket: %s\n", strerror(errno));
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+
+	// A socket left by a previous run would make bind() fail
+	unlink(path);
+
+	// The daemon runs with umask 0: restrict the file before anyone can connect
+	if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || chmod(path, CONTROL_SOCKET_MODE) < 0
+			|| listen(listen_fd, CONTROL_MAX_CLIENTS) < 0) {
+		ERROR_PRINT("Cannot listen on control socket %s: %s\n", path, strerror(errno));
+		close(listen_fd);
+		listen_fd = -1;
+		return -1;
+	}
+
+	snprintf(socket_path, sizeof(socket_path), "%s", path);
+	DEBUG_PRINT("Control socket listening on %s\n", path);
+	return 0;
+}
+
+// Adds the listening and client sockets to a select() set.
+int control_fill_fds(fd_set *set, int max_fd) {
+	if (listen_fd < 0) {
+		return max_fd;
+	}
+
+	FD_SET(listen_fd, set);
+	if (listen_fd > max_fd) {
+		max_fd = listen_fd;
+	}
+	for (int i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+		if (clients[i].fd >= 0) {
+			FD_SET(clients[i].fd, set);
+			if (clients[i].fd > max_fd) {
+				max_fd = clients[i].fd;
+			}
+		}
+	}
+	return max_fd;
+}
+
+// Closes a client connection.
+static void drop_client(control_client_t *client) {
+	close(client->fd);
+	client->fd = -1;
+	client->len = 0;
+}
+
+// Sends one reply line, dropping clients that do not keep up.
+static void reply(control_client_t *client, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void reply(control_client_t *client, const char *fmt, ...) {
+	char buffer[512];
+	va_list ap;
+
+	va_start(ap, fmt);
+	int len = vsnprintf(buffer, sizeof(buffer) - 1, fmt, ap);
+	va_end(ap);
+	if (len < 0) {
+		return;
+	}
+	if (len > (int)sizeof(buffer) - 2) {
+		len = (int)sizeof(buffer) - 2;
+	}
+	buffer[len++] = '\n';
+
+	if (send(client->fd, buffer, (size_t)len, MSG_DONTWAIT | MSG_NOSIGNAL) != len) {
+		drop_client(client);
+	}
+}
+
+// Prints the value of a live parameter.
+static void get_param(control_client_t *client, const char *param) {
+	const curve_t *curve = active_curve();
+
+	if (strcmp(param, "sensitivity") == 0) {
+		reply(client, "ok %d", config.sensitivity);
+	} else if (strcmp(param, "gain") == 0) {
+		// Gain at the lowest and highest speeds of the table
+		reply(client, "ok %.3f %.3f", (double)curve->gain_q16[0] / CURVE_GAIN_ONE,
+			(double)curve->gain_q16[CURVE_GAIN_SIZE - 1] / CURVE_GAIN_ONE);
+	} else if (strcmp(param, "curve") == 0) {
+		reply(client, "ok %s", curve->name);
+	} else if (strcmp(param, "period") == 0) {
+		reply(client, "ok %u %u", curve->min_period_us, curve->period_us[0]);
+	} else if (strcmp(param, "pacing") == 0) {
+		reply(client, "ok %s", pacing_name(config.pacing));
+	} else if (strcmp(param, "tick_us") == 0) {
+		reply(client, "ok %d", config.tick_us);
+	} else if (strcmp(param, "log") == 0) {
+		reply(client, "ok %s", debug_mode ? "debug" : "info");
+	} else {
+		reply(client, "error unknown parameter %s", param);
+	}
+}
+
+// Changes a live parameter on a copy of the configuration and publishes it.
+static void set_param(control_client_t *client, const char *param, const char *value,
+		control_publish_t publish, void *ctx) {
+	static config_t next;
+	curve_t *curve;
+	char name[CURVE_NAME_SIZE];
+	double gain;
+	int a, b;
+
+	// Logging is not part of the configuration
+	if (strcmp(param, "log") == 0) {
+		if (strcmp(value, "debug") == 0 || strcmp(value, "info") == 0) {
+			debug_mode = (value[0] == 'd');
+			reply(client, "ok %s", value);
+		} else {
+			reply(client, "error log level is debug or info");
+		}
+		return;
+	}
+
+	next = config;
+	curve = &next.curves[next.curve_index];
+
+	if (strcmp(param, "sensitivity") == 0) {
+		if (sscanf(value, "%d", &a) != 1 || a < 1) {
+			reply(client, "error sensitivity must be >= 1");
+			return;
+		}
+		next.sensitivity = a;
+	} else if (strcmp(param, "gain") == 0) {
+		// Flat gain on the active curve
+		curve_point_t point = { 0, 0 };
+		if (sscanf(value, "%lf", &gain) != 1) {
+			reply(client, "error gain must be a number");
+			return;
+		}
+		point.y = gain;
+		if (curve_build_gain(curve, &point, 1) < 0) {
+			reply(client, "error invalid gain %s", value);
+			return;
+		}
+	} else if (strcmp(param, "curve") == 0) {
+		if (sscanf(value, "%31s", name) != 1 || (a = find_curve(&next, name)) < 0) {
+			reply(client, "error unknown curve %s", value);
+			return;
+		}
+		next.curve_index = a;
+	} else if (strcmp(param, "period") == 0) {
+		// Built-in ramp shape between new bounds
+		if (sscanf(value, "%d %d", &a, &b) != 2 || a < 1 || b < a) {
+			reply(client, "error period takes MIN MAX in us, MIN <= MAX");
+			return;
+		}
+		const curve_point_t ramp[] = {
+			{ DEFAULT_SPEED_THRESHOLD, b },
+			{ DEFAULT_SPEED_THRESHOLD + DEFAULT_RAMP_STEPS, a }
+		};
+		if (curve_build_period(curve, ramp, 2) < 0) {
+			reply(client, "error invalid period %s", value);
+			return;
+		}
+	} else if (strcmp(param, "pacing") == 0) {
+		if ((a = parse_pacing(value)) < 0) {
+			reply(client, "error pacing is burst, tick or frame");
+			return;
+		}
+		next.pacing = a;
+	} else if (strcmp(param, "tick_us") == 0) {
+		if (sscanf(value, "%d", &a) != 1 || a < TICK_MIN_US || a > TICK_MAX_US) {
+			reply(client, "error tick_us must be between %d and %d", TICK_MIN_US, TICK_MAX_US);
+			return;
+		}
+		next.tick_us = a;
+	} else {
+		reply(client, "error unknown parameter %s", param);
+		return;
+	}
+
+	publish(&next, ctx);
+	get_param(client, param);
+}
+
+// Runs one command line.
+static void run_command(control_client_t *client, char *line, control_publish_t publish, void *ctx) {
+	char command[16] = "";
+	char param[32] = "";
+	int value_at = 0;
+
+	sscanf(line, "%15s %31s %n", command, param, &value_at);
+
+	if (strcmp(command, "get") == 0 && param[0]) {
+		get_param(client, param);
+	} else if (strcmp(command, "set") == 0 && param[0] && value_at > 0 && line[value_at]) {
+		set_param(client, param, line + value_at, publish, ctx);
+	} else if (strcmp(command, "status") == 0) {
+		reply(client, "ok curve=%s pacing=%s sensitivity=%d tick_us=%d poll_hz=%u frame_us=%u "
+			"button_p99_us=%llu motion_p99_us=%llu samples=%llu frames=%llu syn_dropped=%llu "
+			"steps_dropped=%llu",
+			active_curve()->name, pacing_name(config.pacing), config.sensitivity, config.tick_us,
+			stats.polling_rate_hz, stats.frame_interval_us,
+			(unsigned long long)latency_percentile(&button_latency, 99),
+			(unsigned long long)latency_percentile(&motion_latency, 99),
+			(unsigned long long)(button_latency.count + motion_latency.count),
+			stats.frames, stats.syn_dropped, stats.steps_dropped);
+	} else if (strcmp(command, "outputs") == 0) {
+		char line[CONTROL_LINE_SIZE * 3];
+		if (outputs_status(line, sizeof(line)) == 0) {
+			reply(client, "ok no additional output");
+		} else {
+			reply(client, "ok %s", line);
+		}
+	} else if (strcmp(command, "joystick") == 0) {
+		char line[CONTROL_LINE_SIZE];
+		if (joystick_status(line, sizeof(line)) == 0) {
+			reply(client, "ok no joystick output");
+		} else {
+			reply(client, "ok %s", line);
+		}
+	} else if (strcmp(command, "reset") == 0) {
+		memset(&button_latency, 0, sizeof(button_latency));
+		memset(&motion_latency, 0, sizeof(motion_latency));
+		reply(client, "ok");
+	} else if (strcmp(command, "help") == 0) {
+		reply(client, "ok get PARAM | set PARAM VALUE | status | outputs | joystick | reset; "
+			"PARAM: sensitivity gain curve period pacing tick_us log");
+	} else if (command[0]) {
+		reply(client, "error unknown command %s", command);
+	}
+}
+
+// Reads from a client and runs its complete lines.
+static void read_client(control_client_t *client, control_publish_t publish, void *ctx) {
+	ssize_t bytes = read(client->fd, client->line + client->len, sizeof(client->line) - 1 - client->len);
+	if (bytes <= 0) {
+		if (bytes < 0 && (errno == EAGAIN || errno == EINTR)) return;
+		drop_client(client);
+		return;
+	}
+	client->len += (size_t)bytes;
+
+	char *start = client->line;
+	char *end;
+	while (client->fd >= 0 && (end = memchr(start, '\n', client->len - (size_t)(start - client->line))) != NULL) {
+		*end = '\0';
+		if (end > start && end[-1] == '\r') {
+			end[-1] = '\0';
+		}
+		run_command(client, start, publish, ctx);
+		start = end + 1;
+	}
+	if (client->fd < 0) {
+		return;
+	}
+
+	client->len -= (size_t)(start - client->line);
+	memmove(client->line, start, client->len);
+	if (client->len == sizeof(client->line) - 1) {
+		reply(client, "error line too long");
+		drop_client(client);
+	}
+}
+
+// Accepts clients and runs the complete commands they sent.
+void control_service(const fd_set *set, control_publish_t publish, void *ctx) {
+	if (listen_fd < 0) {
+		return;
+	}
+
+	for (int i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+		if (clients[i].fd >= 0 && FD_ISSET(clients[i].fd, set)) {
+			read_client(&clients[i], publish, ctx);
+		}
+	}
+
+	if (FD_ISSET(listen_fd, set)) {
+		int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0) {
+			return;
+		}
+		for (int i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+			if (clients[i].fd < 0) {
+				clients[i].fd = fd;
+				clients[i].len = 0;
+				return;
+			}
+		}
+		// All slots busy
+		static const char busy[] = "error too many clients\n";
+		send(fd, busy, sizeof(busy) - 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+		close(fd);
+	}
+}
+
+// Closes the clients and removes the socket.
+void control_cleanup(void) {
+	if (listen_fd < 0) {
+		return;
+	}
+
+	for (int i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+		if (clients[i].fd >= 0) {
+			drop_client(&clients[i]);
+		}
+	}
+	close(listen_fd);
+	listen_fd = -1;
+	unlink(socket_path);
+}
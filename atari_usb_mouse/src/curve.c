@@ -0,0 +1,116 @@
+/**
+ * @file curve.c
+ * @brief Gain and edge period curves compiled into fixed-point lookup tables.
+ *
+ * Curves are declared as piecewise linear control points in the
+ * configuration and sampled once at load time, so the event path only does
+ * integer table lookups.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "curve.h"
+#include "global.h"
+
+
+// Largest gain accepted from the configuration
+#define MAX_GAIN 64.0
+
+
+// Evaluates a piecewise linear curve, clamped to its end points.
+static double interpolate(const curve_point_t *points, int count, double x) {
+	if (x <= points[0].x) {
+		return points[0].y;
+	}
+	for (int i = 1; i < count; i++) {
+		if (x <= points[i].x) {
+			double span = points[i].x - points[i - 1].x;
+			if (span <= 0) {
+				return points[i].y;
+			}
+			return points[i - 1].y + (points[i].y - points[i - 1].y) * (x - points[i - 1].x) / span;
+		}
+	}
+	return points[count - 1].y;
+}
+
+// Checks that control points are sorted and within [min_y, max_y].
+static int check_points(const curve_point_t *points, int count, double min_y, double max_y) {
+	if (count < 1 || count > MAX_CURVE_POINTS) {
+		ERROR_PRINT("A curve needs 1 to %d points\n", MAX_CURVE_POINTS);
+		return -1;
+	}
+	for (int i = 0; i < count; i++) {
+		if (points[i].x < 0 || (i > 0 && points[i].x < points[i - 1].x)) {
+			ERROR_PRINT("Curve points must have positive, increasing x values\n");
+			return -1;
+		}
+		if (points[i].y < min_y || points[i].y > max_y) {
+			ERROR_PRINT("Curve value %g out of range [%g, %g]\n", points[i].y, min_y, max_y);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+// Initializes a curve with the built-in tables.
+void curve_init_default(curve_t *curve, const char *name) {
+	static const curve_point_t unity[] = { { 0, 1.0 } };
+	static const curve_point_t ramp[] = {
+		{ DEFAULT_SPEED_THRESHOLD, DEFAULT_MAX_DELAY },
+		{ DEFAULT_SPEED_THRESHOLD + DEFAULT_RAMP_STEPS, DEFAULT_MIN_DELAY }
+	};
+
+	snprintf(curve->name, sizeof(curve->name), "%s", name);
+	curve_build_gain(curve, unity, 1);
+	curve_build_period(curve, ramp, 2);
+}
+
+// Compiles a gain curve into the gain table.
+int curve_build_gain(curve_t *curve, const curve_point_t *points, int count) {
+	if (check_points(points, count, 0, MAX_GAIN) < 0) {
+		return -1;
+	}
+	for (int i = 0; i < CURVE_GAIN_SIZE; i++) {
+		double gain = interpolate(points, count, (double)i / (1 << CURVE_SPEED_SHIFT));
+		curve->gain_q16[i] = (uint32_t)(gain * CURVE_GAIN_ONE + 0.5);
+	}
+	return 0;
+}
+
+// Compiles an edge period curve into the period table.
+int curve_build_period(curve_t *curve, const curve_point_t *points, int count) {
+	if (check_points(points, count, 1, UINT16_MAX) < 0) {
+		return -1;
+	}
+	curve->min_period_us = UINT16_MAX;
+	for (int i = 0; i < CURVE_PERIOD_SIZE; i++) {
+		curve->period_us[i] = (uint16_t)(interpolate(points, count, i) + 0.5);
+		if (curve->period_us[i] < curve->min_period_us) {
+			curve->min_period_us = curve->period_us[i];
+		}
+	}
+	return 0;
+}
+
+// Converts a relative movement into ST counts through the gain table.
+int curve_apply_gain(const curve_t *curve, curve_axis_t *axis, int value, uint64_t time_us, int sensitivity) {
+	uint64_t interval = time_us - axis->last_time_us;
+	if (axis->last_time_us == 0 || interval > MAX_EVENT_INTERVAL_US) {
+		interval = MAX_EVENT_INTERVAL_US;
+	} else if (interval < MIN_EVENT_INTERVAL_US) {
+		interval = MIN_EVENT_INTERVAL_US;
+	}
+	axis->last_time_us = time_us;
+
+	// Speed in 1/4 counts per millisecond selects the gain
+	uint64_t speed = ((uint64_t)abs(value) * 1000ULL << CURVE_SPEED_SHIFT) / interval;
+	uint32_t gain = curve->gain_q16[speed < CURVE_GAIN_SIZE ? speed : CURVE_GAIN_SIZE - 1];
+
+	int64_t total = axis->remainder + (int64_t)value * gain / sensitivity;
+	int64_t counts = total / CURVE_GAIN_ONE;
+	axis->remainder = total - counts * CURVE_GAIN_ONE;
+	return (int)counts;
+}
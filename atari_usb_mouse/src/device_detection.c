@@ -5,11 +5,26 @@
 #include <fcntl.h>
 #include <linux/input.h>
 #include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/ioctl.h>
 
 #include "device_detection.h"
+#include "watchdog.h"
+#include "precision.h"
+#include "outputs.h"
 #include "global.h"
 
 
+// Background discovery started by discovery_start()
+static pthread_t discovery_thread;
+static int discovery_running = 0;
+static char discovery_path[256];
+static int discovery_fd = -1;
+
+
 // Tests whether the device at the given path is a compatible mouse.
 int test_mouse_device(const char *device_path) {
 	int fd;
@@ -125,10 +140,141 @@ char* wait_for_mouse_device() {
 		DEBUG_PRINT("No mouse device found, retrying in 3 seconds...\n");
 		
 		// Wait for 3 seconds in 100ms intervals, checking if still running
+		// and keeping the additional outputs fed meanwhile
 		for (int i = 0; i < 30 && running; i++) {
-			usleep(100000); // 100ms x 30 = 3 secondes
+			outputs_wait(100); // 100ms x 30 = 3 secondes
+			watchdog_ping();
 		}
 	}
 	
 	return NULL;
 }
+
+// Switches the event timestamps of an input device to CLOCK_MONOTONIC.
+int set_monotonic_timestamps(int fd) {
+	int clock = CLOCK_MONOTONIC;
+
+	if (ioctl(fd, EVIOCSCLOCKID, &clock) < 0) {
+		DEBUG_PRINT("EVIOCSCLOCKID failed: %s\n", strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+// Reads the USB identity and the name of an input device.
+int read_device_identity(int fd, int *vendor, int *product, char *name, size_t size) {
+	struct input_id id;
+
+	if (ioctl(fd, EVIOCGID, &id) < 0) {
+		DEBUG_PRINT("EVIOCGID failed: %s\n", strerror(errno));
+		return -1;
+	}
+	*vendor = id.vendor;
+	*product = id.product;
+
+	memset(name, 0, size);
+	if (ioctl(fd, EVIOCGNAME(size - 1), name) < 0) {
+		name[0] = '\0';
+	}
+	return 0;
+}
+
+// Returns the last mouse device found, if it is still a compatible mouse.
+char *cached_mouse_device(void) {
+	static char device_path[64];
+
+	FILE *fp = fopen(DEVICE_CACHE_PATH, "r");
+	if (fp == NULL) {
+		return NULL;
+	}
+	int found = (fscanf(fp, "%63s", device_path) == 1);
+	fclose(fp);
+
+	if (!found || !test_mouse_device(device_path)) {
+		DEBUG_PRINT("Cached mouse device is gone\n");
+		return NULL;
+	}
+	DEBUG_PRINT("Using cached mouse device %s\n", device_path);
+	return device_path;
+}
+
+// Remembers a mouse device for the next start.
+void cache_mouse_device(const char *device_path) {
+	char cached[64] = "";
+
+	// Only written when it changes: the cache often lives on an SD card
+	FILE *fp = fopen(DEVICE_CACHE_PATH, "r");
+	if (fp != NULL) {
+		if (fscanf(fp, "%63s", cached) != 1) {
+			cached[0] = '\0';
+		}
+		fclose(fp);
+	}
+	if (strcmp(cached, device_path) == 0) {
+		return;
+	}
+
+	fp = fopen(DEVICE_CACHE_PATH, "w");
+	if (fp == NULL) {
+		DEBUG_PRINT("Cannot write %s: %s\n", DEVICE_CACHE_PATH, strerror(errno));
+		return;
+	}
+	fprintf(fp, "%s\n", device_path);
+	fclose(fp);
+}
+
+// Finds and opens the input device, in the background.
+static void *discovery_main(void *arg) {
+	(void)arg;
+
+	// A configured device is opened as is, without a capability check
+	if (discovery_path[0] == '\0') {
+		char *found = cached_mouse_device();
+		if (found == NULL) {
+			found = find_mouse_device();
+		}
+		if (found == NULL) {
+			return NULL;
+		}
+		snprintf(discovery_path, sizeof(discovery_path), "%s", found);
+	}
+
+	discovery_fd = open(discovery_path, O_RDONLY | O_NONBLOCK);
+	if (discovery_fd < 0) {
+		DEBUG_PRINT("Cannot open %s: %s\n", discovery_path, strerror(errno));
+	}
+	return NULL;
+}
+
+// Starts looking for the input device while the caller goes on.
+int discovery_start(const char *device_path) {
+	snprintf(discovery_path, sizeof(discovery_path), "%s", device_path);
+	discovery_fd = -1;
+
+	// Signals stay with the main thread, which owns the running flag
+	sigset_t all, old;
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+	int err = pthread_create(&discovery_thread, precision_thread_attr(), discovery_main, NULL);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (err != 0) {
+		ERROR_PRINT("Cannot start device discovery: %s\n", strerror(err));
+		return -1;
+	}
+	discovery_running = 1;
+	return 0;
+}
+
+// Waits for the discovery and returns the device it opened.
+int discovery_join(char *device_path, size_t size) {
+	if (!discovery_running) {
+		return -1;
+	}
+	pthread_join(discovery_thread, NULL);
+	discovery_running = 0;
+
+	if (discovery_fd >= 0) {
+		snprintf(device_path, size, "%s", discovery_path);
+	}
+	return discovery_fd;
+}
@@ -0,0 +1,173 @@
+/**
+ * @file filter.c
+ * @brief Motion filter chain run on every input frame.
+ *
+ * The chain declared in the configuration is built once into a flat array
+ * of stages. Each frame goes through a switch on the stage type, with the
+ * state of every stage kept in its slot: no allocation, no indirect call.
+ * Chains made of invert and swap stages, the common case, are folded into
+ * a single mapping when they are built.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "filter.h"
+
+
+static const char *path_names[] = { "map", "map+curve", "generic" };
+
+
+// Builds a chain and picks the fastest way to run it.
+void filter_chain_build(filter_chain_t *chain, const filter_config_t *filters, int count) {
+	memset(chain, 0, sizeof(*chain));
+	chain->count = count;
+	chain->source[0] = 0;
+	chain->source[1] = 1;
+	chain->sign[0] = chain->sign[1] = 1;
+	chain->path = FILTER_PATH_MAP;
+
+	for (int i = 0; i < count; i++) {
+		chain->stages[i].cfg = filters[i];
+
+		if (chain->path != FILTER_PATH_MAP) {
+			chain->path = FILTER_PATH_GENERIC;
+		} else if (filters[i].stage == FILTER_INVERT) {
+			for (int axis = 0; axis < 2; axis++) {
+				if (filters[i].axes & (1 << axis)) {
+					chain->sign[axis] = -chain->sign[axis];
+				}
+			}
+		} else if (filters[i].stage == FILTER_SWAP) {
+			int source = chain->source[0], sign = chain->sign[0];
+			chain->source[0] = chain->source[1];
+			chain->sign[0] = chain->sign[1];
+			chain->source[1] = source;
+			chain->sign[1] = sign;
+		} else if (filters[i].stage == FILTER_CURVE && i == count - 1) {
+			chain->path = FILTER_PATH_MAP_CURVE;
+		} else {
+			chain->path = FILTER_PATH_GENERIC;
+		}
+	}
+}
+
+// Clears the state of every stage of a chain, keeping their configuration.
+void filter_chain_reset(filter_chain_t *chain) {
+	for (int i = 0; i < chain->count; i++) {
+		filter_config_t cfg = chain->stages[i].cfg;
+		memset(&chain->stages[i], 0, sizeof(chain->stages[i]));
+		chain->stages[i].cfg = cfg;
+	}
+}
+
+// Applies the gain of the curve to the axes of a stage.
+static void run_curve(filter_stage_t *stage, motion_frame_t *frame, const curve_t *curve, int sensitivity) {
+	for (int axis = 0; axis < 2; axis++) {
+		if ((stage->cfg.axes & (1 << axis)) && frame->d[axis] != 0) {
+			frame->d[axis] = curve_apply_gain(curve, &stage->gain[axis], frame->d[axis], frame->time_us, sensitivity);
+		}
+	}
+}
+
+// Moving average of the axes of a stage, the fraction carried over.
+static void run_smooth(filter_stage_t *stage, motion_frame_t *frame) {
+	// After a pause the mouse starts from rest: nothing left to average or carry
+	if (frame->time_us - stage->last_us > MAX_EVENT_INTERVAL_US) {
+		memset(stage->average, 0, sizeof(stage->average));
+		memset(stage->carry, 0, sizeof(stage->carry));
+	}
+	stage->last_us = frame->time_us;
+
+	for (int axis = 0; axis < 2; axis++) {
+		if (!(stage->cfg.axes & (1 << axis))) continue;
+
+		int64_t sample = (int64_t)frame->d[axis] * CURVE_GAIN_ONE;
+		stage->average[axis] += (sample - stage->average[axis]) * stage->cfg.value / 100;
+
+		int64_t total = stage->carry[axis] + stage->average[axis];
+		int64_t counts = total / CURVE_GAIN_ONE;
+		stage->carry[axis] = total - counts * CURVE_GAIN_ONE;
+		frame->d[axis] = (int32_t)counts;
+	}
+}
+
+// Clamps the axes of a stage to its rate over the time since the previous frame.
+static void run_rate_cap(filter_stage_t *stage, motion_frame_t *frame) {
+	uint64_t interval = frame->time_us - stage->last_us;
+	if (stage->last_us == 0 || interval > MAX_EVENT_INTERVAL_US) {
+		interval = MAX_EVENT_INTERVAL_US;
+	} else if (interval < MIN_EVENT_INTERVAL_US) {
+		interval = MIN_EVENT_INTERVAL_US;
+	}
+	stage->last_us = frame->time_us;
+
+	int32_t limit = (int32_t)((uint64_t)stage->cfg.value * interval / 1000ULL);
+	if (limit < 1) limit = 1;
+	for (int axis = 0; axis < 2; axis++) {
+		if (!(stage->cfg.axes & (1 << axis))) continue;
+		if (frame->d[axis] > limit) {
+			frame->d[axis] = limit;
+		} else if (frame->d[axis] < -limit) {
+			frame->d[axis] = -limit;
+		}
+	}
+}
+
+// Runs a frame through a chain, in place.
+void filter_chain_run(filter_chain_t *chain, motion_frame_t *frame, const curve_t *curve, int sensitivity) {
+	if (chain->path != FILTER_PATH_GENERIC) {
+		int32_t x = frame->d[chain->source[0]];
+		int32_t y = frame->d[chain->source[1]];
+		frame->d[0] = chain->sign[0] * x;
+		frame->d[1] = chain->sign[1] * y;
+		if (chain->path == FILTER_PATH_MAP_CURVE) {
+			run_curve(&chain->stages[chain->count - 1], frame, curve, sensitivity);
+		}
+		return;
+	}
+
+	for (int i = 0; i < chain->count; i++) {
+		filter_stage_t *stage = &chain->stages[i];
+
+		switch (stage->cfg.stage) {
+			case FILTER_INVERT:
+				for (int axis = 0; axis < 2; axis++) {
+					if (stage->cfg.axes & (1 << axis)) {
+						frame->d[axis] = -frame->d[axis];
+					}
+				}
+				break;
+
+			case FILTER_SWAP: {
+				int32_t x = frame->d[0];
+				frame->d[0] = frame->d[1];
+				frame->d[1] = x;
+				break;
+			}
+
+			case FILTER_DEADZONE:
+				if (abs(frame->d[0]) <= stage->cfg.value && abs(frame->d[1]) <= stage->cfg.value) {
+					frame->d[0] = frame->d[1] = 0;
+				}
+				break;
+
+			case FILTER_SMOOTH:
+				run_smooth(stage, frame);
+				break;
+
+			case FILTER_CURVE:
+				run_curve(stage, frame, curve, sensitivity);
+				break;
+
+			case FILTER_RATE_CAP:
+				run_rate_cap(stage, frame);
+				break;
+		}
+	}
+}
+
+// Returns the name of a FILTER_PATH_* value.
+const char *filter_path_name(int path) {
+	return path_names[path];
+}
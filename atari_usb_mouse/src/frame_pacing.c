@@ -0,0 +1,170 @@
+/**
+ * @file frame_pacing.c
+ * @brief Polling rate detection and pulse pacing over the input frame interval.
+ *
+ * A mouse reports once per USB poll while it moves. Emitting each frame's
+ * steps evenly over the interval until the next frame avoids both the
+ * bursts and gaps of slow polling rates and the backlog of fast ones.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "frame_pacing.h"
+#include "config.h"
+#include "monitor.h"
+#include "global.h"
+
+
+// Standard USB polling rates, slowest first
+static const unsigned int standard_rates[] = { 125, 250, 500, 1000, 2000, 4000, 8000 };
+#define NUM_RATES (sizeof(standard_rates) / sizeof(standard_rates[0]))
+
+// Votes are halved once this many are accumulated, so the estimate follows changes
+#define RATE_VOTE_WINDOW 64
+// Votes needed before a rate is reported
+#define RATE_MIN_VOTES 8
+
+static unsigned int rate_votes[NUM_RATES];
+static unsigned int votes_total = 0;
+static uint64_t last_frame_us = 0;
+static uint32_t avg_interval_q4 = 0;	// Smoothed frame interval (Q28.4 microseconds)
+
+// Largest number of slots emitted for one frame
+#define FRAME_MAX_SLOTS 256
+
+// Steps of the current frame
+static int frame_steps[2] = { 0, 0 };
+
+// Output clock time of the last emitted step
+static uint64_t last_step_ns = 0;
+
+
+// Accounts the end of an input frame and updates the polling rate estimate.
+void frame_rate_update(uint64_t time_us) {
+	uint64_t interval = time_us - last_frame_us;
+	int first = (last_frame_us == 0);
+
+	last_frame_us = time_us;
+	if (first || interval == 0 || interval > FRAME_MAX_INTERVAL_US) {
+		return;
+	}
+
+	// Exponential average, 1/8 weight per frame
+	if (avg_interval_q4 == 0) {
+		avg_interval_q4 = (uint32_t)(interval << 4);
+	} else {
+		avg_interval_q4 = (uint32_t)((int64_t)avg_interval_q4 + (((int64_t)interval << 4) - (int64_t)avg_interval_q4) / 8);
+	}
+	stats.frame_interval_us = avg_interval_q4 >> 4;
+
+	// Vote for the standard rate whose interval is within 25%
+	for (size_t i = 0; i < NUM_RATES; i++) {
+		uint64_t nominal = 1000000 / standard_rates[i];
+		if (interval * 4 >= nominal * 3 && interval * 4 <= nominal * 5) {
+			rate_votes[i]++;
+			votes_total++;
+			break;
+		}
+	}
+	if (votes_total >= RATE_VOTE_WINDOW) {
+		votes_total = 0;
+		for (size_t i = 0; i < NUM_RATES; i++) {
+			rate_votes[i] /= 2;
+			votes_total += rate_votes[i];
+		}
+	}
+
+	// Skipped polls only ever vote for slower rates: take the fastest one
+	// holding a quarter of the votes
+	unsigned int detected = 0;
+	if (votes_total >= RATE_MIN_VOTES) {
+		for (size_t i = NUM_RATES; i-- > 0;) {
+			if (rate_votes[i] * 4 >= votes_total) {
+				detected = standard_rates[i];
+				break;
+			}
+		}
+	}
+	if (detected != stats.polling_rate_hz) {
+		DEBUG_PRINT("Polling rate: %u Hz\n", detected);
+		stats.polling_rate_hz = detected;
+	}
+}
+
+// Returns the expected interval until the next input frame.
+unsigned int frame_interval_us(void) {
+	if (stats.polling_rate_hz) {
+		return 1000000 / stats.polling_rate_hz;
+	}
+	if (stats.frame_interval_us) {
+		return stats.frame_interval_us;
+	}
+	return FRAME_DEFAULT_INTERVAL_US;
+}
+
+// Queues quadrature steps of the current frame.
+void frame_add(int axis, int steps) {
+	frame_steps[axis] += steps;
+}
+
+// Emits the steps of the current frame spread over the frame interval.
+void frame_emit(quadrature_state_t *state) {
+	int count[2] = { abs(frame_steps[0]), abs(frame_steps[1]) };
+	int total = count[0] > count[1] ? count[0] : count[1];
+	if (total == 0) {
+		return;
+	}
+
+	// n steps at interval/n: the last one lands a period before the next frame
+	int interval = (int)frame_interval_us();
+	int min_period = active_curve()->min_period_us;
+	int fit = interval / min_period;
+	if (fit < 1) {
+		fit = 1;
+	} else if (fit > FRAME_MAX_SLOTS) {
+		fit = FRAME_MAX_SLOTS;
+	}
+	if (total > fit) {
+		// Keep the direction: scale both axes, carry the rest to the next frame
+		count[0] = (int)((int64_t)count[0] * fit / total);
+		count[1] = (int)((int64_t)count[1] * fit / total);
+		total = fit;
+	}
+	int period = interval / total;
+
+	// Interleave the axes, Bresenham style, one slot per period
+	static int8_t steps[FRAME_MAX_SLOTS][2];
+	int direction[2] = { frame_steps[0] > 0 ? 1 : -1, frame_steps[1] > 0 ? 1 : -1 };
+	for (int slot = 0; slot < total; slot++) {
+		for (int axis = 0; axis < 2; axis++) {
+			int due = (int64_t)(slot + 1) * count[axis] / total > (int64_t)slot * count[axis] / total;
+			steps[slot][axis] = (int8_t)(due ? direction[axis] : 0);
+			frame_steps[axis] -= steps[slot][axis];
+		}
+	}
+
+	// Carry one frame's worth at most: motion the output cannot catch up with is dropped
+	for (int axis = 0; axis < 2; axis++) {
+		if (abs(frame_steps[axis]) > fit) {
+			stats.steps_dropped += (unsigned long long)(abs(frame_steps[axis]) - fit);
+			frame_steps[axis] = (frame_steps[axis] > 0) ? fit : -fit;
+		}
+	}
+
+	// A late frame must not start right on the heels of the previous one
+	uint64_t since_last = output_clock_ns() - last_step_ns;
+	if (last_step_ns && since_last < (uint64_t)min_period * 1000ULL) {
+		edge_delay(min_period - (int)(since_last / 1000ULL));
+	}
+
+	emit_step_train(state, (const int8_t (*)[2])steps, total, period, 0);
+	last_step_ns = output_clock_ns();
+}
+
+// Emits the steps carried over from previous frames.
+void frame_flush(quadrature_state_t *state) {
+	while (frame_steps[0] != 0 || frame_steps[1] != 0) {
+		frame_emit(state);
+	}
+}
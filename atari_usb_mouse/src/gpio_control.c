@@ -4,39 +4,77 @@
 #include <gpiod.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
 
 #include "gpio_control.h"
 #include "config.h"
+#include "button_lane.h"
+#include "precision.h"
+#include "watchdog.h"
+#include "ikbd_serial.h"
+#include "vcd.h"
 #include "global.h"
 
 
-// Delay between quadrature transitions (in microseconds)
-#define QUADRATURE_DELAY 2000
-#define MIN_DELAY 500      // Minimum delay (500µs for fast movements)
-#define MAX_DELAY 2000     // Maximum delay (2ms for slow movements)
-#define SPEED_THRESHOLD 5  // Threshold to consider a movement as "fast"
-
-// GPIO chip device (usually /dev/gpiochip0 on Raspberry Pi)
-#define GPIO_CHIP_DEVICE "/dev/gpiochip0"
-
 // GPIO chip and request handles
 static struct gpiod_chip *chip = NULL;
 static struct gpiod_line_request *request = NULL;
 
-// Line offsets array for easier management
-static unsigned int line_offsets[6];
-
-// Line indices for easier reference
-enum {
-    LINE_XA = 0,
-    LINE_XB = 1,
-    LINE_YA = 2,
-    LINE_YB = 3,
-    LINE_LEFT_BUTTON = 4,
-    LINE_RIGHT_BUTTON = 5,
-    NUM_LINES = 6
+// Line request inherited from a previous instance, driven through the kernel uAPI
+static int adopted_fd = -1;
+
+/**
+ * Line set of an additional output: its own chip, request and levels.
+ */
+struct output_lines {
+	struct gpiod_chip *chip;		// NULL with the null backend
+	struct gpiod_line_request *request;
+	unsigned int offsets[NUM_LINES];
+	int count;
+	uint32_t idle;			// Levels driven when opened and closed
+	uint32_t levels;
 };
 
+// Line offsets array for easier management
+static unsigned int line_offsets[NUM_LINES];
+
+// Pins of the request made at start (or inherited), and the line driving each, -1 when parked as input
+static unsigned int request_offsets[NUM_LINES];
+static int slot_lines[NUM_LINES];
+
+// Index of every line in that request, -1 for a line moved to a request of its own
+static int line_slots[NUM_LINES];
+static struct gpiod_line_request *moved_requests[NUM_LINES];
+
+// Current level of every line (bit n = line n), as last driven
+static uint32_t line_levels = 0;
+
+// CLOCK_MONOTONIC time of the first edge after output_watch_first_edge(), 0 until then
+static uint64_t first_edge_ns = 0;
+static int first_edge_watched = 0;
+
+// Virtual output clock of the null backend (in nanoseconds)
+static uint64_t virtual_clock_ns = 0;
+
+// Serializes line updates between the event path and the tick thread
+static pthread_mutex_t output_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Edge trace output, NULL when disabled
+static FILE *edge_trace = NULL;
+
+// Set while a VCD dump of the lines is open
+static int vcd_dump = 0;
+
+// Levels driven when lines are idle: quadrature at 0, buttons released (1)
+#define IDLE_LEVELS ((1u << LINE_LEFT_BUTTON) | (1u << LINE_RIGHT_BUTTON))
+
+int output_backend = OUTPUT_GPIO;
+
 
 // Quadrature states for forward (clockwise) motion
 // 00 -> 01 -> 11 -> 10 -> 00
@@ -48,89 +86,307 @@ static const int quad_states[4][2] = {
 };
 
 
-int init_gpio() {
-	struct gpiod_line_settings *settings = NULL;
-	struct gpiod_line_config *line_config = NULL;
-	struct gpiod_request_config *req_config = NULL;
-	enum gpiod_line_value initial_values[NUM_LINES];
+// Returns the output clock used to timestamp edges.
+uint64_t output_clock_ns() {
+	if (output_backend == OUTPUT_NULL) {
+		return virtual_clock_ns;
+	}
 
-	// Open GPIO chip
-	chip = gpiod_chip_open(GPIO_CHIP_DEVICE);
-	if (!chip) {
-		ERROR_PRINT("Unable to open GPIO chip %s\n", GPIO_CHIP_DEVICE);
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Records the new line levels and appends the transition to the edge trace and the VCD dump.
+static void update_levels(uint32_t levels) {
+	uint32_t changed = levels ^ line_levels;
+
+	line_levels = levels;
+	if (first_edge_watched && changed) {
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		first_edge_ns = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+		first_edge_watched = 0;
+	}
+	if (changed && (edge_trace || vcd_dump)) {
+		uint64_t time_ns = output_clock_ns();
+		if (edge_trace) {
+			edge_record_t rec = { time_ns, levels, changed };
+			fwrite(&rec, sizeof(rec), 1, edge_trace);
+		}
+		if (vcd_dump) {
+			vcd_record(time_ns, levels, changed);
+		}
+	}
+}
+
+// Waits between two quadrature transitions.
+void edge_delay(int delay_us) {
+	// An edge went out: the event loop is making progress
+	stall_progress(STAGE_INPUT);
+
+	if (output_backend == OUTPUT_NULL) {
+		virtual_clock_ns += (uint64_t)delay_us * 1000ULL;
+	} else if (button_lane_active()) {
+		button_lane_wait(delay_us);
+	} else {
+		usleep(delay_us);
+	}
+}
+
+// Starts watching for the next line transition.
+void output_watch_first_edge(void) {
+	pthread_mutex_lock(&output_lock);
+	first_edge_ns = 0;
+	first_edge_watched = 1;
+	pthread_mutex_unlock(&output_lock);
+}
+
+// Returns the time of the first transition watched for, 0 if none yet.
+uint64_t output_first_edge_ns(void) {
+	pthread_mutex_lock(&output_lock);
+	uint64_t time_ns = first_edge_ns;
+	pthread_mutex_unlock(&output_lock);
+	return time_ns;
+}
+
+// Opens a file receiving every line transition as edge_record_t entries.
+int open_edge_trace(const char *path) {
+	edge_trace = fopen(path, "wb");
+	if (edge_trace == NULL) {
+		ERROR_PRINT("Cannot create edge trace %s: %s\n", path, strerror(errno));
 		return -1;
 	}
 
-	// Setup line offsets from config
-	line_offsets[LINE_XA] = config.pin_xa;
-	line_offsets[LINE_XB] = config.pin_xb;
-	line_offsets[LINE_YA] = config.pin_ya;
-	line_offsets[LINE_YB] = config.pin_yb;
-	line_offsets[LINE_LEFT_BUTTON] = config.pin_left_button;
-	line_offsets[LINE_RIGHT_BUTTON] = config.pin_right_button;
+	// Header followed by the initial levels, flagged as all lines changed
+	edge_record_t rec = { output_clock_ns(), line_levels, (1u << NUM_LINES) - 1 };
+	fwrite(EDGE_TRACE_MAGIC, 1, 8, edge_trace);
+	fwrite(&rec, sizeof(rec), 1, edge_trace);
 
-	// Set initial values (quadrature lines start at 0, buttons released = 1)
-	initial_values[LINE_XA] = GPIOD_LINE_VALUE_INACTIVE;
-	initial_values[LINE_XB] = GPIOD_LINE_VALUE_INACTIVE;
-	initial_values[LINE_YA] = GPIOD_LINE_VALUE_INACTIVE;
-	initial_values[LINE_YB] = GPIOD_LINE_VALUE_INACTIVE;
-	initial_values[LINE_LEFT_BUTTON] = GPIOD_LINE_VALUE_ACTIVE;   // Button released
-	initial_values[LINE_RIGHT_BUTTON] = GPIOD_LINE_VALUE_ACTIVE;  // Button released
+	DEBUG_PRINT("Edge trace written to %s\n", path);
+	return 0;
+}
 
-	DEBUG_PRINT("Configuring GPIO ports as OUTPUT\n");
+// Flushes and closes the edge trace file, if any.
+void close_edge_trace() {
+	if (edge_trace) {
+		fclose(edge_trace);
+		edge_trace = NULL;
+	}
+}
+
+// Opens a VCD dump receiving every line transition.
+int open_vcd_dump(const char *path) {
+	// Replays on the null backend keep every edge, live runs never wait for the writer
+	if (vcd_open(path, line_levels, output_backend == OUTPUT_NULL) < 0) {
+		return -1;
+	}
+	vcd_dump = 1;
+	return 0;
+}
+
+// Writes out and closes the VCD dump, if any.
+void close_vcd_dump(void) {
+	if (vcd_dump) {
+		pthread_mutex_lock(&output_lock);
+		vcd_dump = 0;
+		pthread_mutex_unlock(&output_lock);
+		vcd_close();
+	}
+}
+
+// Moves the virtual output clock of the null backend forward to an input timestamp.
+void output_sync_clock(uint64_t time_ns) {
+	if (time_ns > virtual_clock_ns) {
+		virtual_clock_ns = time_ns;
+	}
+}
+
+// Returns the value of a line in a set of levels.
+static enum gpiod_line_value line_value(uint32_t levels, int line) {
+	return (levels & (1u << line)) ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE;
+}
+
+// Drives some lines to their levels, those of the main request in a single call.
+static int drive_lines(uint32_t lines, uint32_t levels) {
+	unsigned int offsets[NUM_LINES];
+	enum gpiod_line_value values[NUM_LINES];
+	struct gpio_v2_line_values adopted = { 0, 0 };
+	size_t count = 0;
+	int result = 0;
+
+	for (int line = 0; line < NUM_LINES; line++) {
+		int slot = line_slots[line];
+
+		if (!(lines & (1u << line))) {
+			continue;
+		}
+		if (slot < 0) {
+			if (moved_requests[line] && gpiod_line_request_set_value(moved_requests[line], line_offsets[line], line_value(levels, line)) < 0) {
+				result = -1;
+			}
+		} else if (request) {
+			offsets[count] = request_offsets[slot];
+			values[count] = line_value(levels, line);
+			count++;
+		} else {
+			// Inherited request: bit n = n-th pin of the request
+			adopted.mask |= 1ULL << slot;
+			adopted.bits |= (uint64_t)((levels >> line) & 1u) << slot;
+		}
+	}
+
+	if (count > 0 && gpiod_line_request_set_values_subset(request, count, offsets, values) < 0) {
+		result = -1;
+	}
+	if (adopted.mask && adopted_fd >= 0 && ioctl(adopted_fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &adopted) < 0) {
+		DEBUG_PRINT("Cannot set inherited lines: %s\n", strerror(errno));
+		result = -1;
+	}
+	return result;
+}
+
+// Gives every line the pin of the same index in the main request.
+static void reset_slots(void) {
+	memcpy(request_offsets, line_offsets, sizeof(request_offsets));
+	for (int line = 0; line < NUM_LINES; line++) {
+		slot_lines[line] = line_slots[line] = line;
+		moved_requests[line] = NULL;
+	}
+}
+
+// Releases the requests of lines moved off the main request.
+static void release_moved_lines(void) {
+	for (int line = 0; line < NUM_LINES; line++) {
+		if (moved_requests[line]) {
+			gpiod_line_request_release(moved_requests[line]);
+			moved_requests[line] = NULL;
+		}
+	}
+}
+
+// Sets the pins of the main request with a line as outputs at its level, the others as inputs.
+static int configure_request(const int *lines, uint32_t levels) {
+	if (adopted_fd >= 0) {
+		struct gpio_v2_line_config line_config;
+		uint64_t outputs = 0;
+		uint64_t values = 0;
+
+		for (int slot = 0; slot < NUM_LINES; slot++) {
+			if (lines[slot] >= 0) {
+				outputs |= 1ULL << slot;
+				values |= (uint64_t)((levels >> lines[slot]) & 1u) << slot;
+			}
+		}
+		memset(&line_config, 0, sizeof(line_config));
+		line_config.flags = GPIO_V2_LINE_FLAG_INPUT;
+		if (outputs) {
+			line_config.num_attrs = 2;
+			line_config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_FLAGS;
+			line_config.attrs[0].attr.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+			line_config.attrs[0].mask = outputs;
+			line_config.attrs[1].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+			line_config.attrs[1].attr.values = values;
+			line_config.attrs[1].mask = outputs;
+		}
+		if (ioctl(adopted_fd, GPIO_V2_LINE_SET_CONFIG_IOCTL, &line_config) < 0) {
+			ERROR_PRINT("Cannot reconfigure inherited lines: %s\n", strerror(errno));
+			return -1;
+		}
+		return 0;
+	}
+
+	struct gpiod_line_settings *settings = gpiod_line_settings_new();
+	struct gpiod_line_config *line_config = gpiod_line_config_new();
+	int result = -1;
+
+	if (settings && line_config) {
+		result = 0;
+		for (int slot = 0; slot < NUM_LINES && result == 0; slot++) {
+			if (lines[slot] >= 0) {
+				gpiod_line_settings_set_direction(settings, GPIOD_LINE_DIRECTION_OUTPUT);
+				gpiod_line_settings_set_output_value(settings, line_value(levels, lines[slot]));
+			} else {
+				gpiod_line_settings_set_direction(settings, GPIOD_LINE_DIRECTION_INPUT);
+			}
+			result = gpiod_line_config_add_line_settings(line_config, &request_offsets[slot], 1, settings);
+		}
+		if (result == 0) {
+			result = gpiod_line_request_reconfigure_lines(request, line_config);
+		}
+	}
+	if (result < 0) {
+		ERROR_PRINT("Cannot reconfigure GPIO lines\n");
+	}
+
+	if (settings)
+		gpiod_line_settings_free(settings);
+	if (line_config)
+		gpiod_line_config_free(line_config);
+
+	return result;
+}
+
+// Requests lines of a chip at the given offsets as outputs driven to the given levels.
+static struct gpiod_line_request *request_lines(struct gpiod_chip *from, const unsigned int *offsets, int count, uint32_t levels) {
+	struct gpiod_line_settings *settings = NULL;
+	struct gpiod_line_config *line_config = NULL;
+	struct gpiod_request_config *req_config = NULL;
+	struct gpiod_line_request *lines = NULL;
+	enum gpiod_line_value initial_values[NUM_LINES];
+
+	for (int line = 0; line < count; line++) {
+		initial_values[line] = (levels & (1u << line)) ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE;
+	}
 
 	// Create line settings for output
 	settings = gpiod_line_settings_new();
 	if (!settings) {
 		ERROR_PRINT("Failed to create line settings\n");
-		return -1;
+		goto out;
 	}
 
 	if (gpiod_line_settings_set_direction(settings, GPIOD_LINE_DIRECTION_OUTPUT) != 0) {
 		ERROR_PRINT("Failed to set line direction\n");
-		return -1;
+		goto out;
 	}
 
 	// Create line configuration
 	line_config = gpiod_line_config_new();
 	if (!line_config) {
 		ERROR_PRINT("Failed to create line config\n");
-		return -1;
+		goto out;
 	}
 
 	// Apply settings to all lines
-	if (gpiod_line_config_add_line_settings(line_config, line_offsets, NUM_LINES, settings) != 0) {
+	if (gpiod_line_config_add_line_settings(line_config, offsets, (size_t)count, settings) != 0) {
 		ERROR_PRINT("Failed to add line settings to config\n");
-		return -1;
+		goto out;
 	}
 
 	// Set initial output values
-	if (gpiod_line_config_set_output_values(line_config, initial_values, NUM_LINES) != 0) {
+	if (gpiod_line_config_set_output_values(line_config, initial_values, (size_t)count) != 0) {
 		ERROR_PRINT("Failed to set initial output values\n");
-		return -1;
+		goto out;
 	}
 
 	// Create request configuration
 	req_config = gpiod_request_config_new();
 	if (!req_config) {
 		ERROR_PRINT("Failed to create request config\n");
-		return -1;
+		goto out;
 	}
 
 	// Set consumer name
 	gpiod_request_config_set_consumer(req_config, "quadrature_controller");
 
 	// Request the lines
-	request = gpiod_chip_request_lines(chip, req_config, line_config);
-	if (!request) {
+	lines = gpiod_chip_request_lines(from, req_config, line_config);
+	if (!lines) {
 		ERROR_PRINT("Failed to request GPIO lines\n");
-		return -1;
 	}
 
-	gpio_initialized = 1;
-
-	DEBUG_PRINT("GPIO initialization complete\n");
-
+out:
 	// Clean up temporary objects
 	if (settings)
 		gpiod_line_settings_free(settings);
@@ -139,9 +395,277 @@ int init_gpio() {
 	if (req_config)
 		gpiod_request_config_free(req_config);
 
+	return lines;
+}
+
+int init_gpio() {
+	line_levels = IDLE_LEVELS;
+
+	// Null backend: nothing to request, lines only exist in the trace
+	if (output_backend == OUTPUT_NULL) {
+		DEBUG_PRINT("Null output backend, GPIO lines not requested\n");
+		gpio_initialized = 1;
+		return 0;
+	}
+
+	// IKBD backend: the serial line carries motion and buttons
+	if (output_backend == OUTPUT_IKBD) {
+		DEBUG_PRINT("IKBD output backend, GPIO lines not requested\n");
+		gpio_initialized = 1;
+		return 0;
+	}
+
+	// Open GPIO chip
+	chip = gpiod_chip_open(config.gpio_chip);
+	if (!chip) {
+		ERROR_PRINT("Unable to open GPIO chip %s\n", config.gpio_chip);
+		return -1;
+	}
+
+	// Setup line offsets from config
+	line_offsets[LINE_XA] = config.pin_xa;
+	line_offsets[LINE_XB] = config.pin_xb;
+	line_offsets[LINE_YA] = config.pin_ya;
+	line_offsets[LINE_YB] = config.pin_yb;
+	line_offsets[LINE_LEFT_BUTTON] = config.pin_left_button;
+	line_offsets[LINE_RIGHT_BUTTON] = config.pin_right_button;
+
+	// Quadrature lines start at 0, buttons released = 1
+	DEBUG_PRINT("Configuring GPIO ports as OUTPUT\n");
+	request = request_lines(chip, line_offsets, NUM_LINES, IDLE_LEVELS);
+	if (!request) {
+		return -1;
+	}
+	reset_slots();
+
+	gpio_initialized = 1;
+
+	DEBUG_PRINT("GPIO initialization complete\n");
+
+	return 0;
+}
+
+// Takes over lines requested by a previous instance, without changing their levels.
+int adopt_gpio_lines(int line_fd, const unsigned int *offsets, uint32_t levels) {
+	line_levels = levels;
+	memcpy(line_offsets, offsets, sizeof(line_offsets));
+
+	if (output_backend != OUTPUT_GPIO) {
+		gpio_initialized = 1;
+		return 0;
+	}
+	if (line_fd < 0) {
+		ERROR_PRINT("No GPIO line request to take over\n");
+		return -1;
+	}
+
+	// The chip is only needed to move lines later on
+	chip = gpiod_chip_open(config.gpio_chip);
+	if (!chip) {
+		ERROR_PRINT("Unable to open GPIO chip %s\n", config.gpio_chip);
+		return -1;
+	}
+
+	adopted_fd = line_fd;
+	reset_slots();
+	gpio_initialized = 1;
+	DEBUG_PRINT("GPIO lines taken over (fd %d)\n", line_fd);
 	return 0;
 }
 
+// Returns the descriptor of the line request, -1 if none or if lines moved off it.
+int gpio_line_fd(void) {
+	if (!request && adopted_fd < 0) {
+		return -1;
+	}
+	// The next instance expects bit n of the request to be line n
+	for (int line = 0; line < NUM_LINES; line++) {
+		if (line_slots[line] != line) {
+			return -1;
+		}
+	}
+	if (request) {
+		return gpiod_line_request_get_fd(request);
+	}
+	return adopted_fd;
+}
+
+// Returns the line offsets and their current levels.
+void gpio_get_lines(unsigned int *offsets, uint32_t *levels) {
+	pthread_mutex_lock(&output_lock);
+	memcpy(offsets, line_offsets, sizeof(line_offsets));
+	*levels = line_levels;
+	pthread_mutex_unlock(&output_lock);
+}
+
+// Moves lines whose pin changed in the configuration, the other lines staying requested.
+int reconfigure_gpio_lines(void) {
+	unsigned int offsets[NUM_LINES] = {
+		config.pin_xa, config.pin_xb, config.pin_ya, config.pin_yb,
+		config.pin_left_button, config.pin_right_button
+	};
+	int moved = 0;
+
+	for (int line = 0; line < NUM_LINES; line++) {
+		moved += (offsets[line] != line_offsets[line]);
+	}
+	if (moved == 0 || (!request && adopted_fd < 0)) {
+		memcpy(line_offsets, offsets, sizeof(line_offsets));
+		return moved;
+	}
+
+	pthread_mutex_lock(&output_lock);
+
+	// Lines that stay keep their pin of the main request, moved lines take a
+	// pin of it left free, or a request of their own
+	int next_slot_lines[NUM_LINES];
+	int next_line_slots[NUM_LINES];
+	uint32_t leaving = 0;
+	for (int slot = 0; slot < NUM_LINES; slot++) {
+		int line = slot_lines[slot];
+		next_slot_lines[slot] = (line >= 0 && offsets[line] == line_offsets[line]) ? line : -1;
+	}
+	for (int line = 0; line < NUM_LINES; line++) {
+		next_line_slots[line] = line_slots[line];
+		if (offsets[line] == line_offsets[line]) {
+			continue;
+		}
+		leaving |= 1u << line;
+		next_line_slots[line] = -1;
+		for (int slot = 0; slot < NUM_LINES; slot++) {
+			if (next_slot_lines[slot] < 0 && request_offsets[slot] == offsets[line]) {
+				next_slot_lines[slot] = line;
+				next_line_slots[line] = slot;
+				break;
+			}
+		}
+	}
+
+	// Pins leaving the port are set to their idle level, then released or
+	// turned into inputs; the lines that did not move are not touched
+	drive_lines(leaving, IDLE_LEVELS);
+	for (int line = 0; line < NUM_LINES; line++) {
+		if ((leaving & (1u << line)) && moved_requests[line]) {
+			gpiod_line_request_release(moved_requests[line]);
+			moved_requests[line] = NULL;
+		}
+	}
+	int result = configure_request(next_slot_lines, line_levels);
+	for (int line = 0; line < NUM_LINES && result == 0; line++) {
+		if ((leaving & (1u << line)) && next_line_slots[line] < 0) {
+			moved_requests[line] = request_lines(chip, &offsets[line], 1, (line_levels >> line) & 1u);
+			if (!moved_requests[line]) {
+				result = -1;
+			}
+		}
+	}
+
+	if (result == 0) {
+		memcpy(line_offsets, offsets, sizeof(line_offsets));
+		memcpy(slot_lines, next_slot_lines, sizeof(slot_lines));
+		memcpy(line_slots, next_line_slots, sizeof(line_slots));
+	} else {
+		// Back to the previous pins, driven to the levels they had
+		for (int line = 0; line < NUM_LINES; line++) {
+			if ((leaving & (1u << line)) && moved_requests[line]) {
+				gpiod_line_request_release(moved_requests[line]);
+				moved_requests[line] = NULL;
+			}
+		}
+		configure_request(slot_lines, line_levels);
+		for (int line = 0; line < NUM_LINES; line++) {
+			if ((leaving & (1u << line)) && line_slots[line] < 0) {
+				moved_requests[line] = request_lines(chip, &line_offsets[line], 1, (line_levels >> line) & 1u);
+			}
+		}
+		drive_lines(leaving, line_levels);
+		moved = -1;
+	}
+
+	pthread_mutex_unlock(&output_lock);
+	return moved;
+}
+
+// Opens and requests a line set, driven to its idle levels.
+output_lines_t *output_lines_request(const char *chip_path, const unsigned int *offsets, int count, uint32_t idle_levels) {
+	output_lines_t *lines = calloc(1, sizeof(*lines));
+	if (lines == NULL) {
+		ERROR_PRINT("Out of memory\n");
+		return NULL;
+	}
+	memcpy(lines->offsets, offsets, (size_t)count * sizeof(*offsets));
+	lines->count = count;
+	lines->idle = lines->levels = idle_levels;
+
+	if (output_backend == OUTPUT_NULL) {
+		return lines;
+	}
+
+	lines->chip = gpiod_chip_open(chip_path);
+	if (!lines->chip) {
+		ERROR_PRINT("Unable to open GPIO chip %s\n", chip_path);
+		free(lines);
+		return NULL;
+	}
+	lines->request = request_lines(lines->chip, offsets, count, idle_levels);
+	if (!lines->request) {
+		gpiod_chip_close(lines->chip);
+		free(lines);
+		return NULL;
+	}
+	return lines;
+}
+
+// Opens and requests the lines of an additional output, driven idle.
+output_lines_t *output_lines_open(const char *chip_path, const unsigned int *offsets) {
+	return output_lines_request(chip_path, offsets, NUM_LINES, IDLE_LEVELS);
+}
+
+// Drives the lines of an additional output, changed lines in a single request.
+void output_lines_write(output_lines_t *lines, uint32_t levels) {
+	uint32_t changed = levels ^ lines->levels;
+	lines->levels = levels;
+
+	if (lines->request && changed) {
+		unsigned int offsets[NUM_LINES];
+		enum gpiod_line_value values[NUM_LINES];
+		size_t count = 0;
+
+		for (int line = 0; line < lines->count; line++) {
+			if (changed & (1u << line)) {
+				offsets[count] = lines->offsets[line];
+				values[count] = (levels & (1u << line)) ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE;
+				count++;
+			}
+		}
+		gpiod_line_request_set_values_subset(lines->request, count, offsets, values);
+	}
+}
+
+// Drives the lines of an additional output idle and releases them.
+void output_lines_close(output_lines_t *lines) {
+	if (lines == NULL) {
+		return;
+	}
+	output_lines_write(lines, lines->idle);
+	if (lines->request) {
+		gpiod_line_request_release(lines->request);
+	}
+	if (lines->chip) {
+		gpiod_chip_close(lines->chip);
+	}
+	free(lines);
+}
+
+// Returns line levels with the lines of one axis set to a quadrature phase.
+uint32_t quadrature_levels(uint32_t levels, int axis, int phase) {
+	int line_a = axis ? LINE_YA : LINE_XA;
+	int line_b = axis ? LINE_YB : LINE_XB;
+
+	return (levels & ~((1u << line_a) | (1u << line_b))) |
+		((uint32_t)quad_states[phase][0] << line_a) | ((uint32_t)quad_states[phase][1] << line_b);
+}
+
 // Cleans up and releases GPIOs.
 void cleanup_gpio() {
 	if (!gpio_initialized) return;
@@ -149,20 +673,18 @@ void cleanup_gpio() {
 	DEBUG_PRINT("Cleaning up GPIOs...\n");
 
 	// Set all quadrature lines to 0 and buttons to released (1) before cleanup
+	if (request || adopted_fd >= 0) {
+		drive_lines((1u << NUM_LINES) - 1, IDLE_LEVELS);
+	}
+	release_moved_lines();
 	if (request) {
-		enum gpiod_line_value final_values[NUM_LINES] = {
-			GPIOD_LINE_VALUE_INACTIVE,  // XA
-			GPIOD_LINE_VALUE_INACTIVE,  // XB
-			GPIOD_LINE_VALUE_INACTIVE,  // YA
-			GPIOD_LINE_VALUE_INACTIVE,  // YB
-			GPIOD_LINE_VALUE_ACTIVE,    // Left button released
-			GPIOD_LINE_VALUE_ACTIVE     // Right button released
-		};
-		
-		gpiod_line_request_set_values(request, final_values);
 		gpiod_line_request_release(request);
 		request = NULL;
 	}
+	if (adopted_fd >= 0) {
+		close(adopted_fd);
+		adopted_fd = -1;
+	}
 
 	// Close GPIO chip
 	if (chip) {
@@ -170,53 +692,186 @@ void cleanup_gpio() {
 		chip = NULL;
 	}
 
+	update_levels(IDLE_LEVELS);
 	gpio_initialized = 0;
 	DEBUG_PRINT("GPIO cleanup complete\n");
 }
 
+// Releases the GPIOs handed to another instance, leaving their levels as they are.
+void detach_gpio(void) {
+	if (!gpio_initialized) return;
+
+	// The other instance holds its own reference: the lines stay requested
+	release_moved_lines();
+	if (request) {
+		gpiod_line_request_release(request);
+		request = NULL;
+	}
+	if (adopted_fd >= 0) {
+		close(adopted_fd);
+		adopted_fd = -1;
+	}
+	if (chip) {
+		gpiod_chip_close(chip);
+		chip = NULL;
+	}
+	gpio_initialized = 0;
+}
+
 // Updates the internal X quadrature state and applies it to the GPIOs.
 void set_x_quadrature(quadrature_state_t *state, int xa, int xb) {
+	pthread_mutex_lock(&output_lock);
+	stall_enter(STAGE_OUTPUT);
 	state->xa_state = xa;
 	state->xb_state = xb;
-
-	if (request) {
-		gpiod_line_request_set_value(request, line_offsets[LINE_XA], 
-			xa ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE);
-		gpiod_line_request_set_value(request, line_offsets[LINE_XB], 
-			xb ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE);
-	}
+	update_levels((line_levels & ~((1u << LINE_XA) | (1u << LINE_XB))) |
+		((uint32_t)!!xa << LINE_XA) | ((uint32_t)!!xb << LINE_XB));
+	drive_lines((1u << LINE_XA) | (1u << LINE_XB), line_levels);
+	stall_leave(STAGE_OUTPUT);
+	pthread_mutex_unlock(&output_lock);
 }
 
 // Updates the internal Y quadrature state and applies it to the GPIOs.
 void set_y_quadrature(quadrature_state_t *state, int ya, int yb) {
+	pthread_mutex_lock(&output_lock);
+	stall_enter(STAGE_OUTPUT);
 	state->ya_state = ya;
 	state->yb_state = yb;
+	update_levels((line_levels & ~((1u << LINE_YA) | (1u << LINE_YB))) |
+		((uint32_t)!!ya << LINE_YA) | ((uint32_t)!!yb << LINE_YB));
+	drive_lines((1u << LINE_YA) | (1u << LINE_YB), line_levels);
+	stall_leave(STAGE_OUTPUT);
+	pthread_mutex_unlock(&output_lock);
+}
 
-	if (request) {
-		gpiod_line_request_set_value(request, line_offsets[LINE_YA], 
-			ya ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE);
-		gpiod_line_request_set_value(request, line_offsets[LINE_YB], 
-			yb ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE);
+// Drives some lines to new levels, changed lines in a single request.
+void output_write_levels(uint32_t levels, uint32_t mask) {
+	pthread_mutex_lock(&output_lock);
+	stall_enter(STAGE_OUTPUT);
+	levels = (line_levels & ~mask) | (levels & mask);
+	uint32_t changed = levels ^ line_levels;
+	update_levels(levels);
+
+	if (changed) {
+		drive_lines(changed, levels);
 	}
+	stall_leave(STAGE_OUTPUT);
+	pthread_mutex_unlock(&output_lock);
 }
 
-// Compute delay based on the number of pulses (adaptive speed)
-static inline int calculate_delay(int pulses) {
-	if (pulses <= SPEED_THRESHOLD) {
-		return MAX_DELAY;
+// Emits a train of steps, one slot every period_us.
+void emit_step_train(quadrature_state_t *state, const int8_t (*steps)[2], int count, int period_us, int trailing) {
+	if (count <= 0) {
+		return;
+	}
+	if (!precision_enabled()) {
+		for (int slot = 0; slot < count; slot++) {
+			if (slot > 0) {
+				edge_delay(period_us);
+			}
+			for (int axis = 0; axis < 2; axis++) {
+				if (steps[slot][axis]) {
+					quadrature_step(state, axis, steps[slot][axis]);
+				}
+			}
+		}
+		if (trailing) {
+			edge_delay(period_us);
+		}
+		return;
+	}
+
+	// Compile the train into an edge schedule, then let the emitter drive it
+	static edge_slot_t schedule[PRECISION_MAX_EDGES];
+	uint32_t levels = line_levels;
+	int edges = 0;
+
+	for (int slot = 0; slot < count; slot++) {
+		for (int axis = 0; axis < 2; axis++) {
+			if (!steps[slot][axis]) continue;
+
+			int *phase = axis ? &state->y_phase : &state->x_phase;
+			int line_a = axis ? LINE_YA : LINE_XA;
+			int line_b = axis ? LINE_YB : LINE_XB;
+
+			*phase = (*phase + (steps[slot][axis] > 0 ? 1 : 3)) % 4;
+			levels = (levels & ~((1u << line_a) | (1u << line_b))) |
+				((uint32_t)quad_states[*phase][0] << line_a) | ((uint32_t)quad_states[*phase][1] << line_b);
+		}
+
+		// Flush a full schedule and continue where it ended
+		if (edges == PRECISION_MAX_EDGES) {
+			precision_run(schedule, edges, edges * period_us);
+			edges = 0;
+		}
+		schedule[edges].offset_us = (uint32_t)(edges * period_us);
+		schedule[edges].levels = levels;
+		schedule[edges].mask = QUADRATURE_LINES;
+		edges++;
+	}
+
+	state->xa_state = quad_states[state->x_phase][0];
+	state->xb_state = quad_states[state->x_phase][1];
+	state->ya_state = quad_states[state->y_phase][0];
+	state->yb_state = quad_states[state->y_phase][1];
+	precision_run(schedule, edges, (uint32_t)((trailing ? edges : edges - 1) * period_us));
+}
+
+// Moves one axis a single quadrature step forward or backward.
+void quadrature_step(quadrature_state_t *state, int axis, int direction) {
+	// Quadrature X runs opposite to the IKBD X count
+	if (output_backend == OUTPUT_IKBD) {
+		ikbd_serial_add(axis, axis ? direction : -direction);
+		return;
+	}
+
+	if (axis == 0) {
+		state->x_phase = (state->x_phase + (direction > 0 ? 1 : 3)) % 4;
+		set_x_quadrature(state, quad_states[state->x_phase][0], quad_states[state->x_phase][1]);
+	} else {
+		state->y_phase = (state->y_phase + (direction > 0 ? 1 : 3)) % 4;
+		set_y_quadrature(state, quad_states[state->y_phase][0], quad_states[state->y_phase][1]);
+	}
+}
+
+// Computes the delay between transitions based on the number of pulses (adaptive speed).
+int calculate_delay(int pulses) {
+	return curve_period_us(active_curve(), pulses);
+}
+
+// Generates a pulse train on one axis through the precision emitter.
+static void generate_precise_pulses(quadrature_state_t *state, int axis, int direction, int pulses, int delay) {
+	int8_t steps[PRECISION_MAX_EDGES][2];
+
+	while (pulses > 0) {
+		int count = (pulses < PRECISION_MAX_EDGES) ? pulses : PRECISION_MAX_EDGES;
+		for (int i = 0; i < count; i++) {
+			steps[i][axis] = (int8_t)direction;
+			steps[i][!axis] = 0;
+		}
+		emit_step_train(state, (const int8_t (*)[2])steps, count, delay, 1);
+		pulses -= count;
 	}
-	int delay = MAX_DELAY - ((pulses - SPEED_THRESHOLD) * (MAX_DELAY - MIN_DELAY) / 10);
-	return (delay < MIN_DELAY) ? MIN_DELAY : delay;
 }
 
 // Generates quadrature pulses along the X axis.
 void generate_x_pulses(quadrature_state_t *state, int delta) {
+	if (output_backend == OUTPUT_IKBD) {
+		ikbd_serial_add(0, -delta);
+		return;
+	}
+
 	int direction = (delta > 0) ? 1 : -1;
 	int pulses = abs(delta);
 	
 	// Calculate adaptive delay based on movement speed
 	int delay = calculate_delay(pulses);
 
+	if (precision_enabled()) {
+		generate_precise_pulses(state, 0, direction, pulses, delay);
+		return;
+	}
+
 	for (int i = 0; i < pulses; i++) {
 		if (direction > 0) {
 			state->x_phase = (state->x_phase + 1) % 4;
@@ -230,18 +885,28 @@ void generate_x_pulses(quadrature_state_t *state, int delta) {
 
 		DEBUG_PRINT("direction: %d,X phase: %d, pulses: %d, delay: %d\n", direction, state->x_phase, pulses, delay);
 
-		usleep(delay);
+		edge_delay(delay);
 	}
 }
 
 // Generates quadrature pulses along the Y axis.
 void generate_y_pulses(quadrature_state_t *state, int delta) {
+	if (output_backend == OUTPUT_IKBD) {
+		ikbd_serial_add(1, delta);
+		return;
+	}
+
 	int direction = (delta > 0) ? 1 : -1;
 	int pulses = abs(delta);
 	
 	// Calculate adaptive delay based on movement speed
 	int delay = calculate_delay(pulses);
 
+	if (precision_enabled()) {
+		generate_precise_pulses(state, 1, direction, pulses, delay);
+		return;
+	}
+
 	for (int i = 0; i < pulses; i++) {
 		if (direction > 0) {
 			state->y_phase = (state->y_phase + 1) % 4;
@@ -255,24 +920,36 @@ void generate_y_pulses(quadrature_state_t *state, int delta) {
 
 		DEBUG_PRINT("direction: %d,Y phase: %d, pulses: %d, delay: %d\n", direction, state->y_phase, pulses, delay);
 
-		usleep(delay);
+		edge_delay(delay);
 	}
 }
 
 // Sets the left button state (0 = pressed, 1 = released)
 void set_left_button(int pressed) {
-	if (request) {
-		enum gpiod_line_value value = pressed ? GPIOD_LINE_VALUE_INACTIVE : GPIOD_LINE_VALUE_ACTIVE;
-		int result = gpiod_line_request_set_value(request, line_offsets[LINE_LEFT_BUTTON], value);
-		DEBUG_PRINT("Left button: pressed=%d, gpio_value=%d, result=%d\n", pressed, value, result);
+	pthread_mutex_lock(&output_lock);
+	stall_enter(STAGE_OUTPUT);
+	update_levels(pressed ? line_levels & ~(1u << LINE_LEFT_BUTTON) : line_levels | (1u << LINE_LEFT_BUTTON));
+	if (request || adopted_fd >= 0) {
+		int result = drive_lines(1u << LINE_LEFT_BUTTON, line_levels);
+		DEBUG_PRINT("Left button: pressed=%d, gpio_value=%d, result=%d\n", pressed, !pressed, result);
+	} else if (output_backend == OUTPUT_IKBD) {
+		ikbd_serial_button(IKBD_HEADER_LEFT, pressed);
 	}
+	stall_leave(STAGE_OUTPUT);
+	pthread_mutex_unlock(&output_lock);
 }
 
 // Sets the right button state (0 = pressed, 1 = released)
 void set_right_button(int pressed) {
-	if (request) {
-		enum gpiod_line_value value = pressed ? GPIOD_LINE_VALUE_INACTIVE : GPIOD_LINE_VALUE_ACTIVE;
-		int result = gpiod_line_request_set_value(request, line_offsets[LINE_RIGHT_BUTTON], value);
-		DEBUG_PRINT("Right button: pressed=%d, gpio_value=%d, result=%d\n", pressed, value, result);
+	pthread_mutex_lock(&output_lock);
+	stall_enter(STAGE_OUTPUT);
+	update_levels(pressed ? line_levels & ~(1u << LINE_RIGHT_BUTTON) : line_levels | (1u << LINE_RIGHT_BUTTON));
+	if (request || adopted_fd >= 0) {
+		int result = drive_lines(1u << LINE_RIGHT_BUTTON, line_levels);
+		DEBUG_PRINT("Right button: pressed=%d, gpio_value=%d, result=%d\n", pressed, !pressed, result);
+	} else if (output_backend == OUTPUT_IKBD) {
+		ikbd_serial_button(IKBD_HEADER_RIGHT, pressed);
 	}
+	stall_leave(STAGE_OUTPUT);
+	pthread_mutex_unlock(&output_lock);
 }
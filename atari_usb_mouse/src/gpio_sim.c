@@ -0,0 +1,433 @@
+/**
+ * @file gpio_sim.c
+ * @brief End-to-end harness running the daemon against a gpio-sim chip.
+ *
+ * The kernel gpio-sim module exposes, for every simulated line, the value
+ * driven by its consumer in sysfs. The harness starts this binary on such a
+ * chip with a uinput mouse as input, samples the simulated lines while it
+ * injects a known motion script, and decodes the quadrature signals back.
+ *
+ * The daemon under test gets a generated configuration, not the installed
+ * one: a gain, filter or profile there would change the step count, and
+ * another pacing or curve the edge spacing the checks expect.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <linux/input.h>
+
+#include "gpio_sim.h"
+#include "gpio_control.h"
+#include "curve.h"
+#include "replay.h"
+#include "global.h"
+
+
+#define GPIO_SIM_CONFIGFS "/sys/kernel/config/gpio-sim"
+#define GPIO_SIM_DIR GPIO_SIM_CONFIGFS "/atari_usb_mouse_check"
+#define GPIO_SIM_BANK GPIO_SIM_DIR "/bank0"
+
+// Interval between two injected input frames (in microseconds)
+#define FRAME_INTERVAL_US 20000
+
+// Maximum number of line transitions kept by the sampler
+#define MAX_SAMPLES 16384
+
+// Edge spacing allowed below the curve minimum (in microseconds): an edge is
+// timestamped when a sampler pass over the six sysfs files sees it, so the
+// gap between two edges can look shorter by up to a pass and a preemption
+#define SPACING_TOLERANCE_US 100
+
+// Configuration of the daemon under test: one step per count, steps in bursts at the linear curve periods
+static const char check_config[] =
+	"{\n"
+	"  \"sensitivity\": 1,\n"
+	"  \"pacing\": \"burst\",\n"
+	"  \"precision\": { \"enabled\": false },\n"
+	"  \"calibration\": { \"at_startup\": false }\n"
+	"}\n";
+
+
+/**
+ * One segment of the injected motion script.
+ */
+typedef struct {
+	int dx;		// REL_X value of every frame
+	int dy;		// REL_Y value of every frame
+	int frames;	// Number of frames
+} motion_segment_t;
+
+/**
+ * Line levels observed by the sampler after a transition.
+ */
+typedef struct {
+	uint64_t time_ns;
+	uint8_t levels;	// Bit n = simulated line n
+} line_sample_t;
+
+/**
+ * Quadrature decoding results for one axis.
+ */
+typedef struct {
+	long forward;		// Legal steps in the forward direction
+	long backward;		// Legal steps in the backward direction
+	long illegal;		// Transitions changing both lines at once
+	uint64_t min_spacing_ns;	// Shortest time between two transitions
+} axis_decode_t;
+
+// Motion injected into the virtual mouse; slow enough to never coalesce
+static const motion_segment_t motion_script[] = {
+	{  2,  0, 40 },
+	{ -3,  0, 40 },
+	{  0,  2, 40 },
+	{  0, -3, 40 },
+	{  4,  4, 25 },
+	{ -4, -4, 25 },
+	{  1, -1, 50 }
+};
+
+// Quadrature phase for line levels (A << 1 | B), matching the generator table
+static const int phase_of_levels[4] = { 0, 1, 3, 2 };
+
+static line_sample_t samples[MAX_SAMPLES];
+
+
+// Reads CLOCK_MONOTONIC in nanoseconds.
+static uint64_t monotonic_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Writes a string to a configfs attribute.
+static int write_attr(const char *path, const char *value) {
+	int fd = open(path, O_WRONLY);
+	if (fd < 0) {
+		ERROR_PRINT("Cannot open %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	ssize_t len = (ssize_t)strlen(value);
+	int ret = (write(fd, value, len) == len) ? 0 : -1;
+	if (ret < 0) {
+		ERROR_PRINT("Cannot write %s: %s\n", path, strerror(errno));
+	}
+	close(fd);
+	return ret;
+}
+
+// Reads a single-line attribute, without its trailing newline.
+static int read_attr(const char *path, char *buffer, size_t size) {
+	FILE *fp = fopen(path, "r");
+	if (fp == NULL || fgets(buffer, (int)size, fp) == NULL) {
+		if (fp) fclose(fp);
+		return -1;
+	}
+	fclose(fp);
+	buffer[strcspn(buffer, "\n")] = '\0';
+	return 0;
+}
+
+// Removes the simulated chip from configfs.
+static void destroy_sim_chip(void) {
+	write_attr(GPIO_SIM_DIR "/live", "0");
+	rmdir(GPIO_SIM_BANK);
+	rmdir(GPIO_SIM_DIR);
+}
+
+// Creates a simulated chip and returns its device and sysfs line directory.
+static int create_sim_chip(char *chip_dev, size_t dev_size, char *line_dir, size_t dir_size) {
+	char chip_name[32], dev_name[32];
+
+	// Leftover from an interrupted run
+	destroy_sim_chip();
+
+	if (mkdir(GPIO_SIM_DIR, 0755) < 0 || mkdir(GPIO_SIM_BANK, 0755) < 0) {
+		ERROR_PRINT("Cannot create gpio-sim chip: %s\n", strerror(errno));
+		return -1;
+	}
+	if (write_attr(GPIO_SIM_BANK "/num_lines", "8") < 0 ||
+		write_attr(GPIO_SIM_DIR "/live", "1") < 0 ||
+		read_attr(GPIO_SIM_BANK "/chip_name", chip_name, sizeof(chip_name)) < 0 ||
+		read_attr(GPIO_SIM_DIR "/dev_name", dev_name, sizeof(dev_name)) < 0) {
+		destroy_sim_chip();
+		return -1;
+	}
+
+	snprintf(chip_dev, dev_size, "/dev/%s", chip_name);
+	snprintf(line_dir, dir_size, "/sys/devices/platform/%s/%s", dev_name, chip_name);
+	return 0;
+}
+
+// Writes the configuration of the daemon under test to a temporary file.
+static int write_check_config(char *path, size_t size) {
+	snprintf(path, size, "/tmp/atari_usb_mouse_check.XXXXXX");
+	int fd = mkstemp(path);
+	if (fd < 0) {
+		ERROR_PRINT("Cannot create check configuration: %s\n", strerror(errno));
+		return -1;
+	}
+
+	ssize_t length = (ssize_t)strlen(check_config);
+	int ok = (write(fd, check_config, (size_t)length) == length);
+	if (close(fd) < 0 || !ok) {
+		ERROR_PRINT("Cannot write check configuration %s\n", path);
+		unlink(path);
+		return -1;
+	}
+	return 0;
+}
+
+// Starts this binary on the simulated chip, reading the virtual mouse.
+static pid_t start_daemon(const char *config_path, const char *event_path, const char *chip_dev) {
+	char self[512];
+
+	ssize_t len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+	if (len < 0) {
+		ERROR_PRINT("Cannot locate own binary: %s\n", strerror(errno));
+		return -1;
+	}
+	self[len] = '\0';
+
+	pid_t pid = fork();
+	if (pid == 0) {
+		execl(self, self, "-c", config_path, "-D", event_path, "--gpio-chip", chip_dev,
+			"--pin-xa", "0", "--pin-xb", "1", "--pin-ya", "2", "--pin-yb", "3",
+			"--pin-left", "4", "--pin-right", "5", (char *)NULL);
+		_exit(127);
+	}
+	if (pid < 0) {
+		ERROR_PRINT("Cannot start daemon under test: %s\n", strerror(errno));
+	}
+	return pid;
+}
+
+// Reads the levels of the six simulated lines.
+static int sample_levels(const int *fds) {
+	int levels = 0;
+	char value;
+
+	for (int line = 0; line < NUM_LINES; line++) {
+		if (pread(fds[line], &value, 1, 0) == 1 && value == '1') {
+			levels |= 1 << line;
+		}
+	}
+	return levels;
+}
+
+// Writes one event to the virtual mouse.
+static void inject(int fd, int type, int code, int value) {
+	struct input_event ie;
+
+	memset(&ie, 0, sizeof(ie));
+	ie.type = type;
+	ie.code = code;
+	ie.value = value;
+	if (write(fd, &ie, sizeof(ie)) != sizeof(ie)) {
+		DEBUG_PRINT("uinput write failed: %s\n", strerror(errno));
+	}
+}
+
+// Decodes the quadrature transitions of one axis from the sampled levels.
+static void decode_axis(const line_sample_t *s, size_t count, int line_a, axis_decode_t *out) {
+	int prev = -1;
+	uint64_t last_edge = 0;
+
+	memset(out, 0, sizeof(*out));
+	out->min_spacing_ns = UINT64_MAX;
+
+	for (size_t i = 0; i < count; i++) {
+		int phase = phase_of_levels[(s[i].levels >> line_a) & 3];
+		if (prev < 0) {
+			prev = phase;
+			continue;
+		}
+		if (phase == prev) continue;
+
+		switch ((phase - prev + 4) % 4) {
+			case 1: out->forward++; break;
+			case 3: out->backward++; break;
+			default: out->illegal++; break;
+		}
+		if (last_edge && s[i].time_ns - last_edge < out->min_spacing_ns) {
+			out->min_spacing_ns = s[i].time_ns - last_edge;
+		}
+		last_edge = s[i].time_ns;
+		prev = phase;
+	}
+}
+
+// Compares one decoded axis with the injected motion.
+static int check_axis(const char *name, const axis_decode_t *d, long expected_net, long expected_steps, uint64_t min_spacing_ns) {
+	int ok = 1;
+
+	INFO_PRINT("%s axis: %ld forward, %ld backward, %ld illegal, min spacing %llu us "
+		"(expected net %+ld over %ld steps)\n", name, d->forward, d->backward, d->illegal,
+		(unsigned long long)(d->min_spacing_ns == UINT64_MAX ? 0 : d->min_spacing_ns / 1000),
+		expected_net, expected_steps);
+
+	if (d->forward - d->backward != expected_net) {
+		ERROR_PRINT("%s axis: count mismatch\n", name);
+		ok = 0;
+	}
+	if (d->forward + d->backward != expected_steps) {
+		ERROR_PRINT("%s axis: lost or extra steps\n", name);
+		ok = 0;
+	}
+	if (d->illegal != 0) {
+		ERROR_PRINT("%s axis: Gray-code violations\n", name);
+		ok = 0;
+	}
+	if (d->min_spacing_ns != UINT64_MAX && d->min_spacing_ns < min_spacing_ns) {
+		ERROR_PRINT("%s axis: edges closer than %llu us\n", name, (unsigned long long)(min_spacing_ns / 1000));
+		ok = 0;
+	}
+	return ok;
+}
+
+// Runs the daemon end to end against a gpio-sim chip and a uinput mouse.
+int run_gpio_sim_check(void) {
+	char chip_dev[64], line_dir[160], event_path[64], path[256], config_path[64];
+	int line_fds[NUM_LINES];
+	long expected_x = 0, expected_y = 0, steps_x = 0, steps_y = 0;
+	int presses = 0;
+	size_t count = 0;
+	int result = 1;
+
+	if (access(GPIO_SIM_CONFIGFS, F_OK) != 0) {
+		INFO_PRINT("gpio-sim is not available (modprobe gpio-sim), check skipped\n");
+		return GPIO_SIM_SKIPPED;
+	}
+	if (write_check_config(config_path, sizeof(config_path)) < 0) {
+		return 1;
+	}
+	if (create_sim_chip(chip_dev, sizeof(chip_dev), line_dir, sizeof(line_dir)) < 0) {
+		unlink(config_path);
+		return GPIO_SIM_SKIPPED;
+	}
+
+	int uinput_fd = create_uinput_mouse("Atari USB mouse gpio-sim check", event_path, sizeof(event_path));
+	if (uinput_fd < 0 || event_path[0] == '\0') {
+		destroy_uinput_mouse(uinput_fd);
+		destroy_sim_chip();
+		unlink(config_path);
+		return GPIO_SIM_SKIPPED;
+	}
+
+	for (int line = 0; line < NUM_LINES; line++) {
+		snprintf(path, sizeof(path), "%s/sim_gpio%d/value", line_dir, line);
+		line_fds[line] = open(path, O_RDONLY);
+	}
+
+	INFO_PRINT("Simulated chip %s, virtual mouse %s\n", chip_dev, event_path);
+	pid_t daemon_pid = start_daemon(config_path, event_path, chip_dev);
+	if (daemon_pid < 0) {
+		goto out;
+	}
+
+	// The daemon is live once it drives the released button levels
+	uint64_t deadline = monotonic_ns() + 5000000000ULL;
+	while ((sample_levels(line_fds) & (1 << LINE_LEFT_BUTTON)) == 0) {
+		if (monotonic_ns() > deadline || waitpid(daemon_pid, NULL, WNOHANG) != 0) {
+			ERROR_PRINT("Daemon under test did not request the simulated lines\n");
+			goto stop;
+		}
+		usleep(10000);
+	}
+	usleep(200000);
+
+	// Inject the script while sampling the lines as fast as possible
+	size_t segment = 0;
+	int frame = 0;
+	int prev_levels = -1;
+	uint64_t next_frame = monotonic_ns();
+	uint64_t end_time = 0;
+
+	inject(uinput_fd, EV_KEY, BTN_LEFT, 1);
+	inject(uinput_fd, EV_SYN, SYN_REPORT, 0);
+
+	while (running && (end_time == 0 || monotonic_ns() < end_time)) {
+		uint64_t now = monotonic_ns();
+
+		if (end_time == 0 && now >= next_frame) {
+			if (segment == sizeof(motion_script) / sizeof(motion_script[0])) {
+				inject(uinput_fd, EV_KEY, BTN_LEFT, 0);
+				inject(uinput_fd, EV_SYN, SYN_REPORT, 0);
+				end_time = now + 200000000ULL;	// Let the last pulse train finish
+			} else {
+				const motion_segment_t *m = &motion_script[segment];
+				if (m->dx) inject(uinput_fd, EV_REL, REL_X, m->dx);
+				if (m->dy) inject(uinput_fd, EV_REL, REL_Y, m->dy);
+				inject(uinput_fd, EV_SYN, SYN_REPORT, 0);
+
+				// The daemon inverts X: a positive REL_X steps the phase backward
+				expected_x -= m->dx;
+				expected_y += m->dy;
+				steps_x += abs(m->dx);
+				steps_y += abs(m->dy);
+
+				if (++frame == m->frames) {
+					frame = 0;
+					segment++;
+				}
+				next_frame += FRAME_INTERVAL_US * 1000ULL;
+			}
+		}
+
+		int levels = sample_levels(line_fds);
+		if (levels != prev_levels && count < MAX_SAMPLES) {
+			samples[count].time_ns = now;
+			samples[count].levels = (uint8_t)levels;
+			count++;
+			if (prev_levels >= 0 && (prev_levels & (1 << LINE_LEFT_BUTTON)) && !(levels & (1 << LINE_LEFT_BUTTON))) {
+				presses++;
+			}
+			prev_levels = levels;
+		}
+	}
+
+	// Decode and compare with the injected motion, edges no closer than the curve allows
+	static curve_t linear;
+	axis_decode_t x, y;
+	curve_init_default(&linear, DEFAULT_CURVE_NAME);
+	uint64_t min_spacing_ns = (uint64_t)(linear.min_period_us - SPACING_TOLERANCE_US) * 1000ULL;
+
+	decode_axis(samples, count, LINE_XA, &x);
+	decode_axis(samples, count, LINE_YA, &y);
+	int ok = check_axis("X", &x, expected_x, steps_x, min_spacing_ns);
+	ok &= check_axis("Y", &y, expected_y, steps_y, min_spacing_ns);
+
+	INFO_PRINT("Left button: %d press(es), expected 1\n", presses);
+	if (presses != 1) {
+		ERROR_PRINT("Left button transitions do not match\n");
+		ok = 0;
+	}
+	if (count == MAX_SAMPLES) {
+		ERROR_PRINT("Sample buffer full, results incomplete\n");
+		ok = 0;
+	}
+
+	INFO_PRINT("gpio-sim check %s\n", ok ? "PASSED" : "FAILED");
+	result = ok ? 0 : 1;
+
+stop:
+	kill(daemon_pid, SIGTERM);
+	waitpid(daemon_pid, NULL, 0);
+out:
+	for (int line = 0; line < NUM_LINES; line++) {
+		if (line_fds[line] >= 0) close(line_fds[line]);
+	}
+	destroy_uinput_mouse(uinput_fd);
+	destroy_sim_chip();
+	unlink(config_path);
+	return result;
+}
\ No newline at end of file
@@ -0,0 +1,255 @@
+/**
+ * @file handoff.c
+ * @brief Hands the input device and GPIO lines to a restarted instance.
+ *
+ * A restart used to stop the daemon, which drove the lines idle, and start
+ * a new one seconds later. Instead, the new instance asks the running one
+ * for its descriptors: they are passed over a Unix socket with SCM_RIGHTS,
+ * so the kernel keeps the line request (and its levels) and the pending
+ * input events alive while the output changes hands.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "handoff.h"
+#include "daemon.h"
+#include "global.h"
+
+
+// Reads CLOCK_MONOTONIC in nanoseconds.
+static uint64_t monotonic_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Builds the address of the hand-off socket, next to the PID file.
+static int handoff_address(struct sockaddr_un *addr) {
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	int len = snprintf(addr->sun_path, sizeof(addr->sun_path), "%s.handoff", pidfile_path);
+	if (len < 0 || (size_t)len >= sizeof(addr->sun_path)) {
+		ERROR_PRINT("Hand-off socket path too long: %s.handoff\n", pidfile_path);
+		return -1;
+	}
+	return 0;
+}
+
+// Bounds the time a socket waits for a reply.
+static void set_timeout(int fd) {
+	struct timeval tv = { HANDOFF_TIMEOUT_MS / 1000, (HANDOFF_TIMEOUT_MS % 1000) * 1000 };
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+}
+
+// Tells whether a connection comes from the instance asked to hand over.
+static int trusted_peer(int conn, pid_t pid) {
+	struct ucred cred;
+	socklen_t len = sizeof(cred);
+
+	if (getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0) {
+		ERROR_PRINT("Cannot identify hand-off peer: %s\n", strerror(errno));
+		return 0;
+	}
+	if (cred.pid != pid || (cred.uid != 0 && cred.uid != geteuid())) {
+		ERROR_PRINT("Hand-off from PID %d (UID %d) refused, waiting for PID %d\n", (int)cred.pid, (int)cred.uid, (int)pid);
+		return 0;
+	}
+	return 1;
+}
+
+// Reads the state and descriptors sent by the running instance.
+static int receive_state(int conn, handoff_state_t *state, int *input_fd, int *line_fd) {
+	union {
+		char buffer[CMSG_SPACE(2 * sizeof(int))];
+		struct cmsghdr align;
+	} control;
+	struct iovec iov = { state, sizeof(*state) };
+	struct msghdr msg = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = control.buffer,
+		.msg_controllen = sizeof(control.buffer)
+	};
+	int fds[2] = { -1, -1 };
+	int nfds = 0;
+
+	ssize_t bytes = recvmsg(conn, &msg, MSG_CMSG_CLOEXEC);
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	if (cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+		nfds = (int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+		if (nfds > 2) {
+			nfds = 2;
+		}
+		memcpy(fds, CMSG_DATA(cmsg), (size_t)nfds * sizeof(int));
+	}
+
+	if (bytes != (ssize_t)sizeof(*state) || nfds < 1 || (msg.msg_flags & MSG_CTRUNC)
+			|| memcmp(state->magic, HANDOFF_MAGIC, sizeof(state->magic)) != 0) {
+		ERROR_PRINT("Invalid hand-off message\n");
+		for (int i = 0; i < nfds; i++) {
+			close(fds[i]);
+		}
+		return -1;
+	}
+
+	state->device_path[sizeof(state->device_path) - 1] = '\0';
+	*input_fd = fds[0];
+	*line_fd = (nfds == 2) ? fds[1] : -1;
+	return 0;
+}
+
+// Asks a running instance for its descriptors and output state.
+int handoff_receive(pid_t pid, handoff_state_t *state, int *input_fd, int *line_fd) {
+	struct sockaddr_un addr;
+	int result = -1;
+
+	if (handoff_address(&addr) < 0) {
+		return -1;
+	}
+
+	int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (listen_fd < 0) {
+		ERROR_PRINT("Cannot create hand-off socket: %s\n", strerror(errno));
+		return -1;
+	}
+
+	// A socket left by an interrupted restart would make bind() fail
+	unlink(addr.sun_path);
+
+	// The daemon runs with umask 0: restrict the file before anyone can connect
+	if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || chmod(addr.sun_path, HANDOFF_SOCKET_MODE) < 0
+			|| listen(listen_fd, 1) < 0) {
+		ERROR_PRINT("Cannot listen on hand-off socket %s: %s\n", addr.sun_path, strerror(errno));
+		close(listen_fd);
+		return -1;
+	}
+
+	if (kill(pid, SIGUSR2) < 0) {
+		ERROR_PRINT("Cannot signal PID %d: %s\n", pid, strerror(errno));
+		goto out;
+	}
+
+	// The running instance hands over between two input frames
+	uint64_t deadline = monotonic_ns() + HANDOFF_TIMEOUT_MS * 1000000ULL;
+	int conn = -1;
+	while (conn < 0) {
+		uint64_t now = monotonic_ns();
+		struct pollfd pfd = { .fd = listen_fd, .events = POLLIN };
+		int ready = (now < deadline) ? poll(&pfd, 1, (int)((deadline - now) / 1000000ULL)) : 0;
+		if (ready < 0 && errno == EINTR && running) {
+			continue;
+		}
+		if (ready <= 0) {
+			INFO_PRINT("PID %d did not hand over its descriptors\n", pid);
+			goto out;
+		}
+
+		conn = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+		if (conn < 0) {
+			ERROR_PRINT("Cannot accept hand-off: %s\n", strerror(errno));
+			goto out;
+		}
+		if (!trusted_peer(conn, pid)) {
+			close(conn);
+			conn = -1;
+		}
+	}
+	set_timeout(conn);
+	if (receive_state(conn, state, input_fd, line_fd) == 0) {
+		// The sender lets go of the lines only once acknowledged
+		char ack = 'A';
+		if (send(conn, &ack, 1, MSG_NOSIGNAL) == 1) {
+			result = 0;
+		} else {
+			close(*input_fd);
+			if (*line_fd >= 0) {
+				close(*line_fd);
+			}
+		}
+	}
+	close(conn);
+
+out:
+	close(listen_fd);
+	unlink(addr.sun_path);
+	return result;
+}
+
+// Hands the input device, the line request and the output state over.
+int handoff_send(int input_fd, const char *device_path, const quadrature_state_t *quad, const calibration_t *cal) {
+	struct sockaddr_un addr;
+	handoff_state_t state;
+	union {
+		char buffer[CMSG_SPACE(2 * sizeof(int))];
+		struct cmsghdr align;
+	} control;
+	int fds[2] = { input_fd, gpio_line_fd() };
+	int nfds = (fds[1] >= 0) ? 2 : 1;
+
+	// Lines moved to other pins are no longer in the request order the next instance expects
+	if (output_backend == OUTPUT_GPIO && fds[1] < 0) {
+		ERROR_PRINT("GPIO pins changed since start, cannot hand the lines over\n");
+		return -1;
+	}
+	if (handoff_address(&addr) < 0) {
+		return -1;
+	}
+
+	int conn = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (conn < 0) {
+		ERROR_PRINT("Cannot create hand-off socket: %s\n", strerror(errno));
+		return -1;
+	}
+	if (connect(conn, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		ERROR_PRINT("Cannot connect to hand-off socket %s: %s\n", addr.sun_path, strerror(errno));
+		close(conn);
+		return -1;
+	}
+	set_timeout(conn);
+
+	memset(&state, 0, sizeof(state));
+	memcpy(state.magic, HANDOFF_MAGIC, sizeof(state.magic));
+	state.quad = *quad;
+	gpio_get_lines(state.line_offsets, &state.line_levels);
+	snprintf(state.device_path, sizeof(state.device_path), "%s", device_path);
+	if (cal != NULL) {
+		state.calibrated = 1;
+		state.calibration = *cal;
+	}
+	state.sent_ns = monotonic_ns();
+
+	struct iovec iov = { &state, sizeof(state) };
+	struct msghdr msg = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = control.buffer,
+		.msg_controllen = CMSG_SPACE((size_t)nfds * sizeof(int))
+	};
+	memset(&control, 0, sizeof(control));
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN((size_t)nfds * sizeof(int));
+	memcpy(CMSG_DATA(cmsg), fds, (size_t)nfds * sizeof(int));
+
+	char ack = 0;
+	if (sendmsg(conn, &msg, MSG_NOSIGNAL) != (ssize_t)sizeof(state) || recv(conn, &ack, 1, 0) != 1 || ack != 'A') {
+		ERROR_PRINT("Hand-off not acknowledged, keeping the output\n");
+		close(conn);
+		return -1;
+	}
+
+	close(conn);
+	return 0;
+}
@@ -0,0 +1,189 @@
+/**
+ * @file ikbd_model.c
+ * @brief Software model of the Atari ST keyboard processor sampling the mouse.
+ *
+ * The IKBD (an HD6301 microcontroller) does not see edges: it reads the
+ * XA/XB/YA/YB levels at its own polling rate and derives counts from the
+ * change between two reads. This model replays an edge trace through the
+ * same sampling process, so timing parameters can be judged by the counts
+ * the ST would actually register rather than by what was driven.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+
+#include "ikbd_model.h"
+#include "gpio_control.h"
+#include "global.h"
+
+
+// Quadrature phase for line levels (A << 1 | B), matching the generator table
+static const int phase_of_levels[4] = { 0, 1, 3, 2 };
+
+
+// Returns the quadrature phase of one axis from a line mask.
+static inline int axis_phase(uint32_t lines, int axis) {
+	int a = (lines >> (axis ? LINE_YA : LINE_XA)) & 1;
+	int b = (lines >> (axis ? LINE_YB : LINE_XB)) & 1;
+	return phase_of_levels[(a << 1) | b];
+}
+
+// Loads an edge trace into memory.
+static edge_record_t *load_trace(const char *path, size_t *count) {
+	char magic[8];
+	edge_record_t *records = NULL;
+	size_t capacity = 0;
+
+	*count = 0;
+	FILE *fp = fopen(path, "rb");
+	if (fp == NULL) {
+		ERROR_PRINT("Cannot open edge trace %s: %s\n", path, strerror(errno));
+		return NULL;
+	}
+	if (fread(magic, 1, sizeof(magic), fp) != sizeof(magic) || memcmp(magic, EDGE_TRACE_MAGIC, sizeof(magic)) != 0) {
+		ERROR_PRINT("%s is not an edge trace\n", path);
+		fclose(fp);
+		return NULL;
+	}
+
+	for (;;) {
+		if (*count == capacity) {
+			capacity = capacity ? capacity * 2 : 4096;
+			edge_record_t *grown = realloc(records, capacity * sizeof(*records));
+			if (grown == NULL) {
+				ERROR_PRINT("Memory allocation error while reading %s\n", path);
+				free(records);
+				fclose(fp);
+				return NULL;
+			}
+			records = grown;
+		}
+		if (fread(&records[*count], sizeof(*records), 1, fp) != 1) break;
+		(*count)++;
+	}
+
+	fclose(fp);
+	if (*count == 0) {
+		ERROR_PRINT("Edge trace %s is empty\n", path);
+		free(records);
+		return NULL;
+	}
+	return records;
+}
+
+// Decodes every driven transition of one axis.
+static void decode_driven(const edge_record_t *rec, size_t count, int axis, unsigned int sample_us, ikbd_axis_result_t *r) {
+	int prev = axis_phase(rec[0].lines, axis);
+	uint64_t last_edge = 0;
+
+	for (size_t i = 1; i < count; i++) {
+		int phase = axis_phase(rec[i].lines, axis);
+		if (phase == prev) continue;
+
+		switch ((phase - prev + 4) % 4) {
+			case 1: r->driven_net++; r->transitions++; break;
+			case 3: r->driven_net--; r->transitions++; break;
+			default: r->transitions += 2; break;	// Both lines at once: no direction
+		}
+		if (last_edge && rec[i].time_ns - last_edge < (uint64_t)sample_us * 1000ULL) {
+			r->close_edges++;
+		}
+		last_edge = rec[i].time_ns;
+		prev = phase;
+	}
+}
+
+// Runs the IKBD sampling model over an edge trace.
+int ikbd_model_run(const char *trace_path, const ikbd_params_t *params, ikbd_axis_result_t result[2]) {
+	size_t count;
+	edge_record_t *rec = load_trace(trace_path, &count);
+	if (rec == NULL) {
+		return -1;
+	}
+
+	memset(result, 0, 2 * sizeof(*result));
+	for (int axis = 0; axis < 2; axis++) {
+		decode_driven(rec, count, axis, params->sample_us, &result[axis]);
+	}
+
+	// Sample the lines like the IKBD polling loop, from the first to past the last edge
+	uint64_t period_ns = (uint64_t)(params->sample_us ? params->sample_us : 1) * 1000ULL;
+	uint64_t end = rec[count - 1].time_ns + period_ns;
+	uint32_t seed = 1;
+	long legal[2] = { 0, 0 };
+	int sampled[2] = { axis_phase(rec[0].lines, 0), axis_phase(rec[0].lines, 1) };
+	size_t idx = 0;
+
+	for (uint64_t t = rec[0].time_ns; t <= end; t += period_ns) {
+		uint64_t sample_time = t;
+		if (params->jitter_us) {
+			seed = seed * 1103515245u + 12345u;	// Deterministic jitter
+			sample_time += (uint64_t)((seed >> 16) % (params->jitter_us + 1)) * 1000ULL;
+		}
+		while (idx + 1 < count && rec[idx + 1].time_ns <= sample_time) {
+			idx++;
+		}
+
+		for (int axis = 0; axis < 2; axis++) {
+			int phase = axis_phase(rec[idx].lines, axis);
+			switch ((phase - sampled[axis] + 4) % 4) {
+				case 0: break;
+				case 1: result[axis].registered_net++; legal[axis]++; break;
+				case 3: result[axis].registered_net--; legal[axis]++; break;
+				default: result[axis].misread++; break;
+			}
+			sampled[axis] = phase;
+		}
+
+		// Skip idle stretches: samples taken before the next edge register nothing
+		if (idx + 1 < count) {
+			uint64_t quiet_until = rec[idx + 1].time_ns - (uint64_t)params->jitter_us * 1000ULL;
+			if (rec[idx + 1].time_ns > (uint64_t)params->jitter_us * 1000ULL && quiet_until > t + period_ns) {
+				t += ((quiet_until - t) / period_ns - 1) * period_ns;
+			}
+		}
+	}
+
+	for (int axis = 0; axis < 2; axis++) {
+		result[axis].missed = result[axis].transitions - legal[axis] - 2 * result[axis].misread;
+		if (result[axis].missed < 0) {
+			result[axis].missed = 0;
+		}
+	}
+
+	free(rec);
+	return 0;
+}
+
+// Runs the model over an edge trace and prints the report.
+int run_ikbd_model(const char *trace_path, const ikbd_params_t *params) {
+	ikbd_axis_result_t result[2];
+	static const char *axis_names[2] = { "X", "Y" };
+	long total_error = 0;
+
+	if (ikbd_model_run(trace_path, params, result) < 0) {
+		return -1;
+	}
+
+	INFO_PRINT("IKBD model: sample interval %u us, jitter %u us\n", params->sample_us, params->jitter_us);
+	for (int axis = 0; axis < 2; axis++) {
+		const ikbd_axis_result_t *r = &result[axis];
+		long error = r->driven_net - r->registered_net;
+
+		INFO_PRINT("%s axis: driven %+ld (%ld transitions), registered %+ld, "
+			"missed %ld, misread %ld, edges closer than a sample %ld, cursor error %+ld\n",
+			axis_names[axis], r->driven_net, r->transitions, r->registered_net,
+			r->missed, r->misread, r->close_edges, error);
+		total_error += labs(error);
+	}
+
+	if (params->max_error >= 0 && total_error > params->max_error) {
+		ERROR_PRINT("Cursor error %ld exceeds the tolerated %ld counts\n", total_error, params->max_error);
+		return 1;
+	}
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,259 @@
+/**
+ * @file ikbd_serial.c
+ * @brief Mouse output as IKBD relative mouse packets on a serial line.
+ *
+ * Quadrature carries one count per edge, and the ST only sees edges a few
+ * hundred microseconds apart, so a fast flick is either slowed down or cut
+ * short. The keyboard processor instead reports the mouse to the ST as
+ * 3-byte packets of up to +-127 counts per axis at 7812.5 baud. Driving
+ * that line directly removes the limit: one packet every 3.84 ms carries
+ * whatever was accumulated since the previous one.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <asm/termbits.h>
+#include <sys/ioctl.h>
+
+#include "ikbd_serial.h"
+#include "precision.h"
+#include "global.h"
+
+
+static int tty_fd = -1;
+static pthread_t thread;
+static int thread_running = 0;
+
+// Counts and buttons not yet sent, protected by lock
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t idle_cond = PTHREAD_COND_INITIALIZER;
+static int pending[2] = { 0, 0 };
+static uint8_t sent_buttons = 0;
+
+// Button states still to send, oldest first: a click shorter than a packet
+// still goes out as a press then a release
+static uint8_t button_queue[IKBD_BUTTON_QUEUE];
+static int queued = 0;
+static int stopping = 0;
+
+// Time the line is free again, after the last packet written
+static uint64_t line_free_ns = 0;
+
+static ikbd_serial_stats_t stats;
+
+
+// Reads CLOCK_MONOTONIC in nanoseconds.
+static uint64_t monotonic_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Sleeps until an absolute CLOCK_MONOTONIC time.
+static void sleep_until(uint64_t time_ns) {
+	struct timespec ts = {
+		.tv_sec = (time_t)(time_ns / 1000000000ULL),
+		.tv_nsec = (long)(time_ns % 1000000000ULL)
+	};
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+// Clamps a count to what one packet carries.
+static int clamp_count(int count) {
+	if (count > IKBD_MAX_COUNT) return IKBD_MAX_COUNT;
+	if (count < -IKBD_MAX_COUNT) return -IKBD_MAX_COUNT;
+	return count;
+}
+
+// Builds a relative mouse packet.
+void ikbd_build_packet(int dx, int dy, uint8_t state, uint8_t *packet) {
+	packet[0] = IKBD_HEADER | (state & (IKBD_HEADER_LEFT | IKBD_HEADER_RIGHT));
+	packet[1] = (uint8_t)(int8_t)clamp_count(dx);
+	packet[2] = (uint8_t)(int8_t)clamp_count(dy);
+}
+
+// Sets raw 8N1 at 7812.5 baud, a rate only reachable with BOTHER.
+static int configure_line(int fd) {
+	struct termios2 tio;
+
+	if (ioctl(fd, TCGETS2, &tio) < 0) {
+		return -1;
+	}
+	tio.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON | IXOFF);
+	tio.c_oflag &= ~OPOST;
+	tio.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+	tio.c_cflag &= ~(CSIZE | PARENB | CSTOPB | CRTSCTS | CBAUD | (CBAUD << IBSHIFT));
+	tio.c_cflag |= CS8 | CREAD | CLOCAL | BOTHER | (BOTHER << IBSHIFT);
+	// Integer rate: the UART divisor rounds 7812 to the nearest it can do
+	tio.c_ispeed = tio.c_ospeed = IKBD_BAUD_NUM / IKBD_BAUD_DEN;
+	tio.c_cc[VMIN] = 0;
+	tio.c_cc[VTIME] = 0;
+	return ioctl(fd, TCSETS2, &tio);
+}
+
+// Packet writer: one packet per line slot while counts or buttons are pending.
+static void *writer_thread(void *arg) {
+	(void)arg;
+	uint8_t packet[IKBD_PACKET_SIZE];
+	uint8_t discard[64];
+
+	pthread_mutex_lock(&lock);
+	while (!stopping) {
+		if (pending[0] == 0 && pending[1] == 0 && queued == 0) {
+			pthread_cond_broadcast(&idle_cond);
+			pthread_cond_wait(&work_cond, &lock);
+			continue;
+		}
+
+		// Wait for the previous packet to leave: what arrives meanwhile joins this one
+		if (monotonic_ns() < line_free_ns) {
+			pthread_mutex_unlock(&lock);
+			sleep_until(line_free_ns);
+			pthread_mutex_lock(&lock);
+			continue;
+		}
+
+		int dx = clamp_count(pending[0]);
+		int dy = clamp_count(pending[1]);
+		uint8_t state = queued ? button_queue[0] : sent_buttons;
+		ikbd_build_packet(dx, dy, state, packet);
+		if (write(tty_fd, packet, sizeof(packet)) == (ssize_t)sizeof(packet)) {
+			pending[0] -= dx;
+			pending[1] -= dy;
+			sent_buttons = state;
+			if (queued) {
+				memmove(button_queue, button_queue + 1, (size_t)--queued);
+			}
+			stats.packets++;
+			stats.counts += (unsigned long long)(abs(dx) + abs(dy));
+			if (pending[0] != 0 || pending[1] != 0) {
+				stats.saturated++;
+			}
+		} else {
+			stats.write_errors++;
+		}
+		line_free_ns = monotonic_ns() + IKBD_PACKET_NS;
+
+		// The ST sends commands to the keyboard processor: not for us
+		while (read(tty_fd, discard, sizeof(discard)) > 0);
+	}
+	pthread_cond_broadcast(&idle_cond);
+	pthread_mutex_unlock(&lock);
+	return NULL;
+}
+
+// Opens a UART at the IKBD rate and starts the packet writer.
+int ikbd_serial_open(const char *path) {
+	tty_fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+	if (tty_fd < 0) {
+		ERROR_PRINT("Cannot open serial device %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	if (configure_line(tty_fd) < 0) {
+		ERROR_PRINT("Cannot set %s to 7812.5 baud: %s\n", path, strerror(errno));
+		close(tty_fd);
+		tty_fd = -1;
+		return -1;
+	}
+
+	memset(&stats, 0, sizeof(stats));
+	pending[0] = pending[1] = 0;
+	sent_buttons = 0;
+	queued = 0;
+	line_free_ns = 0;
+	stopping = 0;
+
+	// Signals stay with the main thread, which owns the running flag
+	sigset_t all, old;
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+	int err = pthread_create(&thread, precision_thread_attr(), writer_thread, NULL);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (err != 0) {
+		ERROR_PRINT("Cannot start IKBD packet writer: %s\n", strerror(err));
+		close(tty_fd);
+		tty_fd = -1;
+		return -1;
+	}
+	thread_running = 1;
+
+	DEBUG_PRINT("IKBD serial output on %s, one packet every %llu us at most\n", path,
+		(unsigned long long)(IKBD_PACKET_NS / 1000ULL));
+	return 0;
+}
+
+// Adds counts to the next packets.
+void ikbd_serial_add(int axis, int count) {
+	pthread_mutex_lock(&lock);
+	pending[axis] += count;
+	pthread_cond_signal(&work_cond);
+	pthread_mutex_unlock(&lock);
+}
+
+// Sets the state of a button, sent with the next packet.
+void ikbd_serial_button(uint8_t button, int pressed) {
+	pthread_mutex_lock(&lock);
+	uint8_t last = queued ? button_queue[queued - 1] : sent_buttons;
+	uint8_t state = pressed ? (last | button) : (last & ~button);
+	if (state != last) {
+		// Queue full: the latest state replaces the last one queued
+		if (queued == IKBD_BUTTON_QUEUE) {
+			queued--;
+		}
+		button_queue[queued++] = state;
+		pthread_cond_signal(&work_cond);
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+// Waits until every accumulated count and button change has been sent.
+void ikbd_serial_flush(void) {
+	if (!thread_running) return;
+
+	pthread_mutex_lock(&lock);
+	while (!stopping && (pending[0] != 0 || pending[1] != 0 || queued != 0)) {
+		pthread_cond_wait(&idle_cond, &lock);
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+// Copies the counters of the serial output.
+void ikbd_serial_get_stats(ikbd_serial_stats_t *out) {
+	pthread_mutex_lock(&lock);
+	*out = stats;
+	pthread_mutex_unlock(&lock);
+}
+
+// Stops the packet writer and closes the device.
+void ikbd_serial_close(void) {
+	if (!thread_running) return;
+
+	pthread_mutex_lock(&lock);
+	stopping = 1;
+	pthread_cond_signal(&work_cond);
+	pthread_mutex_unlock(&lock);
+	pthread_join(thread, NULL);
+	thread_running = 0;
+
+	// Leave the ST with the buttons released
+	uint8_t packet[IKBD_PACKET_SIZE];
+	ikbd_build_packet(0, 0, 0, packet);
+	if (sent_buttons != 0 && write(tty_fd, packet, sizeof(packet)) < 0) {
+		DEBUG_PRINT("Cannot release the IKBD buttons: %s\n", strerror(errno));
+	}
+
+	INFO_PRINT("IKBD serial: %llu packets, %llu counts, %llu saturated, %llu write errors\n",
+		stats.packets, stats.counts, stats.saturated, stats.write_errors);
+	close(tty_fd);
+	tty_fd = -1;
+}
@@ -0,0 +1,314 @@
+/**
+ * @file joystick.c
+ * @brief Gamepad to Atari joystick port.
+ *
+ * A joystick port is five switches to ground: no pulse train, no pacing.
+ * Every axis event is compared with thresholds precomputed from the axis
+ * range when the gamepad is opened, and the lines are written from the
+ * reading thread as soon as their levels change, so an event reaches the
+ * port after one read and one line write.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#include "joystick.h"
+#include "device_detection.h"
+#include "gpio_control.h"
+#include "latency.h"
+#include "precision.h"
+#include "global.h"
+
+
+// Axes feeding each direction: stick then hat
+static const int axis_codes[2][2] = {
+	{ ABS_X, ABS_HAT0X },
+	{ ABS_Y, ABS_HAT0Y }
+};
+
+static joystick_config_t settings;
+static output_lines_t *lines = NULL;
+static int fd = -1;
+static clockid_t event_clock = CLOCK_MONOTONIC;
+static joystick_map_t map;
+static uint32_t levels = JOYSTICK_IDLE_LEVELS;
+
+static pthread_t thread;
+static int thread_running = 0;
+static int wake_pipe[2] = { -1, -1 };
+
+// Statistics, protected by lock
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static int connected = 0;
+static unsigned long long events = 0;
+static unsigned long long changes = 0;
+static latency_hist_t latency;
+
+
+// Precomputes the thresholds of the stick and the hat and clears the state.
+void joystick_map_init(joystick_map_t *map, int device_fd, int threshold) {
+	memset(map, 0, sizeof(*map));
+	for (int code = 0; code < ABS_CNT; code++) {
+		map->table[code].axis = -1;
+	}
+
+	for (int axis = 0; axis < 2; axis++) {
+		for (int source = 0; source < 2; source++) {
+			int code = axis_codes[axis][source];
+			struct input_absinfo info = { 0 };
+
+			if (device_fd < 0 || ioctl(device_fd, EVIOCGABS(code), &info) < 0 || info.maximum <= info.minimum) {
+				info.minimum = source ? -1 : -32767;
+				info.maximum = source ? 1 : 32767;
+				info.flat = 0;
+			}
+
+			// Past the dead zone at least, one unit off centre at the very least
+			int64_t center = ((int64_t)info.minimum + info.maximum) / 2;
+			int64_t offset = ((int64_t)info.maximum - info.minimum) / 2 * threshold / 100;
+			if (offset < info.flat) offset = info.flat;
+			if (offset < 1) offset = 1;
+
+			map->table[code].axis = (int8_t)axis;
+			map->table[code].low = (int32_t)(center - offset);
+			map->table[code].high = (int32_t)(center + offset);
+		}
+	}
+}
+
+// Applies an input event to a map and returns the joystick line levels.
+uint32_t joystick_map_event(joystick_map_t *map, const struct input_event *ie) {
+	if (ie->type == EV_ABS && ie->code < ABS_CNT && map->table[ie->code].axis >= 0) {
+		const joystick_threshold_t *t = &map->table[ie->code];
+		map->direction[ie->code] = (int8_t)((ie->value <= t->low) ? -1 : (ie->value >= t->high) ? 1 : 0);
+	} else if (ie->type == EV_KEY && ie->code >= BTN_DPAD_UP && ie->code <= BTN_DPAD_RIGHT) {
+		// BTN_DPAD_UP, DOWN, LEFT, RIGHT follow the line order
+		uint32_t bit = 1u << (ie->code - BTN_DPAD_UP);
+		map->dpad = ie->value ? (map->dpad | bit) : (map->dpad & ~bit);
+	} else if (ie->type == EV_KEY && ie->code >= BTN_JOYSTICK && ie->code <= BTN_THUMBR) {
+		uint32_t bit = 1u << (ie->code - BTN_JOYSTICK);
+		map->fire = ie->value ? (map->fire | bit) : (map->fire & ~bit);
+	}
+
+	uint32_t active = map->fire ? (1u << JOY_FIRE) : 0;
+	for (int axis = 0; axis < 2; axis++) {
+		int line = axis ? JOY_UP : JOY_LEFT;
+		int sum = map->direction[axis_codes[axis][0]] + map->direction[axis_codes[axis][1]]
+			- (int)((map->dpad >> line) & 1) + (int)((map->dpad >> (line + 1)) & 1);
+		if (sum < 0) {
+			active |= 1u << line;
+		} else if (sum > 0) {
+			active |= 1u << (line + 1);
+		}
+	}
+	return JOYSTICK_IDLE_LEVELS & ~active;
+}
+
+// Opens the gamepad and precomputes its thresholds.
+static int open_device(void) {
+	fd = open(settings.device_path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+	if (fd < 0) {
+		return -1;
+	}
+	event_clock = (set_monotonic_timestamps(fd) == 0) ? CLOCK_MONOTONIC : CLOCK_REALTIME;
+	joystick_map_init(&map, fd, settings.threshold);
+
+	pthread_mutex_lock(&lock);
+	connected = 1;
+	pthread_mutex_unlock(&lock);
+	INFO_PRINT("Joystick: gamepad %s opened\n", settings.device_path);
+	return 0;
+}
+
+// Closes a vanished gamepad and releases the lines.
+static void drop_device(const char *reason) {
+	INFO_PRINT("Joystick: gamepad %s %s\n", settings.device_path, reason);
+	close(fd);
+	fd = -1;
+	levels = JOYSTICK_IDLE_LEVELS;
+	output_lines_write(lines, levels);
+
+	pthread_mutex_lock(&lock);
+	connected = 0;
+	pthread_mutex_unlock(&lock);
+}
+
+// Reads the available events, writing the lines on every change.
+static void read_device(void) {
+	struct input_event buffer[64];
+
+	for (;;) {
+		ssize_t bytes = read(fd, buffer, sizeof(buffer));
+		if (bytes < 0 && errno == EINTR) {
+			continue;
+		}
+		if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			return;
+		}
+		if (bytes <= 0) {
+			drop_device(bytes == 0 ? "closed" : "disconnected");
+			return;
+		}
+
+		size_t count = (size_t)bytes / sizeof(buffer[0]);
+		for (size_t i = 0; i < count; i++) {
+			uint32_t next = joystick_map_event(&map, &buffer[i]);
+			if (next == levels) {
+				continue;
+			}
+			levels = next;
+			output_lines_write(lines, levels);
+
+			struct timespec now;
+			clock_gettime(event_clock, &now);
+			uint64_t now_ns = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+			uint64_t event_ns = (uint64_t)buffer[i].time.tv_sec * 1000000000ULL + (uint64_t)buffer[i].time.tv_usec * 1000ULL;
+
+			pthread_mutex_lock(&lock);
+			changes++;
+			latency_record(&latency, now_ns > event_ns ? now_ns - event_ns : 0);
+			pthread_mutex_unlock(&lock);
+		}
+
+		pthread_mutex_lock(&lock);
+		events += count;
+		pthread_mutex_unlock(&lock);
+		if (count < sizeof(buffer) / sizeof(buffer[0])) {
+			return;
+		}
+	}
+}
+
+// Joystick thread: waits on the gamepad, or for it to come back.
+static void *joystick_thread(void *arg) {
+	(void)arg;
+	int reported = 0;
+
+	for (;;) {
+		if (fd < 0 && open_device() < 0 && !reported) {
+			// Reported once until the gamepad comes back
+			INFO_PRINT("Joystick: cannot open gamepad %s: %s\n", settings.device_path, strerror(errno));
+		}
+		reported = (fd < 0);
+
+		struct pollfd fds[2] = {
+			{ .fd = wake_pipe[0], .events = POLLIN },
+			{ .fd = fd, .events = POLLIN }
+		};
+		int ready = poll(fds, fd >= 0 ? 2 : 1, fd >= 0 ? -1 : JOYSTICK_REOPEN_S * 1000);
+		if (ready < 0 && errno != EINTR) {
+			ERROR_PRINT("Joystick: poll failed: %s\n", strerror(errno));
+			break;
+		}
+		if (fds[0].revents) {
+			break;
+		}
+		if (fd >= 0 && fds[1].revents) {
+			read_device();
+		}
+	}
+	return NULL;
+}
+
+// Starts the joystick output of the configuration, if it has a device.
+int joystick_start(const joystick_config_t *cfg) {
+	if (cfg->device_path[0] == '\0') {
+		return 0;
+	}
+	if (cfg->threshold < 1 || cfg->threshold > 100) {
+		ERROR_PRINT("Joystick threshold must be between 1 and 100 percent\n");
+		return -1;
+	}
+
+	settings = *cfg;
+	levels = JOYSTICK_IDLE_LEVELS;
+	events = changes = 0;
+	memset(&latency, 0, sizeof(latency));
+
+	unsigned int offsets[JOYSTICK_LINES];
+	for (int line = 0; line < JOYSTICK_LINES; line++) {
+		offsets[line] = (unsigned int)cfg->pins[line];
+	}
+	lines = output_lines_request(cfg->gpio_chip, offsets, JOYSTICK_LINES, JOYSTICK_IDLE_LEVELS);
+	if (lines == NULL) {
+		ERROR_PRINT("Joystick: cannot request its lines\n");
+		return -1;
+	}
+	if (pipe2(wake_pipe, O_CLOEXEC) < 0) {
+		ERROR_PRINT("Joystick: cannot create pipe: %s\n", strerror(errno));
+		output_lines_close(lines);
+		lines = NULL;
+		return -1;
+	}
+
+	// Signals stay with the main thread, which owns the running flag
+	sigset_t all, old;
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+	int err = pthread_create(&thread, precision_thread_attr(), joystick_thread, NULL);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (err != 0) {
+		ERROR_PRINT("Joystick: cannot start thread: %s\n", strerror(err));
+		joystick_stop();
+		return -1;
+	}
+	thread_running = 1;
+
+	INFO_PRINT("Joystick output started on %s\n", cfg->gpio_chip);
+	return 0;
+}
+
+// Formats the state and statistics of the joystick output on one line.
+int joystick_status(char *buffer, size_t size) {
+	if (lines == NULL) {
+		buffer[0] = '\0';
+		return 0;
+	}
+
+	pthread_mutex_lock(&lock);
+	snprintf(buffer, size, "joystick=%s events=%llu changes=%llu p50_us=%llu p99_us=%llu max_us=%llu",
+		connected ? "connected" : "waiting", events, changes,
+		(unsigned long long)latency_percentile(&latency, 50),
+		(unsigned long long)latency_percentile(&latency, 99),
+		(unsigned long long)latency.max_us);
+	pthread_mutex_unlock(&lock);
+	return 1;
+}
+
+// Stops the joystick output and releases its lines.
+void joystick_stop(void) {
+	if (thread_running) {
+		if (write(wake_pipe[1], "", 1) < 0) {
+			DEBUG_PRINT("Cannot wake the joystick thread: %s\n", strerror(errno));
+		}
+		pthread_join(thread, NULL);
+		thread_running = 0;
+
+		INFO_PRINT("Joystick: %llu events, %llu line changes\n", events, changes);
+		latency_report("Joystick latency", &latency);
+	}
+	for (int i = 0; i < 2; i++) {
+		if (wake_pipe[i] >= 0) {
+			close(wake_pipe[i]);
+			wake_pipe[i] = -1;
+		}
+	}
+	if (fd >= 0) {
+		close(fd);
+		fd = -1;
+	}
+	output_lines_close(lines);
+	lines = NULL;
+	connected = 0;
+}
@@ -0,0 +1,106 @@
+/**
+ * @file latency.c
+ * @brief Input-to-output latency histograms.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <time.h>
+
+#include "latency.h"
+#include "gpio_control.h"
+#include "global.h"
+
+
+latency_hist_t button_latency = {0};
+latency_hist_t motion_latency = {0};
+
+// Clock of the input device timestamps
+static clockid_t event_clock = CLOCK_MONOTONIC;
+
+
+// Returns the bucket holding a latency.
+static int bucket_of(uint64_t us) {
+	if (us < LATENCY_LINEAR_BUCKETS) {
+		return (int)us;
+	}
+
+	int exponent = 63 - __builtin_clzll(us);
+	int index = LATENCY_LINEAR_BUCKETS + (exponent - 4) * 4 + (int)((us >> (exponent - 2)) & 3);
+	return (index < LATENCY_BUCKETS) ? index : LATENCY_BUCKETS - 1;
+}
+
+// Returns the largest latency falling in a bucket.
+static uint64_t bucket_limit(int index) {
+	if (index < LATENCY_LINEAR_BUCKETS) {
+		return (uint64_t)index;
+	}
+
+	int exponent = (index - LATENCY_LINEAR_BUCKETS) / 4 + 4;
+	uint64_t sub = (uint64_t)((index - LATENCY_LINEAR_BUCKETS) % 4);
+	return ((4 + sub + 1) << (exponent - 2)) - 1;
+}
+
+// Selects the clock stamping input events on real hardware.
+void event_clock_set_monotonic(int monotonic) {
+	event_clock = monotonic ? CLOCK_MONOTONIC : CLOCK_REALTIME;
+}
+
+// Reads the clock used by input event timestamps.
+uint64_t event_clock_ns(void) {
+	// The null backend emits on its virtual clock, which follows input timestamps
+	if (output_backend == OUTPUT_NULL) {
+		return output_clock_ns();
+	}
+
+	struct timespec ts;
+	clock_gettime(event_clock, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Returns the time elapsed since an input event was stamped.
+uint64_t event_latency_ns(const struct timeval *tv) {
+	uint64_t stamp = (uint64_t)tv->tv_sec * 1000000000ULL + (uint64_t)tv->tv_usec * 1000ULL;
+	uint64_t now = event_clock_ns();
+	return (now > stamp) ? now - stamp : 0;
+}
+
+// Adds a sample to a histogram.
+void latency_record(latency_hist_t *hist, uint64_t latency_ns) {
+	uint64_t us = latency_ns / 1000;
+
+	hist->buckets[bucket_of(us)]++;
+	hist->count++;
+	if (us > hist->max_us) {
+		hist->max_us = us;
+	}
+}
+
+// Returns a percentile of a histogram.
+uint64_t latency_percentile(const latency_hist_t *hist, unsigned int pct) {
+	if (hist->count == 0) {
+		return 0;
+	}
+
+	uint64_t rank = (hist->count * pct + 99) / 100;
+	uint64_t seen = 0;
+	for (int i = 0; i < LATENCY_BUCKETS; i++) {
+		seen += hist->buckets[i];
+		if (seen >= rank && seen > 0) {
+			uint64_t limit = bucket_limit(i);
+			return (limit < hist->max_us) ? limit : hist->max_us;
+		}
+	}
+	return hist->max_us;
+}
+
+// Prints count, p50, p90, p99 and max of a histogram on one line.
+void latency_report(const char *name, const latency_hist_t *hist) {
+	INFO_PRINT("%s: %llu samples, p50 %llu us, p90 %llu us, p99 %llu us, max %llu us\n", name,
+		(unsigned long long)hist->count,
+		(unsigned long long)latency_percentile(hist, 50),
+		(unsigned long long)latency_percentile(hist, 90),
+		(unsigned long long)latency_percentile(hist, 99),
+		(unsigned long long)hist->max_us);
+}
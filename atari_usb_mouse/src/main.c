@@ -53,17 +53,35 @@
 #include "device_detection.h"
 #include "daemon.h"
 #include "monitor.h"
+#include "telemetry.h"
+#include "replay.h"
+#include "mouse_event.h"
+#include "bench.h"
+#include "gpio_sim.h"
+#include "ikbd_model.h"
+#include "tick.h"
+#include "frame_pacing.h"
+#include "button_lane.h"
+#include "latency.h"
+#include "precision.h"
+#include "calibrate.h"
+#include "control.h"
+#include "handoff.h"
+#include "watchdog.h"
+#include "outputs.h"
+#include "remote.h"
+#include "ikbd_serial.h"
+#include "joystick.h"
+#include "stress.h"
 
 
 #ifndef VERSION
 #define VERSION "unknown"
 #endif
 
-#define DEFAULT_SENSITIVITY 2  // Default sensitivity (divides movement by 2)
-
-
 int debug_mode = 0;
 int daemon_mode = 0;
+int stdout_reserved = 0;
 int monitor_mode = 0;
 volatile sig_atomic_t running = 1;
 int gpio_initialized = 0;
@@ -77,10 +95,67 @@ const config_t default_config = {
 	.pin_left_button = 13,
 	.pin_right_button = 21,
 	.sensitivity = 2,
-	.device_path = ""
+	.device_path = "",
+	.gpio_chip = "/dev/gpiochip0",	// Usually /dev/gpiochip0 on Raspberry Pi
+	.pacing = PACING_BURST,
+	.tick_us = TICK_DEFAULT_US,
+	.precision = 0,
+	.spin_us = PRECISION_DEFAULT_SPIN_US,
+	.precision_cpu = -1,
+	.calibrate_at_startup = 0,
+	.stall_us = WATCHDOG_DEFAULT_STALL_US,
+	.remote_button_timeout_ms = REMOTE_DEFAULT_BUTTON_TIMEOUT_MS,
+	.joystick = { .threshold = JOYSTICK_DEFAULT_THRESHOLD },
+	.num_filters = -1
 };
 config_t config;
 
+// Command-line settings, applied over the configuration file at startup and on reload
+static struct {
+    int pin_xa, pin_xb, pin_ya, pin_yb, pin_bleft, pin_bright;
+    int sensitivity;
+    char *mouse_device;
+    char *gpio_chip;
+    char *curve_name;
+    int pacing;
+    int tick_us;
+    int precision;
+    int spin_us;
+    int precision_cpu;
+    char *control_socket;
+    int stall_us;
+    char *remote_listen;
+    char *ikbd_device;
+} overrides = { -1, -1, -1, -1, -1, -1, DEFAULT_SENSITIVITY, NULL, NULL, NULL, -1, 0, 0, -1, -2, NULL, -1, NULL, NULL };
+
+// Set by SIGHUP, handled by the event loop between two frames
+static volatile sig_atomic_t reload_requested = 0;
+
+// Set by SIGUSR2 from a restarting instance, handled between two frames
+static volatile sig_atomic_t handoff_requested = 0;
+
+// Set once the output belongs to the new instance: exit without idling the lines
+static int handed_off = 0;
+
+// Set by --bench: stdout carries the results, the exit report would show benchmark samples
+static int bench_mode = 0;
+
+// CLOCK_MONOTONIC time main() started, origin of the startup metrics
+static uint64_t start_ns;
+
+// Profile of the open input device (-1: none), and the settings profiles override
+static int profile_index = -1;
+static struct {
+    int sensitivity;
+    int curve_index;
+    int pacing;
+    int tick_us;
+} base_settings;
+
+// Startup calibration, applied again to reloaded configurations
+static calibration_t calibration;
+static int calibrated = 0;
+
 
 // Display usage help
 void print_usage(const char *program_name) {
@@ -91,22 +166,54 @@ void print_usage(const char *program_name) {
     printf("  -C,                    Display current configuration\n");
     printf("  -d, --debug            Enable debug messages\n");
     printf("  -D, --device DEVICE    Input device path (e.g. /dev/input/event1)\n");
-    printf("  -m, --monitor          Show real-time GPIO and event status\n");
+    printf("  -m, --monitor[=MODE]   Show real-time status (MODE: ansi (default), jsonl)\n");
+    printf("      --monitor-interval MS  Aggregate jsonl records over MS milliseconds (default: per frame)\n");
     printf("  -s, --sensitivity N    Set sensitivity (1=normal, 2=half, etc.)\n");
+    printf("      --curve NAME       Gain/period curve from the configuration (default: %s)\n", DEFAULT_CURVE_NAME);
+    printf("      --pacing MODE      Output pacing: burst (default), tick (fixed rate) or frame (spread over the polling interval)\n");
+    printf("      --tick-us N        Tick period of the tick pacing (default: %d)\n", TICK_DEFAULT_US);
+    printf("      --precision        Drive edges with the sleep-then-spin emitter (dedicated core)\n");
+    printf("      --spin-us N        Busy-wait window before each edge (default: %d)\n", PRECISION_DEFAULT_SPIN_US);
+    printf("      --precision-cpu N  Pin the emitter to CPU N (e.g. one reserved with isolcpus=)\n");
+    printf("      --calibrate        Measure line writes and sleep overshoot, save the derived curve to the config\n");
+    printf("      --control PATH     Listen for tuning commands on a Unix socket (e.g. socat - UNIX-CONNECT:PATH)\n");
+    printf("      --stall-us N       Report pipeline stages busy for N us without progress (0 = off, default: %d)\n", WATCHDOG_DEFAULT_STALL_US);
+    printf("      --udp-listen ADDR  Take the mouse input from UDP datagrams on [HOST:]PORT instead of a device\n");
+    printf("      --udp-send ADDR    Forward the device to a --udp-listen instance at HOST:PORT and exit\n");
     printf("      --pin-xa N         GPIO pin for XA signal (default: %d)\n", default_config.pin_xa);
     printf("      --pin-xb N         GPIO pin for XB signal (default: %d)\n", default_config.pin_xb);
     printf("      --pin-ya N         GPIO pin for YA signal (default: %d)\n", default_config.pin_ya);
     printf("      --pin-yb N         GPIO pin for YB signal (default: %d)\n", default_config.pin_yb);
     printf("      --pin-bleft N      GPIO pin for left button (default: %d)\n", default_config.pin_left_button);
     printf("      --pin-bright N     GPIO pin for right button (default: %d)\n", default_config.pin_right_button);
+    printf("      --gpio-chip PATH   GPIO chip device (default: %s)\n", default_config.gpio_chip);
+    printf("      --output BACKEND   Output backend: gpio (default), null (no hardware) or ikbd (serial packets)\n");
+    printf("      --ikbd-tty PATH    Serial device of the ikbd backend, wired to the ST keyboard line\n");
+    printf("      --edge-trace FILE  Write every line transition to FILE\n");
+    printf("      --vcd FILE         Dump every line transition to FILE as VCD (GTKWave, sigrok)\n");
+    printf("      --record FILE      Record input events of the device to FILE and exit\n");
+    printf("      --replay FILE      Feed recorded events to the output instead of a device\n");
+    printf("      --replay-uinput    With --replay, play through a virtual uinput mouse instead\n");
+    printf("      --replay-speed X   Replay speed factor (default: 1 = real time, max = no pacing)\n");
+    printf("      --bench            Run pipeline benchmarks (with --replay FILE as extra input)\n");
+    printf("      --gpio-sim-check   Run end-to-end checks against a gpio-sim chip (root)\n");
+    printf("      --stress PATTERN   Drive another instance from a uinput mouse and report how it copes:\n");
+    printf("                         constant, circle, flick, jitter or buttons\n");
+    printf("      --stress-rate HZ   Frames per second of the stress pattern (default: %d, max %d)\n", STRESS_DEFAULT_RATE, STRESS_MAX_RATE);
+    printf("      --stress-seconds N Duration of the stress run (default: %d)\n", STRESS_DEFAULT_SECONDS);
+    printf("      --ikbd-model TRACE Report the counts an ST would register from an edge trace\n");
+    printf("      --ikbd-sample-us N IKBD line sampling interval for the model (default: %d)\n", IKBD_SAMPLE_US);
+    printf("      --ikbd-jitter-us N Random delay added to each modelled sample (default: 0)\n");
+    printf("      --ikbd-max-error N Fail if the modelled cursor error exceeds N counts\n");
     printf("  -b, --daemon           Run as a daemon\n");
     printf("  -p, --pidfile FILE     PID file for daemon mode (default: %s)\n", pidfile_path);
     printf("  -k, --kill             Stop running daemon\n");
-    printf("  -r, --restart          Restart daemon\n");
+    printf("  -r, --restart          Restart daemon, taking its device and GPIO lines over without a glitch\n");
     printf("  -t, --status           Show daemon status\n");
     printf("  -v, --version          Print version\n");
     printf("  -h, --help             Show this help message\n\n");
     printf("If no device is specified, it will be detected automatically.\n");
+    printf("SIGHUP reloads the configuration file without releasing the GPIO lines.\n");
 }
 
 // Print version number
@@ -120,104 +227,433 @@ void signal_handler(int signum) {
     running = 0;
 }
 
+// Signal handler requesting a configuration reload
+void reload_handler(int signum) {
+    (void)signum;
+    reload_requested = 1;
+}
+
+// Signal handler requesting a hand-off to a restarting instance
+void handoff_handler(int signum) {
+    (void)signum;
+    handoff_requested = 1;
+}
+
+// Install the reload and hand-off handlers, persistent unlike signal() in strict POSIX mode
+static void install_reload_handler(void) {
+    struct sigaction action;
+
+    memset(&action, 0, sizeof(action));
+    sigemptyset(&action.sa_mask);
+    action.sa_handler = reload_handler;
+    sigaction(SIGHUP, &action, NULL);
+    action.sa_handler = handoff_handler;
+    sigaction(SIGUSR2, &action, NULL);
+}
+
+// Read CLOCK_MONOTONIC in nanoseconds
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Stop an instance that did not hand over, and wait for it to exit
+static void stop_previous(pid_t pid) {
+    struct timespec poll_interval = { 0, 50000000L };
+
+    kill(pid, SIGTERM);
+    for (int i = 0; i < 40 && kill(pid, 0) == 0; i++) {
+        nanosleep(&poll_interval, NULL);
+    }
+}
+
 // Cleanup function executed on exit
 void cleanup() {
-    cleanup_gpio();
+    // After a hand-off, the service lives on in the new instance
+    if (!handed_off) {
+        watchdog_notify("STOPPING=1");
+    }
+    watchdog_cleanup();
+    tick_stop();
+    outputs_stop();
+    joystick_stop();
+    ikbd_serial_close();
+    if (remote_active()) {
+        remote_report();
+        remote_stop();
+    }
+    control_cleanup();
+    if (handed_off) {
+        detach_gpio();
+    } else {
+        cleanup_gpio();
+    }
+    if (monitor_mode != MONITOR_JSONL && !bench_mode && (button_latency.count || motion_latency.count)) {
+        latency_report("Button latency", &button_latency);
+        latency_report("Motion latency", &motion_latency);
+        precision_report();
+    }
+    close_edge_trace();
+    close_vcd_dump();
     cleanup_screen();
+    if (monitor_mode == MONITOR_JSONL) {
+        telemetry_cleanup();
+    }
     if (daemon_mode) {
-        remove_pidfile();
+        // The new instance already owns the PID file
+        if (!handed_off) {
+            remove_pidfile();
+        }
         closelog();
     }
 }
 
-// Process mouse events and generate corresponding GPIO signals
-void process_mouse_event(struct input_event *ie, quadrature_state_t *state, int sensitivity) {
-    if (sensitivity == 0) {
-        sensitivity = DEFAULT_SENSITIVITY;
-    }
-
-    // Mettre à jour le timestamp et le compteur d'événements
-    get_current_time(stats.last_event_time, sizeof(stats.last_event_time));
-
-    switch (ie->type) {
-        case EV_REL:
-            switch (ie->code) {
-                case REL_X:
-                    if (ie->value != 0) {
-                        stats.last_x_delta = ie->value;
-                        
-                        int movement = -ie->value / sensitivity;
-                        if (movement != 0) {
-                            generate_x_pulses(state, movement);
-                        }
+// Applies the command-line settings over a configuration loaded from file
+static int apply_overrides(config_t *cfg) {
+    if (overrides.pin_xa != -1) {
+        cfg->pin_xa = overrides.pin_xa;
+        DEBUG_PRINT("Setting pin_xa=%d from command line\n", cfg->pin_xa);
+    }
+    if (overrides.pin_xb != -1) {
+        cfg->pin_xb = overrides.pin_xb;
+        DEBUG_PRINT("Setting pin_xb=%d from command line\n", cfg->pin_xb);
+    }
+    if (overrides.pin_ya != -1) {
+        cfg->pin_ya = overrides.pin_ya;
+        DEBUG_PRINT("Setting pin_ya=%d from command line\n", cfg->pin_ya);
+    }
+    if (overrides.pin_yb != -1) {
+        cfg->pin_yb = overrides.pin_yb;
+        DEBUG_PRINT("Setting pin_yb=%d from command line\n", cfg->pin_yb);
+    }
+    if (overrides.pin_bleft != -1) {
+        cfg->pin_left_button = overrides.pin_bleft;
+        DEBUG_PRINT("Setting pin_left_button=%d from command line\n", cfg->pin_left_button);
+    }
+    if (overrides.pin_bright != -1) {
+        cfg->pin_right_button = overrides.pin_bright;
+        DEBUG_PRINT("Setting pin_right_button=%d from command line\n", cfg->pin_right_button);
+    }
+    if (overrides.sensitivity != DEFAULT_SENSITIVITY) {
+        cfg->sensitivity = overrides.sensitivity;
+        DEBUG_PRINT("Setting sensitivity=%d from command line\n", cfg->sensitivity);
+    }
+    if (overrides.curve_name != NULL) {
+        cfg->curve_index = find_curve(cfg, overrides.curve_name);
+        if (cfg->curve_index < 0) {
+            ERROR_PRINT("Unknown curve %s\n", overrides.curve_name);
+            return -1;
+        }
+        DEBUG_PRINT("Setting curve=%s from command line\n", overrides.curve_name);
+    }
+    if (overrides.pacing != -1) {
+        cfg->pacing = overrides.pacing;
+        DEBUG_PRINT("Setting pacing=%s from command line\n", pacing_name(overrides.pacing));
+    }
+    if (overrides.tick_us != 0) {
+        cfg->tick_us = overrides.tick_us;
+        DEBUG_PRINT("Setting tick_us=%d from command line\n", cfg->tick_us);
+    }
+    if (cfg->tick_us < TICK_MIN_US || cfg->tick_us > TICK_MAX_US) {
+        ERROR_PRINT("Tick period must be between %d and %d us\n", TICK_MIN_US, TICK_MAX_US);
+        return -1;
+    }
+    for (int i = 0; i < cfg->num_profiles; i++) {
+        int tick_us = cfg->profiles[i].tick_us;
+        if (tick_us != -1 && (tick_us < TICK_MIN_US || tick_us > TICK_MAX_US)) {
+            ERROR_PRINT("Profile %s: tick period must be between %d and %d us\n", cfg->profiles[i].key, TICK_MIN_US, TICK_MAX_US);
+            return -1;
+        }
+    }
+    if (overrides.precision) {
+        cfg->precision = 1;
+        DEBUG_PRINT("Setting precision=1 from command line\n");
+    }
+    if (overrides.spin_us != -1) {
+        cfg->spin_us = overrides.spin_us;
+        DEBUG_PRINT("Setting spin_us=%d from command line\n", cfg->spin_us);
+    }
+    if (overrides.precision_cpu != -2) {
+        cfg->precision_cpu = overrides.precision_cpu;
+        DEBUG_PRINT("Setting precision_cpu=%d from command line\n", cfg->precision_cpu);
+    }
+    if (overrides.gpio_chip != NULL) {
+        snprintf(cfg->gpio_chip, sizeof(cfg->gpio_chip), "%s", overrides.gpio_chip);
+        DEBUG_PRINT("Setting gpio_chip=%s from command line\n", cfg->gpio_chip);
+    }
+    if (overrides.mouse_device != NULL ) {
+        snprintf(cfg->device_path, sizeof(cfg->device_path), "%s", overrides.mouse_device);
+        DEBUG_PRINT("Setting device_path=%s from command line\n", cfg->device_path);
+    }
+    if (overrides.control_socket != NULL) {
+        snprintf(cfg->control_socket, sizeof(cfg->control_socket), "%s", overrides.control_socket);
+        DEBUG_PRINT("Setting control_socket=%s from command line\n", cfg->control_socket);
+    }
+    if (overrides.stall_us != -1) {
+        cfg->stall_us = overrides.stall_us;
+        DEBUG_PRINT("Setting stall_us=%d from command line\n", cfg->stall_us);
+    }
+    if (overrides.remote_listen != NULL) {
+        snprintf(cfg->remote_listen, sizeof(cfg->remote_listen), "%s", overrides.remote_listen);
+        DEBUG_PRINT("Setting remote_listen=%s from command line\n", cfg->remote_listen);
+    }
+    if (cfg->remote_button_timeout_ms <= REMOTE_KEEPALIVE_MS) {
+        ERROR_PRINT("Remote button timeout must exceed the %d ms keep-alive interval\n", REMOTE_KEEPALIVE_MS);
+        return -1;
+    }
+    if (overrides.ikbd_device != NULL) {
+        snprintf(cfg->ikbd_device, sizeof(cfg->ikbd_device), "%s", overrides.ikbd_device);
+        DEBUG_PRINT("Setting ikbd_device=%s from command line\n", cfg->ikbd_device);
+    }
 
-                        if (!monitor_mode) {
-                            DEBUG_PRINT("X movement: %d / sensitivity: %d = movement: %d\n", ie->value, sensitivity, movement);
-                        }
-                        
-                        if (monitor_mode) {
-                            display_monitor_status(state);
-                        }
-                    }
-                    break;
+    // Packets carry whatever accumulated: no edge timing to pace, spin or calibrate
+    if (output_backend == OUTPUT_IKBD) {
+        if (cfg->ikbd_device[0] == '\0') {
+            ERROR_PRINT("The ikbd output needs a serial device (--ikbd-tty or ikbd.device)\n");
+            return -1;
+        }
+        cfg->pacing = PACING_BURST;
+        cfg->precision = 0;
+        cfg->calibrate_at_startup = 0;
+        for (int i = 0; i < cfg->num_profiles; i++) {
+            cfg->profiles[i].pacing = -1;
+        }
+    }
+    return 0;
+}
 
-                case REL_Y:
-                    if (ie->value != 0) {
-                        stats.last_y_delta = ie->value;
-                        
-                        int movement = ie->value / sensitivity;
-                        if (movement != 0) {
-                            generate_y_pulses(state, movement);
-                        }
+// Remember the settings device profiles override, as loaded
+static void save_base_settings(const config_t *cfg) {
+    base_settings.sensitivity = cfg->sensitivity;
+    base_settings.curve_index = cfg->curve_index;
+    base_settings.pacing = cfg->pacing;
+    base_settings.tick_us = cfg->tick_us;
+}
 
-                        if (!monitor_mode) {
-                            DEBUG_PRINT("Y movement: %d / sensitivity: %d = movement: %d\n", ie->value, sensitivity, movement);
-                        }
-                        
-                        if (monitor_mode) {
-                            display_monitor_status(state);
-                        }
-                    }
-                    break;
-            }
-            break;
+// Publish a configuration to the running pipeline, returns the number of moved lines
+static int publish_configuration(config_t *next, quadrature_state_t *state) {
+    // Steps already queued go out with the timing they were queued with
+    frame_flush(state);
+    tick_flush();
+    int repace = (next->pacing != config.pacing || next->tick_us != config.tick_us);
+    if (repace) {
+        tick_stop();
+    }
 
-        case EV_KEY:
-            switch (ie->code) {
-                case BTN_LEFT:
-                    stats.left_button_state = ie->value;
-                    
-                    set_left_button(ie->value);
+    // Publish: the event loop is the only reader, and it is here
+    config_t previous = config;
+    config = *next;
+    if (config.num_filters != previous.num_filters
+            || memcmp(config.filters, previous.filters, sizeof(config.filters)) != 0
+            || config.num_profiles != previous.num_profiles
+            || memcmp(config.profiles, previous.profiles, sizeof(config.profiles)) != 0) {
+        mouse_event_configure(&config);
+    }
 
-                    if (!monitor_mode) {
-                        DEBUG_PRINT("Left button: %s\n", ie->value ? "pressed" : "released");
-                    }
-                    
-                    if (monitor_mode) {
-                        display_monitor_status(state);
-                    }
-                    break;
+    int moved = reconfigure_gpio_lines();
+    if (moved < 0) {
+        ERROR_PRINT("Cannot request the new GPIO pins, keeping the current ones\n");
+        config.pin_xa = previous.pin_xa;
+        config.pin_xb = previous.pin_xb;
+        config.pin_ya = previous.pin_ya;
+        config.pin_yb = previous.pin_yb;
+        config.pin_left_button = previous.pin_left_button;
+        config.pin_right_button = previous.pin_right_button;
+        moved = 0;
+    }
 
-                case BTN_RIGHT:
-                    stats.right_button_state = ie->value;
-                    
-                    set_right_button(ie->value);
+    if (repace && config.pacing == PACING_TICK && tick_start(state, config.tick_us) < 0) {
+        ERROR_PRINT("Cannot restart the fixed-rate output, using burst pacing\n");
+        config.pacing = PACING_BURST;
+    }
 
-                    if (!monitor_mode) {
-                        DEBUG_PRINT("Right button: %s\n", ie->value ? "pressed" : "released");
-                    }
-                    
-                    if (monitor_mode) {
-                        display_monitor_status(state);
-                    }
-                    break;
-            }
-            break;
+    return moved;
+}
+
+// Publish a configuration changed through the control socket
+static void control_publish(config_t *next, void *ctx) {
+    // Under a device profile, the change lasts until the next device
+    if (profile_index < 0) {
+        save_base_settings(next);
+    }
+    publish_configuration(next, (quadrature_state_t *)ctx);
+}
+
+// Find the profile of an input device, -1 if none, and describe the device
+static int identify_device(int fd, const config_t *cfg, char *description, size_t size) {
+    int vendor, product;
+    char name[256];
+
+    snprintf(description, size, "%s", "unknown");
+    if (fd < 0 || read_device_identity(fd, &vendor, &product, name, sizeof(name)) < 0) {
+        return -1;
+    }
+    snprintf(description, size, "%04x:%04x (%s)", vendor, product, name);
+    return find_profile(cfg, vendor, product, name);
+}
+
+// Set the settings of a profile over the base ones (-1: the base ones alone)
+static void apply_profile(config_t *next, int index) {
+    next->sensitivity = base_settings.sensitivity;
+    next->curve_index = base_settings.curve_index;
+    next->pacing = base_settings.pacing;
+    next->tick_us = base_settings.tick_us;
+    if (index < 0) {
+        return;
+    }
+
+    const profile_config_t *profile = &next->profiles[index];
+    if (profile->sensitivity != -1) next->sensitivity = profile->sensitivity;
+    if (profile->curve_index != -1) next->curve_index = profile->curve_index;
+    if (profile->pacing != -1) next->pacing = profile->pacing;
+    if (profile->tick_us != -1) next->tick_us = profile->tick_us;
+}
+
+// Switch to the profile of a newly opened input device: checked and built at load time, nothing is parsed here
+static void select_profile(int fd, quadrature_state_t *state) {
+    char description[320];
+    int index = identify_device(fd, &config, description, sizeof(description));
+    if (index == profile_index) {
+        return;
+    }
+
+    config_t next = config;
+    apply_profile(&next, index);
+    if (next.sensitivity != config.sensitivity || next.curve_index != config.curve_index
+            || next.pacing != config.pacing || next.tick_us != config.tick_us) {
+        publish_configuration(&next, state);
+    }
+    mouse_event_select_profile(index);
+    profile_index = index;
+    if (!monitor_mode) {
+        INFO_PRINT("Device %s: profile %s\n", description, index >= 0 ? config.profiles[index].key : "none");
+    }
+}
+
+// Reload the configuration file into the running pipeline, keeping the GPIO lines
+static void reload_configuration(const char *config_file, int fd, quadrature_state_t *state) {
+    struct timespec start, end;
+    config_t fresh;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    reload_requested = 0;
+
+    char notification[64];
+    snprintf(notification, sizeof(notification), "RELOADING=1\nMONOTONIC_USEC=%llu",
+        (unsigned long long)start.tv_sec * 1000000ULL + (unsigned long long)(start.tv_nsec / 1000L));
+    watchdog_notify(notification);
+
+    if (load_config(config_file, &fresh) < 0 || apply_overrides(&fresh) < 0
+            || (calibrated && fresh.calibrate_at_startup && calibrate_apply(&calibration, &fresh) < 0)) {
+        ERROR_PRINT("Cannot reload configuration, keeping the current one\n");
+        watchdog_notify("READY=1");
+        return;
+    }
+
+    // Bound to the open device, the chip and the emitter: kept until the next restart
+    if ((fresh.device_path[0] != '\0' && strcmp(fresh.device_path, config.device_path) != 0)
+            || strcmp(fresh.gpio_chip, config.gpio_chip) != 0
+            || fresh.precision != config.precision || fresh.spin_us != config.spin_us
+            || fresh.precision_cpu != config.precision_cpu
+            || strcmp(fresh.control_socket, config.control_socket) != 0
+            || fresh.stall_us != config.stall_us
+            || fresh.num_outputs != config.num_outputs
+            || memcmp(fresh.outputs, config.outputs, sizeof(fresh.outputs)) != 0
+            || strcmp(fresh.remote_listen, config.remote_listen) != 0
+            || fresh.remote_button_timeout_ms != config.remote_button_timeout_ms
+            || strcmp(fresh.ikbd_device, config.ikbd_device) != 0
+            || memcmp(&fresh.joystick, &config.joystick, sizeof(fresh.joystick)) != 0) {
+        INFO_PRINT("Device, GPIO chip, precision, control socket, stall threshold, output, remote input, serial device and joystick changes apply at the next restart\n");
+    }
+    snprintf(fresh.device_path, sizeof(fresh.device_path), "%s", config.device_path);
+    snprintf(fresh.gpio_chip, sizeof(fresh.gpio_chip), "%s", config.gpio_chip);
+    fresh.precision = config.precision;
+    fresh.spin_us = config.spin_us;
+    fresh.precision_cpu = config.precision_cpu;
+    snprintf(fresh.control_socket, sizeof(fresh.control_socket), "%s", config.control_socket);
+    fresh.stall_us = config.stall_us;
+    memcpy(fresh.outputs, config.outputs, sizeof(fresh.outputs));
+    fresh.num_outputs = config.num_outputs;
+    snprintf(fresh.remote_listen, sizeof(fresh.remote_listen), "%s", config.remote_listen);
+    fresh.remote_button_timeout_ms = config.remote_button_timeout_ms;
+    snprintf(fresh.ikbd_device, sizeof(fresh.ikbd_device), "%s", config.ikbd_device);
+    fresh.joystick = config.joystick;
+
+    // The profile of the open device applies over the new settings
+    char description[320];
+    save_base_settings(&fresh);
+    profile_index = identify_device(fd, &fresh, description, sizeof(description));
+    apply_profile(&fresh, profile_index);
+
+    int moved = publish_configuration(&fresh, state);
+    mouse_event_select_profile(profile_index);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    watchdog_notify("READY=1");
+    INFO_PRINT("Configuration reloaded in %ld us (curve %s, pacing %s, %d lines moved)\n",
+        (long)((end.tv_sec - start.tv_sec) * 1000000L + (end.tv_nsec - start.tv_nsec) / 1000L),
+        active_curve()->name, pacing_name(config.pacing), moved);
+}
+
+// Hand the device and lines to a restarting instance, once the output is idle
+static int hand_over(int fd, quadrature_state_t *state) {
+    handoff_requested = 0;
+
+    // The receiver thread cannot be passed on: the new instance stops this one
+    if (remote_active()) {
+        INFO_PRINT("Remote input cannot be handed over\n");
+        return -1;
+    }
+    if (output_backend == OUTPUT_IKBD) {
+        INFO_PRINT("The serial output cannot be handed over\n");
+        return -1;
+    }
 
-        case EV_SYN:
-            // Synchronization event, no action needed
-            break;
+    // Emit what is queued; no read-ahead, so no event is left behind
+    button_lane_attach(-1, NULL);
+    frame_flush(state);
+    tick_flush();
+    tick_stop();
+
+    // The new instance binds the same control socket and requests the same extra lines
+    control_cleanup();
+    outputs_stop();
+    joystick_stop();
+
+    if (handoff_send(fd, config.device_path, state, calibrated ? &calibration : NULL) == 0) {
+        handed_off = 1;
+        INFO_PRINT("Output handed over to the new instance\n");
+        return 0;
+    }
+
+    // Keep running as before
+    button_lane_attach(fd, state);
+    if (config.pacing == PACING_TICK && tick_start(state, config.tick_us) < 0) {
+        ERROR_PRINT("Cannot restart the fixed-rate output, using burst pacing\n");
+        config.pacing = PACING_BURST;
+    }
+    if (config.control_socket[0] != '\0') {
+        control_init(config.control_socket);
     }
+    if (outputs_start(&config) < 0) {
+        ERROR_PRINT("Cannot restart the additional outputs\n");
+    }
+    if (joystick_start(&config.joystick) < 0) {
+        ERROR_PRINT("Cannot restart the joystick output\n");
+    }
+    return -1;
+}
+
+// Feed a replayed event to the processing pipeline
+static void replay_handler(struct input_event *ie, void *ctx) {
+    // Real hardware runs in real time: stamp the event as the kernel would
+    if (output_backend != OUTPUT_NULL) {
+        uint64_t now = event_clock_ns();
+        ie->time.tv_sec = (time_t)(now / 1000000000ULL);
+        ie->time.tv_usec = (suseconds_t)(now % 1000000000ULL / 1000ULL);
+    }
+    process_mouse_event(ie, (quadrature_state_t *)ctx, config.sensitivity);
 }
 
 
@@ -225,21 +661,40 @@ void process_mouse_event(struct input_event *ie, quadrature_state_t *state, int
  * @brief Main program entry point.
  */
 int main(int argc, char *argv[]) {
+    start_ns = monotonic_ns();
+
     // Set default configuration
     config = default_config;
 
-    int fd;
+    int fd = -1;
     struct input_event ie;
     quadrature_state_t quad_state = {0, 0, 0, 0, 0, 0};
     ssize_t bytes_read;
     
     int opt;
     char *config_file = "/etc/atari_rpi/atari_usb_mouse.json";
-    int sensitivity = DEFAULT_SENSITIVITY;
-    int pin_xa, pin_xb, pin_ya, pin_yb, pin_bleft, pin_bright;
-    pin_xa = pin_xb = pin_ya = pin_yb = pin_bleft = pin_bright = -1;
-    char *mouse_device = NULL;
     int view_config = 0;
+    unsigned int monitor_interval = 0;
+    char *record_file = NULL;
+    char *send_target = NULL;
+    char *replay_file = NULL;
+    int replay_uinput = 0;
+    double replay_speed = 1.0;
+    char *edge_trace_file = NULL;
+    char *vcd_file = NULL;
+    int gpio_sim_check = 0;
+    char *ikbd_trace = NULL;
+    stress_params_t stress = { -1, STRESS_DEFAULT_RATE, STRESS_DEFAULT_SECONDS };
+    int calibrate_mode = 0;
+    int restart_mode = 0;
+    pid_t restart_pid = 0;
+    int auto_detect = 0;
+    int ready = 0;
+    int first_pulse_reported = 0;
+    handoff_state_t handoff;
+    int handoff_ok = 0;
+    int line_fd = -1;
+    ikbd_params_t ikbd_params = { IKBD_SAMPLE_US, 0, -1 };
 
     // getopt_long options
     static struct option long_options[] = {
@@ -248,7 +703,7 @@ int main(int argc, char *argv[]) {
         {"debug",       no_argument,       0, 'd'},
         {"device",      required_argument, 0, 'D'},
         {"kill",        no_argument,       0, 'k'},
-        {"monitor",     no_argument,       0, 'm'},
+        {"monitor",     optional_argument, 0, 'm'},
         {"pidfile",     required_argument, 0, 'p'},
         {"restart",     no_argument,       0, 'r'},
         {"sensitivity", required_argument, 0, 's'},
@@ -259,17 +714,45 @@ int main(int argc, char *argv[]) {
         {"pin-yb",      required_argument, 0, 1004},
         {"pin-left",    required_argument, 0, 1005},
         {"pin-right",   required_argument, 0, 1006},
+        {"monitor-interval", required_argument, 0, 1007},
+        {"record",      required_argument, 0, 1008},
+        {"replay",      required_argument, 0, 1009},
+        {"replay-uinput", no_argument,     0, 1010},
+        {"replay-speed", required_argument, 0, 1011},
+        {"output",      required_argument, 0, 1012},
+        {"edge-trace",  required_argument, 0, 1013},
+        {"bench",       no_argument,       0, 1014},
+        {"gpio-chip",   required_argument, 0, 1015},
+        {"gpio-sim-check", no_argument,    0, 1016},
+        {"ikbd-model",  required_argument, 0, 1017},
+        {"ikbd-sample-us", required_argument, 0, 1018},
+        {"ikbd-jitter-us", required_argument, 0, 1019},
+        {"ikbd-max-error", required_argument, 0, 1020},
+        {"curve",       required_argument, 0, 1021},
+        {"pacing",      required_argument, 0, 1022},
+        {"tick-us",     required_argument, 0, 1023},
+        {"precision",   no_argument,       0, 1024},
+        {"spin-us",     required_argument, 0, 1025},
+        {"precision-cpu", required_argument, 0, 1026},
+        {"calibrate",   no_argument,       0, 1027},
+        {"control",     required_argument, 0, 1028},
+        {"stall-us",    required_argument, 0, 1029},
+        {"udp-listen",  required_argument, 0, 1030},
+        {"udp-send",    required_argument, 0, 1031},
+        {"ikbd-tty",    required_argument, 0, 1032},
+        {"vcd",         required_argument, 0, 1033},
+        {"stress",      required_argument, 0, 1034},
+        {"stress-rate", required_argument, 0, 1035},
+        {"stress-seconds", required_argument, 0, 1036},
         {"version",     no_argument      , 0, 'v'},
         {"help",        no_argument,       0, 'h'},
         {0, 0, 0, 0}
     };
     
-    INFO_PRINT("Atari ST mouse simulator\n");
-
     // Signal handlers
     signal(SIGINT, signal_handler);   // Ctrl+C
     signal(SIGTERM, signal_handler);  // Terminaison
-    signal(SIGHUP, signal_handler);   // Hangup
+    install_reload_handler();         // Hangup: reload configuration
 
     // Set cleanup function for atexit
     atexit(cleanup);
@@ -288,62 +771,208 @@ int main(int argc, char *argv[]) {
                 DEBUG_PRINT("Debug mode enabled\n");
                 break;
             case 'D':
-                mouse_device = optarg;
+                overrides.mouse_device = optarg;
                 break;
             case 'm':
-                monitor_mode = 1;
+                if (optarg == NULL || strcmp(optarg, "ansi") == 0) {
+                    monitor_mode = MONITOR_ANSI;
+                } else if (strcmp(optarg, "jsonl") == 0) {
+                    monitor_mode = MONITOR_JSONL;
+                } else {
+                    ERROR_PRINT("Unknown monitor mode: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
                 DEBUG_PRINT("Monitor mode enabled\n");
                 break;
+            case 1007: // --monitor-interval
+                if (atoi(optarg) < 0) {
+                    ERROR_PRINT("Monitor interval must be >= 0\n");
+                    exit(EXIT_FAILURE);
+                }
+                monitor_interval = atoi(optarg);
+                break;
+            case 1008: // --record
+                record_file = optarg;
+                break;
+            case 1009: // --replay
+                replay_file = optarg;
+                break;
+            case 1010: // --replay-uinput
+                replay_uinput = 1;
+                break;
+            case 1011: // --replay-speed
+                replay_speed = (strcmp(optarg, "max") == 0) ? 0 : atof(optarg);
+                if (replay_speed < 0) {
+                    ERROR_PRINT("Replay speed must be >= 0\n");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 1012: // --output
+                if (strcmp(optarg, "gpio") == 0) {
+                    output_backend = OUTPUT_GPIO;
+                } else if (strcmp(optarg, "null") == 0) {
+                    output_backend = OUTPUT_NULL;
+                } else if (strcmp(optarg, "ikbd") == 0) {
+                    output_backend = OUTPUT_IKBD;
+                } else {
+                    ERROR_PRINT("Unknown output backend: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 1013: // --edge-trace
+                edge_trace_file = optarg;
+                break;
+            case 1014: // --bench
+                bench_mode = 1;
+                break;
+            case 1015: // --gpio-chip
+                overrides.gpio_chip = optarg;
+                break;
+            case 1016: // --gpio-sim-check
+                gpio_sim_check = 1;
+                break;
+            case 1017: // --ikbd-model
+                ikbd_trace = optarg;
+                break;
+            case 1018: // --ikbd-sample-us
+                if (atoi(optarg) < 1) {
+                    ERROR_PRINT("IKBD sample interval must be >= 1\n");
+                    exit(EXIT_FAILURE);
+                }
+                ikbd_params.sample_us = atoi(optarg);
+                break;
+            case 1019: // --ikbd-jitter-us
+                if (atoi(optarg) < 0) {
+                    ERROR_PRINT("IKBD sample jitter must be >= 0\n");
+                    exit(EXIT_FAILURE);
+                }
+                ikbd_params.jitter_us = atoi(optarg);
+                break;
+            case 1020: // --ikbd-max-error
+                ikbd_params.max_error = atol(optarg);
+                break;
+            case 1021: // --curve
+                overrides.curve_name = optarg;
+                break;
+            case 1022: // --pacing
+                overrides.pacing = parse_pacing(optarg);
+                if (overrides.pacing < 0) {
+                    ERROR_PRINT("Unknown pacing %s (burst, tick or frame)\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 1023: // --tick-us
+                overrides.tick_us = atoi(optarg);
+                break;
+            case 1024: // --precision
+                overrides.precision = 1;
+                break;
+            case 1025: // --spin-us
+                overrides.spin_us = atoi(optarg);
+                if (overrides.spin_us < 0) {
+                    ERROR_PRINT("Spin window must be >= 0\n");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 1026: // --precision-cpu
+                overrides.precision_cpu = atoi(optarg);
+                break;
+            case 1027: // --calibrate
+                calibrate_mode = 1;
+                break;
+            case 1028: // --control
+                overrides.control_socket = optarg;
+                break;
+            case 1029: // --stall-us
+                overrides.stall_us = atoi(optarg);
+                if (overrides.stall_us < 0) {
+                    ERROR_PRINT("Stall threshold must be positive or 0\n");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 1030: // --udp-listen
+                overrides.remote_listen = optarg;
+                break;
+            case 1031: // --udp-send
+                send_target = optarg;
+                break;
+            case 1032: // --ikbd-tty
+                overrides.ikbd_device = optarg;
+                break;
+            case 1033: // --vcd
+                vcd_file = optarg;
+                break;
+            case 1034: // --stress
+                stress.pattern = parse_stress_pattern(optarg);
+                if (stress.pattern < 0) {
+                    ERROR_PRINT("Unknown stress pattern %s (constant, circle, flick, jitter or buttons)\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 1035: // --stress-rate
+                stress.rate_hz = atoi(optarg);
+                if (stress.rate_hz < 1 || stress.rate_hz > STRESS_MAX_RATE) {
+                    ERROR_PRINT("Stress rate must be between 1 and %d frames/s\n", STRESS_MAX_RATE);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 1036: // --stress-seconds
+                stress.seconds = atoi(optarg);
+                if (stress.seconds < 1) {
+                    ERROR_PRINT("Stress duration must be >= 1 s\n");
+                    exit(EXIT_FAILURE);
+                }
+                break;
             case 's':
-                sensitivity = atoi(optarg);
-                if (sensitivity < 1) {
+                overrides.sensitivity = atoi(optarg);
+                if (overrides.sensitivity < 1) {
                     ERROR_PRINT("Sensitivity must be >= 1\n");
                     exit(EXIT_FAILURE);
                 }
                 break;
             case 1001: // --pin-xa
-                pin_xa = atoi(optarg);
-                if (pin_xa < 0 || pin_xa > 40) {
+                overrides.pin_xa = atoi(optarg);
+                if (overrides.pin_xa < 0 || overrides.pin_xa > 40) {
                     ERROR_PRINT("Pin XA must be between 0 et 40\n");
                     exit(EXIT_FAILURE);
                 }
                 INFO_PRINT("XA pin set to : %d\n", config.pin_xa);
                 break;
             case 1002: // --pin-xb
-                pin_xb = atoi(optarg);
-                if (pin_xb < 0 || pin_xb > 40) {
+                overrides.pin_xb = atoi(optarg);
+                if (overrides.pin_xb < 0 || overrides.pin_xb > 40) {
                     ERROR_PRINT("Pin XB must be between 0 et 40\n");
                     exit(EXIT_FAILURE);
                 }
                 INFO_PRINT("XB pin set to : %d\n", config.pin_xb);
                 break;
             case 1003: // --pin-ya
-                pin_ya = atoi(optarg);
-                if (pin_ya < 0 || pin_ya > 40) {
+                overrides.pin_ya = atoi(optarg);
+                if (overrides.pin_ya < 0 || overrides.pin_ya > 40) {
                     ERROR_PRINT("Pin YA must be between 0 et 40\n");
                     exit(EXIT_FAILURE);
                 }
                 INFO_PRINT("YA pin set to : %d\n", config.pin_ya);
                 break;
             case 1004: // --pin-yb
-                pin_yb = atoi(optarg);
-                if (pin_yb < 0 || pin_yb > 40) {
+                overrides.pin_yb = atoi(optarg);
+                if (overrides.pin_yb < 0 || overrides.pin_yb > 40) {
                     ERROR_PRINT("Pin YB must be between 0 et 40\n");
                     exit(EXIT_FAILURE);
                 }
                 INFO_PRINT("YB pin set to : %d\n", config.pin_yb);
                 break;
             case 1005: // --pin-left
-                pin_bleft = atoi(optarg);
-                if (pin_bleft < 0 || pin_bleft > 40) {
+                overrides.pin_bleft = atoi(optarg);
+                if (overrides.pin_bleft < 0 || overrides.pin_bleft > 40) {
                     ERROR_PRINT("Pin left button must be between 0 et 40\n");
                     exit(EXIT_FAILURE);
                 }
                 INFO_PRINT("Left button pin set to : %d\n", config.pin_left_button);
                 break;
             case 1006: // --pin-right
-                pin_bright = atoi(optarg);
-                if (pin_bright < 0 || pin_bright > 40) {
+                overrides.pin_bright = atoi(optarg);
+                if (overrides.pin_bright < 0 || overrides.pin_bright > 40) {
                     ERROR_PRINT("Pin right button must be between 0 et 40\n");
                     exit(EXIT_FAILURE);
                 }
@@ -351,7 +980,7 @@ int main(int argc, char *argv[]) {
                 break;
             case 'b':
                 daemon_mode = 1;
-                monitor_mode = 0; // Incompatible avec le mode daemon
+                monitor_mode = MONITOR_OFF; // Incompatible avec le mode daemon
                 DEBUG_PRINT("Daemon mode enabled\n");
                 break;
             case 'k':
@@ -375,17 +1004,11 @@ int main(int argc, char *argv[]) {
                 pidfile_path = optarg;
                 break;
             case 'r':
-                {
-                    pid_t running_pid = check_running_daemon();
-                    if (running_pid > 0) {
-                        printf("Restart daemon (PID: %d)...\n", running_pid);
-                        kill(running_pid, SIGTERM);
-                        sleep(2); // Wait termination 
-                    }
-                    daemon_mode = 1;
-                    monitor_mode = 0;
-                    DEBUG_PRINT("Restart daemon mode\n");
-                }
+                // The running daemon is looked up once the PID file path is known
+                restart_mode = 1;
+                daemon_mode = 1;
+                monitor_mode = MONITOR_OFF;
+                DEBUG_PRINT("Restart daemon mode\n");
                 break;
             case 't':
                 {
@@ -413,6 +1036,10 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    // The JSON-lines feed and the benchmark results must be the only writers of stdout
+    stdout_reserved = (monitor_mode == MONITOR_JSONL || bench_mode);
+    INFO_PRINT("Atari ST mouse simulator\n");
+
     // Load configuration
     DEBUG_PRINT("Loading configuration from %s...\n", config_file);
     if (load_config(config_file, &config) < 0) {
@@ -421,37 +1048,50 @@ int main(int argc, char *argv[]) {
     }
 
     // Set config with options
-    if (pin_xa != -1) {
-        config.pin_xa = pin_xa;
-        DEBUG_PRINT("Setting pin_xa=%d from command line\n", config.pin_xa);
-    }
-    if (pin_xb != -1) {
-        config.pin_xb = pin_xb;
-        DEBUG_PRINT("Setting pin_xb=%d from command line\n", config.pin_xb);
+    if (apply_overrides(&config) < 0) {
+        exit(EXIT_FAILURE);
     }
-    if (pin_ya != -1) {
-        config.pin_ya = pin_ya;
-        DEBUG_PRINT("Setting pin_ya=%d from command line\n", config.pin_ya);
+
+    // Receiver model: analyse an edge trace, no device or GPIO involved
+    if (ikbd_trace != NULL) {
+        int result = run_ikbd_model(ikbd_trace, &ikbd_params);
+        exit(result < 0 ? EXIT_FAILURE : result);
     }
-    if (pin_yb != -1) {
-        config.pin_yb = pin_yb;
-        DEBUG_PRINT("Setting pin_yb=%d from command line\n", config.pin_yb);
+
+    // End-to-end harness: runs another instance of this binary on a simulated chip
+    if (gpio_sim_check) {
+        exit(run_gpio_sim_check());
     }
-    if (pin_bleft != -1) {
-        config.pin_left_button = pin_bleft;
-        DEBUG_PRINT("Setting pin_left_button=%d from command line\n", config.pin_left_button);
+
+    // Stress generator: same, with a synthetic traffic pattern and no output check
+    if (stress.pattern >= 0) {
+        exit(run_stress(config_file, &stress) < 0 ? EXIT_FAILURE : EXIT_SUCCESS);
     }
-    if (pin_bright != -1) {
-        config.pin_right_button = pin_bright;
-        DEBUG_PRINT("Setting pin_right_button=%d from command line\n", config.pin_right_button);
+
+    // Benchmarks run the pipeline with GPIO writes stubbed out
+    if (bench_mode) {
+        output_backend = OUTPUT_NULL;
+        init_gpio();
+        exit(run_benchmarks(replay_file) < 0 ? EXIT_FAILURE : EXIT_SUCCESS);
     }
-    if (sensitivity != DEFAULT_SENSITIVITY) {
-        config.sensitivity = sensitivity;
-        DEBUG_PRINT("Setting sensitivity=%d from command line\n", config.sensitivity);
+
+    // Calibration: measure the output path, save the derived curve and exit
+    if (calibrate_mode) {
+        calibration_t cal;
+        if (init_gpio() < 0 || calibrate_measure(&quad_state, &cal) < 0) {
+            exit(EXIT_FAILURE);
+        }
+        calibrate_print(&cal);
+        if (calibrate_save(&cal, config_file) < 0) {
+            exit(EXIT_FAILURE);
+        }
+        INFO_PRINT("Calibration saved to %s\n", config_file);
+        exit(EXIT_SUCCESS);
     }
-    if (mouse_device != NULL ) {
-        snprintf(config.device_path, sizeof(config.device_path), "%s", mouse_device);
-        DEBUG_PRINT("Setting device_path=%s from command line\n", config.device_path);
+
+    // Replay through a virtual mouse: the daemon under test reads it like a real device
+    if (replay_file != NULL && replay_uinput) {
+        exit(replay_to_uinput(replay_file, replay_speed) < 0 ? EXIT_FAILURE : EXIT_SUCCESS);
     }
 
     // Check daemon mode requirements
@@ -463,7 +1103,10 @@ int main(int argc, char *argv[]) {
         
         // Check if daemon is running
         pid_t running_pid = check_running_daemon();
-        if (running_pid > 0) {
+        if (restart_mode && running_pid > 0) {
+            printf("Restart daemon (PID: %d)...\n", running_pid);
+            restart_pid = running_pid;
+        } else if (running_pid > 0) {
             ERROR_PRINT("Daemon already runnong (PID: %d)\n", running_pid);
             exit(EXIT_FAILURE);
         }
@@ -472,6 +1115,16 @@ int main(int argc, char *argv[]) {
         if (daemonize() < 0) {
             exit(EXIT_FAILURE);
         }
+
+        // Take the device and lines over from the running daemon, or stop it
+        if (restart_pid > 0) {
+            if (handoff_receive(restart_pid, &handoff, &fd, &line_fd) == 0) {
+                handoff_ok = 1;
+                snprintf(config.device_path, sizeof(config.device_path), "%s", handoff.device_path);
+            } else {
+                stop_previous(restart_pid);
+            }
+        }
         
         // Create PID file
         if (create_pidfile() < 0) {
@@ -479,49 +1132,173 @@ int main(int argc, char *argv[]) {
         }
         
         INFO_PRINT("Daemon started (PID: %d)\n", getpid());
+
+        // daemonize() ignores SIGHUP while detaching
+        install_reload_handler();
     }
 
-    // Get mouse device
-    if (config.device_path[0] == '\0') {
-        INFO_PRINT("Auto detect mouse device...\n");
-        char *detected_device = wait_for_mouse_device();
-        if (detected_device == NULL) {
-            DEBUG_PRINT("Stop while searching device\n");
-            exit(EXIT_SUCCESS);
-        } else {
+    // Showing the configuration, recording and forwarding need the device, not the lines
+    if (view_config || record_file != NULL || send_target != NULL) {
+        if (config.device_path[0] == '\0') {
+            INFO_PRINT("Auto detect mouse device...\n");
+            char *detected_device = wait_for_mouse_device();
+            if (detected_device == NULL) {
+                DEBUG_PRINT("Stop while searching device\n");
+                exit(EXIT_SUCCESS);
+            }
             snprintf(config.device_path, sizeof(config.device_path), "%s", detected_device);
         }
-    }
 
-    // Show configuration
-    if (view_config) {
-        printf("Configuration :\n");
-        print_config();
-        exit(0);
+        // Show configuration
+        if (view_config) {
+            printf("Configuration :\n");
+            print_config();
+            exit(0);
+        }
+
+        // Sender mode: forward the device to a remote instance
+        if (send_target != NULL) {
+            exit(remote_forward(config.device_path, send_target) < 0 ? EXIT_FAILURE : EXIT_SUCCESS);
+        }
+
+        // Record mode: capture the device event stream, no GPIO involved
+        exit(record_events(config.device_path, record_file) < 0 ? EXIT_FAILURE : EXIT_SUCCESS);
     }
 
-    // Open mouse event file
-    if ((fd = open(config.device_path, O_RDONLY | O_NONBLOCK)) == -1) {
-        ERROR_PRINT("Cannot open file %s: %s\n", config.device_path, strerror(errno));
+    // Look for the device in the background: the lines must not float meanwhile
+    auto_detect = (config.device_path[0] == '\0' && config.remote_listen[0] == '\0');
+    if (replay_file == NULL && fd == -1 && config.remote_listen[0] == '\0' && discovery_start(config.device_path) < 0) {
         exit(EXIT_FAILURE);
     }
-    DEBUG_PRINT("Device %s opened\n", config.device_path);
-    
+
     // Init GPIO
     DEBUG_PRINT("Initialisation of PIO ports...\n");
-    if (init_gpio() < 0) {
+    if (handoff_ok) {
+        // The lines keep their levels, and the next edge continues the phases
+        if (adopt_gpio_lines(line_fd, handoff.line_offsets, handoff.line_levels) < 0) {
+            exit(EXIT_FAILURE);
+        }
+        quad_state = handoff.quad;
+
+        INFO_PRINT("Output taken over from PID %d in %ld us\n", restart_pid,
+            (long)((monotonic_ns() - handoff.sent_ns) / 1000ULL));
+
+        // Pins changed in the configuration since the previous start
+        if (reconfigure_gpio_lines() < 0) {
+            ERROR_PRINT("Cannot request the new GPIO pins, keeping the current ones\n");
+        }
+    } else if (init_gpio() < 0) {
         cleanup_gpio();
         exit(EXIT_FAILURE);
     }
 
+    // IKBD backend: packets on the keyboard line replace the quadrature lines
+    if (output_backend == OUTPUT_IKBD && ikbd_serial_open(config.ikbd_device) < 0) {
+        exit(EXIT_FAILURE);
+    }
+    DEBUG_PRINT("Lines driven %ld us after start\n", (long)((monotonic_ns() - start_ns) / 1000ULL));
+
+    // Trace line transitions if requested
+    if (edge_trace_file != NULL && open_edge_trace(edge_trace_file) < 0) {
+        exit(EXIT_FAILURE);
+    }
+    if (vcd_file != NULL && open_vcd_dump(vcd_file) < 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    // Startup calibration: replaces the edge periods before the first edge
+    if (config.calibrate_at_startup && handoff_ok && handoff.calibrated) {
+        // Same board: reuse the measurements instead of toggling the lines
+        calibration = handoff.calibration;
+        if (calibrate_apply(&calibration, &config) < 0) {
+            exit(EXIT_FAILURE);
+        }
+        calibrated = 1;
+    } else if (config.calibrate_at_startup) {
+        if (calibrate_measure(&quad_state, &calibration) < 0 || calibrate_apply(&calibration, &config) < 0) {
+            exit(EXIT_FAILURE);
+        }
+        calibrated = 1;
+        INFO_PRINT("Calibrated edge period: %d us to %d us\n", calibration.max_delay_us, calibration.min_delay_us);
+    }
+
+    // Motion filter chains, before the first event
+    mouse_event_configure(&config);
+    save_base_settings(&config);
+
+    // Additional outputs and the joystick port
+    if (replay_file == NULL && outputs_start(&config) < 0) {
+        exit(EXIT_FAILURE);
+    }
+    if (replay_file == NULL && joystick_start(&config.joystick) < 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    // Precision emitter: pin and lock memory before the first edge
+    if (config.precision && precision_init(config.spin_us, config.precision_cpu) < 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    // Fixed-rate output: events only queue motion, the ticker emits it
+    if (config.pacing == PACING_TICK && tick_start(&quad_state, config.tick_us) < 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    // Control socket for live tuning
+    if (config.control_socket[0] != '\0' && control_init(config.control_socket) < 0) {
+        exit(EXIT_FAILURE);
+    }
+
     // Init screen if monitor mode is enable
-    if (monitor_mode) {
+    if (monitor_mode == MONITOR_ANSI) {
         printf(HIDE_CURSOR);
         printf(CLEAR_SCREEN);
-        get_current_time(stats.last_event_time, sizeof(stats.last_event_time));
         display_monitor_status(&quad_state);
     }
+
+    // Init telemetry feed if JSON-lines monitor is enable
+    if (monitor_mode == MONITOR_JSONL && telemetry_init(monitor_interval) < 0) {
+        exit(EXIT_FAILURE);
+    }
         
+    // Replay mode: feed the recording to the pipeline instead of a device
+    if (replay_file != NULL) {
+        long replayed = replay_events(replay_file, replay_speed, replay_handler, &quad_state);
+        if (replayed < 0) {
+            exit(EXIT_FAILURE);
+        }
+        tick_flush();
+        frame_flush(&quad_state);
+        ikbd_serial_flush();
+        if (!monitor_mode) {
+            INFO_PRINT("%ld events replayed\n", replayed);
+        }
+        return 0;
+    }
+
+    // Device opened in the background, or searched by the event loop
+    int found_fd = discovery_join(config.device_path, sizeof(config.device_path));
+    if (found_fd >= 0) {
+        fd = found_fd;
+        DEBUG_PRINT("Device %s opened\n", config.device_path);
+    }
+
+    // Remote input: the receiver pipe stands for the device
+    if (config.remote_listen[0] != '\0') {
+        if (fd >= 0) {
+            close(fd);
+        }
+        fd = remote_start(config.remote_listen, config.remote_button_timeout_ms);
+        if (fd < 0) {
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Stall detection and systemd watchdog, for the live pipeline only
+    if (watchdog_init(config.stall_us) < 0) {
+        exit(EXIT_FAILURE);
+    }
+
     // Main loop
     if (!monitor_mode) {
         INFO_PRINT("Waiting mouse events...\n");
@@ -529,8 +1306,13 @@ int main(int argc, char *argv[]) {
 
     while (running) {
         // open/re-open device file
-        if ((fd = open(config.device_path, O_RDONLY | O_NONBLOCK)) == -1) {
-            INFO_PRINT("Cannot open device %s : %s\n", config.device_path, strerror(errno));
+        if (fd == -1 && config.device_path[0] != '\0') {
+            fd = open(config.device_path, O_RDONLY | O_NONBLOCK);
+            if (fd == -1) {
+                INFO_PRINT("Cannot open device %s : %s\n", config.device_path, strerror(errno));
+            }
+        }
+        if (fd == -1) {
             INFO_PRINT("Looking for new mouse device...\n");
             
             char *new_device = wait_for_mouse_device();
@@ -543,20 +1325,83 @@ int main(int argc, char *argv[]) {
             INFO_PRINT("New device detected : %s\n", config.device_path);
             continue;
         }
+
+        // Monotonic timestamps share the output clock and ignore wall clock steps
+        event_clock_set_monotonic(remote_active() || set_monotonic_timestamps(fd) == 0);
+
+        // Buttons pressed during pulse trains are applied without waiting for them
+        button_lane_attach(fd, &quad_state);
+        mouse_event_attach(fd);
+        select_profile(fd, &quad_state);
+
+        // Start the next run from this device
+        if (auto_detect) {
+            cache_mouse_device(config.device_path);
+        }
+
+        // Lines and device are live: systemd can consider the service started
+        if (!ready) {
+            struct timespec boot;
+            clock_gettime(CLOCK_BOOTTIME, &boot);
+            if (!monitor_mode) {
+                INFO_PRINT("Ready %ld us after start (%ld ms after boot)\n", (long)((monotonic_ns() - start_ns) / 1000ULL),
+                    (long)(boot.tv_sec * 1000L + boot.tv_nsec / 1000000L));
+            }
+            output_watch_first_edge();
+            ready = 1;
+        }
+        char state[sizeof(config.device_path) + 64];
+        snprintf(state, sizeof(state), "READY=1\nMAINPID=%d\nSTATUS=Forwarding %s%s", (int)getpid(),
+            remote_active() ? "udp:" : "", remote_active() ? config.remote_listen : config.device_path);
+        watchdog_notify(state);
         
         // Reading loop for this device
+        int mid_frame = 0;
         while (running) {
             fd_set readfds;
             struct timeval timeout;
+
+            // Reload between frames, so no frame mixes two configurations
+            if (reload_requested && !mid_frame) {
+                reload_configuration(config_file, fd, &quad_state);
+            }
+
+            // Events read ahead by the button lane come first
+            if (button_lane_pop(&ie)) {
+                process_mouse_event(&ie, &quad_state, config.sensitivity);
+                mid_frame = (ie.type != EV_SYN);
+                continue;
+            }
+
+            // Hand over between frames, once the events read ahead are processed
+            if (handoff_requested && !mid_frame && hand_over(fd, &quad_state) == 0) {
+                running = 0;
+                break;
+            }
     
             FD_ZERO(&readfds);
             FD_SET(fd, &readfds);
+
+            // Control commands only run between frames
+            int max_fd = mid_frame ? fd : control_fill_fds(&readfds, fd);
+            max_fd = outputs_fill_fds(&readfds, max_fd);
     
             // 50ms timeout to check running flag
             timeout.tv_sec = 0;
             timeout.tv_usec = 50000;
     
-            int select_result = select(fd + 1, &readfds, NULL, NULL, &timeout);
+            // Boot latency: first output after start, reported once
+            if (!first_pulse_reported && output_first_edge_ns() != 0) {
+                if (!monitor_mode) {
+                    INFO_PRINT("First pulse %ld us after start\n", (long)((output_first_edge_ns() - start_ns) / 1000ULL));
+                }
+                first_pulse_reported = 1;
+            }
+
+            stall_leave(STAGE_INPUT);
+            watchdog_ping();
+            int select_result = select(max_fd + 1, &readfds, NULL, NULL, &timeout);
+            stall_enter(STAGE_INPUT);
     
             if (select_result == -1) {
                 if (errno == EINTR) {
@@ -567,9 +1412,19 @@ int main(int argc, char *argv[]) {
             }
     
             if (select_result == 0) {
-                // Timeout - continue to check running
+                // Timeout - drain telemetry and continue to check running
+                if (monitor_mode == MONITOR_JSONL) {
+                    telemetry_flush();
+                }
+                // Input idle: emit steps carried over by frame pacing
+                frame_flush(&quad_state);
                 continue;
             }
+
+            if (!mid_frame) {
+                control_service(&readfds, control_publish, &quad_state);
+            }
+            outputs_service(&readfds);
     
             if (FD_ISSET(fd, &readfds)) {
                 bytes_read = read(fd, &ie, sizeof(struct input_event));
@@ -609,10 +1464,14 @@ int main(int argc, char *argv[]) {
     
                 // Process event
                 process_mouse_event(&ie, &quad_state, config.sensitivity);
+                mid_frame = (ie.type != EV_SYN);
             }
         }
         
         // Close fd if open
+        button_lane_attach(-1, NULL);
+        mouse_event_attach(-1);
+        stall_leave(STAGE_INPUT);
         if (fd != -1) {
             close(fd);
             fd = -1;
@@ -621,6 +1480,7 @@ int main(int argc, char *argv[]) {
         // If we are here and running is true, device probably disconnected
         if (running) {
             INFO_PRINT("Looking for new mouse device...\n");
+            watchdog_notify("STATUS=Waiting for a mouse");
         }
     }
 
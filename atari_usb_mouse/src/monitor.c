@@ -3,11 +3,13 @@
  * @brief Provides monitoring and display for GPIO and mouse events.
  */
 
+#define _POSIX_C_SOURCE 200809L
 
 #include <stdio.h>
 #include <time.h>
 
 #include "monitor.h"
+#include "latency.h"
 #include "global.h"
 
 
@@ -16,7 +18,10 @@ monitor_stats_t stats = {0};
 
 // Displays the current quadrature and mouse status.
 void display_monitor_status(quadrature_state_t *state) {
-	if (!monitor_mode) return;
+	if (monitor_mode != MONITOR_ANSI) return;
+
+	char last_event_time[16];
+	format_event_time(stats.last_event_ns, last_event_time, sizeof(last_event_time));
 	
 	printf(SAVE_CURSOR);
 	printf(CURSOR_HOME);
@@ -42,7 +47,14 @@ void display_monitor_status(quadrature_state_t *state) {
 	printf("│ Last X movement: \033[33m%+4d\033[0m           Last Y movement: \033[33m%+4d\033[0m                        │\n", 
 		   stats.last_x_delta, stats.last_y_delta);
 	printf("│ Last activity: \033[35m%s\033[0m                                                      │\n", 
-		   stats.last_event_time);
+		   last_event_time);
+	printf("│ Polling rate: \033[35m%4u Hz\033[0m        Frame interval: \033[35m%5u us\033[0m                        │\n",
+		   stats.polling_rate_hz, stats.frame_interval_us);
+	printf("│ Latency p50/p99   buttons: \033[35m%5llu/%5llu us\033[0m     motion: \033[35m%5llu/%5llu us\033[0m         │\n",
+		   (unsigned long long)latency_percentile(&button_latency, 50),
+		   (unsigned long long)latency_percentile(&button_latency, 99),
+		   (unsigned long long)latency_percentile(&motion_latency, 50),
+		   (unsigned long long)latency_percentile(&motion_latency, 99));
 	printf("└──────────────────────────────────────────────────────────────────────────────┘\n");
 	
 	printf("\n\033[33mPress Ctrl+C to quit\033[0m\n");
@@ -53,18 +65,27 @@ void display_monitor_status(quadrature_state_t *state) {
 
 // Restores the screen or terminal to its original state.
 void cleanup_screen() {
-	if (monitor_mode) {
+	if (monitor_mode == MONITOR_ANSI) {
 		printf(SHOW_CURSOR);
 		printf("\n");
 	}
 }
 
-// Fills a buffer with the current time as a formatted string.
-void get_current_time(char *buffer, size_t size) {
-	time_t now;
-	struct tm *tm_info;
-	
-	time(&now);
-	tm_info = localtime(&now);
-	strftime(buffer, size, "%H:%M:%S", tm_info);
+// Formats an event clock timestamp as local wall clock time.
+void format_event_time(uint64_t event_ns, char *buffer, size_t size) {
+	if (event_ns == 0) {
+		snprintf(buffer, size, "--:--:--");
+		return;
+	}
+
+	// Event timestamps are on the event clock: go back from the current wall time
+	struct timespec wall;
+	clock_gettime(CLOCK_REALTIME, &wall);
+	uint64_t now = event_clock_ns();
+	uint64_t age_s = (now > event_ns) ? (now - event_ns) / 1000000000ULL : 0;
+	time_t when = wall.tv_sec - (time_t)age_s;
+
+	struct tm tm_info;
+	localtime_r(&when, &tm_info);
+	strftime(buffer, size, "%H:%M:%S", &tm_info);
 }
\ No newline at end of file
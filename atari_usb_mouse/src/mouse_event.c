@@ -0,0 +1,318 @@
+/**
+ * @file mouse_event.c
+ * @brief Translates input events into quadrature pulses and button levels.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <linux/input.h>
+
+#include "mouse_event.h"
+#include "gpio_control.h"
+#include "config.h"
+#include "curve.h"
+#include "filter.h"
+#include "tick.h"
+#include "frame_pacing.h"
+#include "latency.h"
+#include "monitor.h"
+#include "telemetry.h"
+#include "global.h"
+
+
+// Gain stage state of the X and Y axes
+static curve_axis_t gain_axes[2];
+
+// Motion filter chains, built at load time: the top-level one, then one per profile
+static filter_chain_t chains[MAX_PROFILES + 1];
+
+// Chain of each profile (index + 1, 0 when none is selected), NULL for the per-event gain
+static filter_chain_t *profile_chains[MAX_PROFILES + 1];
+static int num_profile_chains = 1;
+static int selected_profile = -1;
+
+// Chain run per frame instead of the per-event gain, NULL if none
+static filter_chain_t *chain = NULL;
+
+// Raw motion of the current frame, for the filter chain
+static motion_frame_t pending_motion;
+
+// Input device, to read the button state back after SYN_DROPPED (-1 if none)
+static int device_fd = -1;
+
+// Set from SYN_DROPPED to the next SYN_REPORT: the events in between are incomplete
+static int dropping = 0;
+
+// Event time of the last SYN_DROPPED message, and the count it showed
+static uint64_t dropped_report_us = 0;
+static unsigned long long dropped_reported = 0;
+
+
+// Builds the motion filter chains of a configuration.
+void mouse_event_configure(const config_t *cfg) {
+	profile_chains[0] = NULL;
+	if (cfg->num_filters >= 0) {
+		filter_chain_build(&chains[0], cfg->filters, cfg->num_filters);
+		profile_chains[0] = &chains[0];
+		DEBUG_PRINT("Motion filter chain of %d stages, %s path\n", chains[0].count, filter_path_name(chains[0].path));
+	}
+
+	// Profiles without a chain of their own share the top-level one
+	for (int i = 0; i < cfg->num_profiles; i++) {
+		const profile_config_t *profile = &cfg->profiles[i];
+		profile_chains[i + 1] = profile_chains[0];
+		if (profile->num_filters >= 0) {
+			filter_chain_build(&chains[i + 1], profile->filters, profile->num_filters);
+			profile_chains[i + 1] = &chains[i + 1];
+			DEBUG_PRINT("Profile %s: motion filter chain of %d stages, %s path\n", profile->key,
+				chains[i + 1].count, filter_path_name(chains[i + 1].path));
+		}
+	}
+	num_profile_chains = cfg->num_profiles + 1;
+
+	mouse_event_select_profile(selected_profile);
+}
+
+// Selects the filter chain of a profile.
+void mouse_event_select_profile(int index) {
+	if (index + 1 >= num_profile_chains) {
+		index = -1;
+	}
+	selected_profile = index;
+	chain = profile_chains[index + 1];
+	pending_motion.d[0] = pending_motion.d[1] = 0;
+
+	// Averages, carries and gains of the previous mouse do not apply to this one
+	if (chain != NULL) {
+		filter_chain_reset(chain);
+	}
+}
+
+// Attaches the input device events are read from.
+void mouse_event_attach(int fd) {
+	device_fd = fd;
+	dropping = 0;
+}
+
+// Drives the buttons to the state the device reports, after events were lost.
+static void resync_buttons(void) {
+	unsigned long keys[KEY_CNT / (8 * sizeof(unsigned long)) + 1];
+
+	memset(keys, 0, sizeof(keys));
+	if (device_fd < 0 || ioctl(device_fd, EVIOCGKEY(sizeof(keys)), keys) < 0) {
+		return;
+	}
+
+	int bits = 8 * (int)sizeof(unsigned long);
+	int left = (keys[BTN_LEFT / bits] >> (BTN_LEFT % bits)) & 1;
+	int right = (keys[BTN_RIGHT / bits] >> (BTN_RIGHT % bits)) & 1;
+	if (left != stats.left_button_state) {
+		stats.left_button_state = left;
+		set_left_button(left);
+	}
+	if (right != stats.right_button_state) {
+		stats.right_button_state = right;
+		set_right_button(right);
+	}
+}
+
+// Routes the steps of one axis to the pacing in use.
+static void emit_motion(quadrature_state_t *state, int axis, int movement) {
+	if (movement != 0 && tick_enabled()) {
+		tick_add(axis, movement);
+	} else if (movement != 0 && config.pacing == PACING_FRAME) {
+		frame_add(axis, movement);
+	} else if (movement != 0 && axis == 0) {
+		generate_x_pulses(state, movement);
+	} else if (movement != 0) {
+		generate_y_pulses(state, movement);
+	}
+}
+
+// Runs the motion of a frame through the filter chain and emits it.
+static void run_filters(const struct input_event *ie, quadrature_state_t *state, int sensitivity, uint64_t time_us) {
+	motion_frame_t raw = pending_motion;
+	if (raw.d[0] == 0 && raw.d[1] == 0) {
+		return;
+	}
+
+	motion_frame_t motion = raw;
+	motion.time_us = time_us;
+	pending_motion.d[0] = pending_motion.d[1] = 0;
+	filter_chain_run(chain, &motion, active_curve(), sensitivity);
+
+	// Quadrature X runs opposite to the mouse
+	emit_motion(state, 0, -motion.d[0]);
+	emit_motion(state, 1, motion.d[1]);
+
+	for (int axis = 0; axis < 2; axis++) {
+		if (monitor_mode == MONITOR_JSONL && raw.d[axis] != 0) {
+			telemetry_add_motion(axis, raw.d[axis], abs(motion.d[axis]), &ie->time);
+		}
+	}
+	if (!monitor_mode) {
+		DEBUG_PRINT("Frame movement: %d,%d, filters: %d = movement: %d,%d\n", raw.d[0], raw.d[1],
+			chain->count, motion.d[0], motion.d[1]);
+	}
+	if (monitor_mode) {
+		display_monitor_status(state);
+	}
+}
+
+// Processes an input event and generates the corresponding GPIO signals.
+void process_mouse_event(struct input_event *ie, quadrature_state_t *state, int sensitivity) {
+	if (sensitivity == 0) {
+		sensitivity = DEFAULT_SENSITIVITY;
+	}
+
+	uint64_t time_us = (uint64_t)ie->time.tv_sec * 1000000ULL + (uint64_t)ie->time.tv_usec;
+	uint64_t event_ns = time_us * 1000ULL;
+
+	// Null backend runs on a virtual clock driven by input timestamps
+	if (output_backend == OUTPUT_NULL) {
+		// Ticks due before this event go out first
+		tick_advance(event_ns);
+		output_sync_clock(event_ns);
+	}
+
+	// Raw timestamp only, the monitor formats it when drawing
+	stats.last_event_ns = event_ns;
+
+	// The kernel queue overflowed: skip to the end of the frame, buttons read back
+	if (ie->type == EV_SYN && ie->code == SYN_DROPPED) {
+		stats.syn_dropped++;
+		dropping = 1;
+		pending_motion.d[0] = pending_motion.d[1] = 0;
+		resync_buttons();
+
+		// Overflows come in storms: the count is in status and telemetry, the log gets a summary
+		if (!monitor_mode && (dropped_reported == 0 || time_us - dropped_report_us >= SYN_DROPPED_REPORT_US)) {
+			INFO_PRINT("Input events dropped by the kernel (%llu times, %llu since the last report)\n",
+				stats.syn_dropped, stats.syn_dropped - dropped_reported);
+			dropped_report_us = time_us;
+			dropped_reported = stats.syn_dropped;
+		}
+		return;
+	}
+	if (dropping) {
+		dropping = !(ie->type == EV_SYN && ie->code == SYN_REPORT);
+		return;
+	}
+
+	switch (ie->type) {
+		case EV_REL:
+			switch (ie->code) {
+				case REL_X:
+					if (ie->value != 0) {
+						stats.last_x_delta = ie->value;
+						latency_record(&motion_latency, event_latency_ns(&ie->time));
+
+						// The chain sees the whole frame at SYN_REPORT
+						if (chain != NULL) {
+							pending_motion.d[0] += ie->value;
+							break;
+						}
+						
+						int movement = curve_apply_gain(active_curve(), &gain_axes[0], -ie->value, time_us, sensitivity);
+						emit_motion(state, 0, movement);
+
+						if (monitor_mode == MONITOR_JSONL) {
+							telemetry_add_motion(0, ie->value, abs(movement), &ie->time);
+						}
+
+						if (!monitor_mode) {
+							DEBUG_PRINT("X movement: %d, curve: %s, sensitivity: %d = movement: %d\n", ie->value, active_curve()->name, sensitivity, movement);
+						}
+						
+						if (monitor_mode) {
+							display_monitor_status(state);
+						}
+					}
+					break;
+
+				case REL_Y:
+					if (ie->value != 0) {
+						stats.last_y_delta = ie->value;
+						latency_record(&motion_latency, event_latency_ns(&ie->time));
+
+						// The chain sees the whole frame at SYN_REPORT
+						if (chain != NULL) {
+							pending_motion.d[1] += ie->value;
+							break;
+						}
+						
+						int movement = curve_apply_gain(active_curve(), &gain_axes[1], ie->value, time_us, sensitivity);
+						emit_motion(state, 1, movement);
+
+						if (monitor_mode == MONITOR_JSONL) {
+							telemetry_add_motion(1, ie->value, abs(movement), &ie->time);
+						}
+
+						if (!monitor_mode) {
+							DEBUG_PRINT("Y movement: %d, curve: %s, sensitivity: %d = movement: %d\n", ie->value, active_curve()->name, sensitivity, movement);
+						}
+						
+						if (monitor_mode) {
+							display_monitor_status(state);
+						}
+					}
+					break;
+			}
+			break;
+
+		case EV_KEY:
+			switch (ie->code) {
+				case BTN_LEFT:
+					stats.left_button_state = ie->value;
+					
+					set_left_button(ie->value);
+					latency_record(&button_latency, event_latency_ns(&ie->time));
+
+					if (!monitor_mode) {
+						DEBUG_PRINT("Left button: %s\n", ie->value ? "pressed" : "released");
+					}
+					
+					if (monitor_mode) {
+						display_monitor_status(state);
+					}
+					break;
+
+				case BTN_RIGHT:
+					stats.right_button_state = ie->value;
+					
+					set_right_button(ie->value);
+					latency_record(&button_latency, event_latency_ns(&ie->time));
+
+					if (!monitor_mode) {
+						DEBUG_PRINT("Right button: %s\n", ie->value ? "pressed" : "released");
+					}
+					
+					if (monitor_mode) {
+						display_monitor_status(state);
+					}
+					break;
+			}
+			break;
+
+		case EV_SYN:
+			// End of an input frame: track the polling rate, emit a paced frame
+			if (ie->code == SYN_REPORT) {
+				stats.frames++;
+				frame_rate_update(time_us);
+				if (chain != NULL) {
+					run_filters(ie, state, sensitivity, time_us);
+				}
+				if (config.pacing == PACING_FRAME) {
+					frame_emit(state);
+				}
+				if (monitor_mode == MONITOR_JSONL) {
+					telemetry_frame_end(stats.left_button_state | (stats.right_button_state << 1), &ie->time);
+				}
+			}
+			break;
+	}
+}
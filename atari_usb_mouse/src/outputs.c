@@ -0,0 +1,406 @@
+/**
+ * @file outputs.c
+ * @brief Additional outputs driven from the same process.
+ *
+ * The main output keeps the pipeline of gpio_control.c. Each additional
+ * output has its own lines, input device, gain state and timing: the main
+ * event loop reads its events and queues the resulting steps, and a worker
+ * thread of its own drains them on a fixed-rate grid, as tick.c does, so
+ * that a busy output never delays the edges of another one.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/input.h>
+
+#include "outputs.h"
+#include "gpio_control.h"
+#include "mouse_event.h"
+#include "tick.h"
+#include "precision.h"
+#include "global.h"
+
+
+/**
+ * One additional output.
+ *
+ * Fields marked (lock) are shared between the event loop and the worker.
+ */
+typedef struct {
+	output_config_t cfg;
+	curve_t curve;			// Copy of the curve, the configuration may be reloaded
+	output_lines_t *lines;
+	int fd;				// Input device, -1 while disconnected
+	time_t reopen_at;		// Next attempt to open the device
+
+	curve_axis_t axes[2];		// Gain stage state of X and Y
+	int pending[2];			// Steps still to emit on X and Y (lock)
+	uint32_t buttons;		// Requested button levels (lock)
+
+	// Worker side
+	int phases[2];
+	uint32_t levels;
+	uint64_t period_ns;
+	uint64_t next_tick_ns;
+
+	pthread_t thread;
+	int thread_running;
+	int stopping;			// (lock)
+	pthread_mutex_t lock;
+	pthread_cond_t work_cond;
+
+	// Statistics
+	unsigned long long events;
+	unsigned long long steps;	// (lock)
+	unsigned long long dropped;
+	unsigned long long late;	// (lock)
+} output_t;
+
+static output_t outputs[MAX_OUTPUTS];
+static int num_outputs = 0;
+
+static const uint32_t button_mask = (1u << LINE_LEFT_BUTTON) | (1u << LINE_RIGHT_BUTTON);
+
+
+// Reads CLOCK_MONOTONIC in nanoseconds.
+static uint64_t monotonic_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Sleeps until an absolute CLOCK_MONOTONIC time.
+static void sleep_until(uint64_t time_ns) {
+	struct timespec ts = {
+		.tv_sec = (time_t)(time_ns / 1000000000ULL),
+		.tv_nsec = (long)(time_ns % 1000000000ULL)
+	};
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+// Emits one step on every axis with queued motion. Called with lock held.
+static void emit_tick(output_t *output) {
+	uint32_t levels = output->levels;
+
+	for (int axis = 0; axis < 2; axis++) {
+		if (output->pending[axis] != 0) {
+			int direction = (output->pending[axis] > 0) ? 1 : -1;
+			output->pending[axis] -= direction;
+			output->phases[axis] = (output->phases[axis] + (direction > 0 ? 1 : 3)) % 4;
+			levels = quadrature_levels(levels, axis, output->phases[axis]);
+			output->steps++;
+		}
+	}
+	output->levels = levels;
+	output_lines_write(output->lines, levels);
+}
+
+// Worker thread of one output.
+static void *output_thread(void *arg) {
+	output_t *output = arg;
+
+	if (output->cfg.cpu >= 0) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(output->cfg.cpu, &set);
+		int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+		if (err != 0) {
+			ERROR_PRINT("Cannot pin output %s to CPU %d: %s\n", output->cfg.name, output->cfg.cpu, strerror(err));
+		}
+	}
+
+	pthread_mutex_lock(&output->lock);
+	while (!output->stopping) {
+		// Buttons do not wait for the grid
+		if (((output->levels ^ output->buttons) & button_mask) != 0) {
+			output->levels = (output->levels & ~button_mask) | output->buttons;
+			output_lines_write(output->lines, output->levels);
+			continue;
+		}
+		if (output->pending[0] == 0 && output->pending[1] == 0) {
+			pthread_cond_wait(&output->work_cond, &output->lock);
+
+			// After an idle period the grid restarts from now
+			uint64_t now = monotonic_ns();
+			if (output->next_tick_ns < now) {
+				output->next_tick_ns = now;
+			}
+			continue;
+		}
+		pthread_mutex_unlock(&output->lock);
+
+		sleep_until(output->next_tick_ns);
+		uint64_t woke = monotonic_ns();
+
+		pthread_mutex_lock(&output->lock);
+		if (woke > output->next_tick_ns + output->period_ns / 2) {
+			output->late++;
+		}
+		emit_tick(output);
+
+		// Late ticks are not caught up: keep the next one half a period away at least
+		output->next_tick_ns += output->period_ns;
+		if (output->next_tick_ns < woke + output->period_ns / 2) {
+			output->next_tick_ns = woke + output->period_ns / 2;
+		}
+	}
+	pthread_mutex_unlock(&output->lock);
+	return NULL;
+}
+
+// Queues steps on one axis of an output, dropping what exceeds the queue.
+static void queue_steps(output_t *output, int axis, int steps) {
+	pthread_mutex_lock(&output->lock);
+	int total = output->pending[axis] + steps;
+	if (total > OUTPUT_MAX_PENDING || total < -OUTPUT_MAX_PENDING) {
+		int kept = (total > 0) ? OUTPUT_MAX_PENDING : -OUTPUT_MAX_PENDING;
+		output->dropped += (unsigned long long)abs(total - kept);
+		total = kept;
+	}
+	output->pending[axis] = total;
+	pthread_cond_signal(&output->work_cond);
+	pthread_mutex_unlock(&output->lock);
+}
+
+// Sets the level of a button line of an output (active low).
+static void queue_button(output_t *output, int line, int pressed) {
+	pthread_mutex_lock(&output->lock);
+	if (pressed) {
+		output->buttons &= ~(1u << line);
+	} else {
+		output->buttons |= 1u << line;
+	}
+	pthread_cond_signal(&output->work_cond);
+	pthread_mutex_unlock(&output->lock);
+}
+
+// Translates one input event of an output.
+static void handle_event(output_t *output, const struct input_event *ie) {
+	uint64_t time_us = (uint64_t)ie->time.tv_sec * 1000000ULL + (uint64_t)ie->time.tv_usec;
+	int movement;
+
+	output->events++;
+	if (ie->type == EV_REL && ie->value != 0 && (ie->code == REL_X || ie->code == REL_Y)) {
+		// X is inverted, as on the main output
+		int axis = (ie->code == REL_Y);
+		movement = curve_apply_gain(&output->curve, &output->axes[axis], axis ? ie->value : -ie->value,
+			time_us, output->cfg.sensitivity);
+		if (movement != 0) {
+			queue_steps(output, axis, movement);
+		}
+	} else if (ie->type == EV_KEY && ie->code == BTN_LEFT) {
+		queue_button(output, LINE_LEFT_BUTTON, ie->value);
+	} else if (ie->type == EV_KEY && ie->code == BTN_RIGHT) {
+		queue_button(output, LINE_RIGHT_BUTTON, ie->value);
+	}
+}
+
+// Closes the input device of an output and schedules its reopening.
+static void drop_device(output_t *output, const char *reason) {
+	INFO_PRINT("Output %s: device %s %s\n", output->cfg.name, output->cfg.device_path, reason);
+	close(output->fd);
+	output->fd = -1;
+	output->reopen_at = time(NULL) + OUTPUT_REOPEN_S;
+
+	// Release the buttons of a vanished mouse
+	queue_button(output, LINE_LEFT_BUTTON, 0);
+	queue_button(output, LINE_RIGHT_BUTTON, 0);
+}
+
+// Reads the events available on the device of an output.
+static void read_device(output_t *output) {
+	struct input_event events[64];
+
+	for (;;) {
+		ssize_t bytes = read(output->fd, events, sizeof(events));
+		if (bytes < 0 && errno == EINTR) {
+			continue;
+		}
+		if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			return;
+		}
+		if (bytes <= 0) {
+			drop_device(output, bytes == 0 ? "closed" : "disconnected");
+			return;
+		}
+		for (size_t i = 0; i < (size_t)bytes / sizeof(events[0]); i++) {
+			handle_event(output, &events[i]);
+		}
+		if ((size_t)bytes < sizeof(events)) {
+			return;
+		}
+	}
+}
+
+// Opens the device of an output, at most once per OUTPUT_REOPEN_S.
+static void open_device(output_t *output) {
+	time_t now = time(NULL);
+	if (now < output->reopen_at) {
+		return;
+	}
+
+	output->fd = open(output->cfg.device_path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+	if (output->fd < 0) {
+		// Reported once until the device comes back
+		if (output->reopen_at == 0) {
+			INFO_PRINT("Output %s: cannot open device %s: %s\n", output->cfg.name, output->cfg.device_path, strerror(errno));
+		}
+		output->reopen_at = now + OUTPUT_REOPEN_S;
+		return;
+	}
+	output->reopen_at = 0;
+	DEBUG_PRINT("Output %s: device %s opened\n", output->cfg.name, output->cfg.device_path);
+}
+
+// Starts the additional outputs of the configuration.
+int outputs_start(const config_t *cfg) {
+	for (int i = 0; i < cfg->num_outputs; i++) {
+		output_t *output = &outputs[i];
+		const output_config_t *oc = &cfg->outputs[i];
+
+		if (oc->tick_us < TICK_MIN_US || oc->tick_us > TICK_MAX_US) {
+			ERROR_PRINT("Output %s: tick period must be between %d and %d us\n", oc->name, TICK_MIN_US, TICK_MAX_US);
+			outputs_stop();
+			return -1;
+		}
+
+		memset(output, 0, sizeof(*output));
+		output->cfg = *oc;
+		if (output->cfg.sensitivity <= 0) {
+			output->cfg.sensitivity = DEFAULT_SENSITIVITY;
+		}
+		output->curve = cfg->curves[oc->curve_index];
+		output->fd = -1;
+		output->period_ns = (uint64_t)oc->tick_us * 1000ULL;
+		output->levels = output->buttons = button_mask;
+
+		unsigned int offsets[NUM_LINES];
+		for (int line = 0; line < NUM_LINES; line++) {
+			offsets[line] = (unsigned int)oc->pins[line];
+		}
+		output->lines = output_lines_open(oc->gpio_chip, offsets);
+		if (output->lines == NULL) {
+			ERROR_PRINT("Output %s: cannot request its lines\n", oc->name);
+			outputs_stop();
+			return -1;
+		}
+
+		pthread_mutex_init(&output->lock, NULL);
+		pthread_cond_init(&output->work_cond, NULL);
+		num_outputs = i + 1;
+
+		// Signals stay with the main thread, which owns the running flag
+		sigset_t all, old;
+		sigfillset(&all);
+		pthread_sigmask(SIG_BLOCK, &all, &old);
+		int err = pthread_create(&output->thread, precision_thread_attr(), output_thread, output);
+		pthread_sigmask(SIG_SETMASK, &old, NULL);
+		if (err != 0) {
+			ERROR_PRINT("Output %s: cannot start worker: %s\n", oc->name, strerror(err));
+			outputs_stop();
+			return -1;
+		}
+		output->thread_running = 1;
+
+		open_device(output);
+		INFO_PRINT("Output %s started on %s, one step per axis every %d us\n", oc->name, oc->gpio_chip, oc->tick_us);
+	}
+	return 0;
+}
+
+// Adds the input devices of the outputs to a select() set.
+int outputs_fill_fds(fd_set *set, int max_fd) {
+	for (int i = 0; i < num_outputs; i++) {
+		output_t *output = &outputs[i];
+		if (output->fd < 0) {
+			open_device(output);
+		}
+		if (output->fd >= 0) {
+			FD_SET(output->fd, set);
+			if (output->fd > max_fd) {
+				max_fd = output->fd;
+			}
+		}
+	}
+	return max_fd;
+}
+
+// Reads the pending events of the outputs.
+void outputs_service(const fd_set *set) {
+	for (int i = 0; i < num_outputs; i++) {
+		if (outputs[i].fd >= 0 && FD_ISSET(outputs[i].fd, set)) {
+			read_device(&outputs[i]);
+		}
+	}
+}
+
+// Services the outputs for up to a given time.
+void outputs_wait(int timeout_ms) {
+	fd_set readfds;
+	struct timeval timeout = { timeout_ms / 1000, (timeout_ms % 1000) * 1000 };
+
+	FD_ZERO(&readfds);
+	int max_fd = outputs_fill_fds(&readfds, -1);
+	if (select(max_fd + 1, &readfds, NULL, NULL, &timeout) > 0) {
+		outputs_service(&readfds);
+	}
+}
+
+// Formats the statistics of every output on one line.
+int outputs_status(char *buffer, size_t size) {
+	size_t len = 0;
+
+	buffer[0] = '\0';
+	for (int i = 0; i < num_outputs && len < size; i++) {
+		output_t *output = &outputs[i];
+
+		pthread_mutex_lock(&output->lock);
+		int written = snprintf(buffer + len, size - len, "%s%s=%s events=%llu steps=%llu dropped=%llu late=%llu",
+			i ? " " : "", output->cfg.name, output->fd >= 0 ? "connected" : "waiting",
+			output->events, output->steps, output->dropped, output->late);
+		pthread_mutex_unlock(&output->lock);
+		if (written < 0) {
+			break;
+		}
+		len += (size_t)written;
+	}
+	return num_outputs;
+}
+
+// Stops the workers and releases the lines of every output.
+void outputs_stop(void) {
+	for (int i = 0; i < num_outputs; i++) {
+		output_t *output = &outputs[i];
+
+		if (output->thread_running) {
+			pthread_mutex_lock(&output->lock);
+			output->stopping = 1;
+			pthread_cond_signal(&output->work_cond);
+			pthread_mutex_unlock(&output->lock);
+			pthread_join(output->thread, NULL);
+			output->thread_running = 0;
+		}
+		if (output->fd >= 0) {
+			close(output->fd);
+			output->fd = -1;
+		}
+		output_lines_close(output->lines);
+		output->lines = NULL;
+
+		INFO_PRINT("Output %s: %llu events, %llu steps, %llu dropped, %llu late ticks\n", output->cfg.name,
+			output->events, output->steps, output->dropped, output->late);
+		pthread_mutex_destroy(&output->lock);
+		pthread_cond_destroy(&output->work_cond);
+	}
+	num_outputs = 0;
+}
@@ -0,0 +1,153 @@
+/**
+ * @file precision.c
+ * @brief Sleep-then-spin edge emitter.
+ *
+ * Kernel sleeps wake up tens of microseconds late on a Pi, so the edge
+ * period has to cover that worst case. The precision emitter sleeps until
+ * shortly before each edge and busy-waits the rest, trading CPU time on a
+ * dedicated core for edge timing close to the clock read cost.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "precision.h"
+#include "gpio_control.h"
+#include "ikbd_model.h"
+#include "latency.h"
+#include "global.h"
+
+
+static int enabled = 0;
+static uint64_t spin_ns = 0;
+
+// Helper threads run on every CPU but the pinned one
+static pthread_attr_t helper_attr;
+static int helper_attr_set = 0;
+
+// Lateness of each edge against its schedule
+static latency_hist_t jitter;
+
+// CPU and wall time spent running schedules, and the part spent spinning
+static uint64_t run_cpu_ns = 0;
+static uint64_t run_wall_ns = 0;
+static uint64_t run_spin_ns = 0;
+
+
+// Reads a clock in nanoseconds.
+static inline uint64_t clock_ns(clockid_t clock) {
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Enables the precision emitter.
+int precision_init(int spin_us, int cpu) {
+	if (output_backend == OUTPUT_NULL) {
+		DEBUG_PRINT("Null output backend, precision emitter not used\n");
+		return 0;
+	}
+
+	if (cpu >= 0) {
+		cpu_set_t set;
+		cpu_set_t others;
+
+		// Threads inherit the affinity of their creator: keep the others for them
+		if (pthread_getaffinity_np(pthread_self(), sizeof(others), &others) == 0) {
+			CPU_CLR(cpu, &others);
+			if (CPU_COUNT(&others) > 0 && pthread_attr_init(&helper_attr) == 0) {
+				pthread_attr_setaffinity_np(&helper_attr, sizeof(others), &others);
+				helper_attr_set = 1;
+			}
+		}
+
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+		if (err != 0) {
+			ERROR_PRINT("Cannot pin to CPU %d: %s\n", cpu, strerror(err));
+			return -1;
+		}
+	}
+
+	// Page faults would show up as jitter; later thread stacks stay unlocked
+	if (mlockall(MCL_CURRENT) < 0) {
+		DEBUG_PRINT("mlockall failed: %s\n", strerror(errno));
+	}
+
+	spin_ns = (uint64_t)spin_us * 1000ULL;
+	memset(&jitter, 0, sizeof(jitter));
+	enabled = 1;
+	DEBUG_PRINT("Precision emitter enabled: spin %d us, CPU %d\n", spin_us, cpu);
+	return 0;
+}
+
+// Returns the attributes of helper threads, NULL while no CPU is reserved.
+const pthread_attr_t *precision_thread_attr(void) {
+	return helper_attr_set ? &helper_attr : NULL;
+}
+
+// Tells whether pulse trains go through the precision emitter.
+int precision_enabled(void) {
+	return enabled;
+}
+
+// Sleeps, then spins, until an absolute CLOCK_MONOTONIC_RAW time.
+static void wait_until(uint64_t target) {
+	uint64_t now = clock_ns(CLOCK_MONOTONIC_RAW);
+
+	// The sleep still services the button lane
+	if (target > now + spin_ns) {
+		edge_delay((int)((target - now - spin_ns) / 1000ULL));
+		now = clock_ns(CLOCK_MONOTONIC_RAW);
+	}
+
+	uint64_t spin_start = now;
+	while (now < target) {
+		now = clock_ns(CLOCK_MONOTONIC_RAW);
+	}
+	run_spin_ns += now - spin_start;
+}
+
+// Runs an edge schedule, the first edge immediately.
+void precision_run(const edge_slot_t *slots, int count, uint32_t end_us) {
+	uint64_t cpu_start = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+	uint64_t start = clock_ns(CLOCK_MONOTONIC_RAW);
+
+	for (int i = 0; i < count; i++) {
+		uint64_t target = start + (uint64_t)slots[i].offset_us * 1000ULL;
+		wait_until(target);
+
+		uint64_t now = clock_ns(CLOCK_MONOTONIC_RAW);
+		output_write_levels(slots[i].levels, slots[i].mask);
+		latency_record(&jitter, now - target);
+
+		// A late edge delays the rest of the schedule rather than shortening the next level
+		start += now - target;
+	}
+	wait_until(start + (uint64_t)end_us * 1000ULL);
+
+	run_wall_ns += clock_ns(CLOCK_MONOTONIC_RAW) - start;
+	run_cpu_ns += clock_ns(CLOCK_THREAD_CPUTIME_ID) - cpu_start;
+}
+
+// Prints the achieved edge jitter and the CPU cost of the emitter.
+void precision_report(void) {
+	if (!enabled || jitter.count == 0) return;
+
+	latency_report("Edge jitter", &jitter);
+	INFO_PRINT("Precision emitter: %.1f%% CPU while emitting, %.1f%% spinning\n",
+		run_wall_ns ? 100.0 * (double)run_cpu_ns / (double)run_wall_ns : 0.0,
+		run_wall_ns ? 100.0 * (double)run_spin_ns / (double)run_wall_ns : 0.0);
+
+	// Both edges of a level may be late: it must still span one IKBD sample
+	INFO_PRINT("Shortest safe edge period with this jitter: %llu us (IKBD sample %d us + 2 x p99)\n",
+		(unsigned long long)(IKBD_SAMPLE_US + 2 * latency_percentile(&jitter, 99)), IKBD_SAMPLE_US);
+}
@@ -0,0 +1,566 @@
+/**
+ * @file remote.c
+ * @brief Mouse input received over UDP, and the matching sender.
+ *
+ * The sender sends one small datagram per input frame, carrying the motion
+ * accumulated since the previous one and the buttons held, plus keep-alives
+ * while the mouse is idle. Motion is relative, so a late datagram is still
+ * worth its motion; buttons are a level, so only the newest datagram sets
+ * them. The receiver hands the result to the event loop as evdev frames on
+ * a pipe: the pipeline downstream cannot tell it from a local mouse.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <sys/socket.h>
+#include <linux/input.h>
+
+#include "remote.h"
+#include "precision.h"
+#include "global.h"
+
+
+// Receiver socket, event pipe and stop pipe
+static int sock_fd = -1;
+static int event_pipe[2] = { -1, -1 };
+static int stop_pipe[2] = { -1, -1 };
+static pthread_t thread;
+static int started = 0;
+static uint64_t button_timeout_ns;
+
+// Sequence tracking: bit n of seen is set if next_seq - 1 - n was received
+static int synced = 0;
+static uint32_t session;
+static uint32_t next_seq;
+static uint64_t seen;
+
+// Motion and buttons not yet written to the pipe
+static int32_t acc_dx = 0;
+static int32_t acc_dy = 0;
+static uint8_t rx_buttons = 0;
+static uint8_t sent_buttons = 0;
+static uint64_t last_rx_ns = 0;
+
+// Button states received but not yet written, oldest first: a press and a
+// release drained from the socket together still make two frames
+static uint8_t button_queue[REMOTE_BUTTON_QUEUE];
+static int queued = 0;
+
+static remote_stats_t stats;
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+// Reads CLOCK_MONOTONIC in nanoseconds.
+static uint64_t monotonic_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Stores a 32-bit value big-endian.
+static void put_u32(uint8_t *p, uint32_t value) {
+	p[0] = (uint8_t)(value >> 24);
+	p[1] = (uint8_t)(value >> 16);
+	p[2] = (uint8_t)(value >> 8);
+	p[3] = (uint8_t)value;
+}
+
+// Loads a big-endian 32-bit value.
+static uint32_t get_u32(const uint8_t *p) {
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+// Encodes a datagram.
+void remote_encode(const remote_packet_t *packet, uint8_t *buffer) {
+	buffer[0] = REMOTE_MAGIC_0;
+	buffer[1] = REMOTE_MAGIC_1;
+	buffer[2] = REMOTE_VERSION;
+	buffer[3] = packet->buttons;
+	put_u32(buffer + 4, packet->session);
+	put_u32(buffer + 8, packet->seq);
+	put_u32(buffer + 12, (uint32_t)packet->dx);
+	put_u32(buffer + 16, (uint32_t)packet->dy);
+	put_u32(buffer + 20, (uint32_t)(packet->sent_us >> 32));
+	put_u32(buffer + 24, (uint32_t)packet->sent_us);
+}
+
+// Decodes a datagram.
+int remote_decode(const uint8_t *buffer, size_t size, remote_packet_t *packet) {
+	if (size != REMOTE_PACKET_SIZE || buffer[0] != REMOTE_MAGIC_0 || buffer[1] != REMOTE_MAGIC_1
+			|| buffer[2] != REMOTE_VERSION) {
+		return -1;
+	}
+	packet->buttons = buffer[3];
+	packet->session = get_u32(buffer + 4);
+	packet->seq = get_u32(buffer + 8);
+	packet->dx = (int32_t)get_u32(buffer + 12);
+	packet->dy = (int32_t)get_u32(buffer + 16);
+	packet->sent_us = ((uint64_t)get_u32(buffer + 20) << 32) | get_u32(buffer + 24);
+	return 0;
+}
+
+// Resolves "HOST:PORT", ":PORT" or "PORT" (IPv6 hosts in brackets).
+static struct addrinfo *resolve(const char *spec, int passive) {
+	char host[256] = "";
+	const char *port = spec;
+	const char *colon = strrchr(spec, ':');
+	struct addrinfo hints, *result = NULL;
+
+	if (colon != NULL) {
+		size_t len = (size_t)(colon - spec);
+		if (len >= sizeof(host)) {
+			ERROR_PRINT("Invalid address %s\n", spec);
+			return NULL;
+		}
+		memcpy(host, spec, len);
+		host[len] = '\0';
+		port = colon + 1;
+		if (host[0] == '[' && len >= 2 && host[len - 1] == ']') {
+			memmove(host, host + 1, len - 2);
+			host[len - 2] = '\0';
+		}
+	}
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+	hints.ai_flags = passive ? AI_PASSIVE : 0;
+	int err = getaddrinfo(host[0] ? host : NULL, port, &hints, &result);
+	if (err != 0) {
+		ERROR_PRINT("Cannot resolve %s: %s\n", spec, gai_strerror(err));
+		return NULL;
+	}
+	return result;
+}
+
+// Sets the newest button state, queued behind the ones not written yet.
+static void set_buttons(uint8_t buttons) {
+	if (buttons == rx_buttons) {
+		return;
+	}
+	rx_buttons = buttons;
+
+	// Queue full: the newest state replaces the last one queued
+	if (queued == REMOTE_BUTTON_QUEUE) {
+		queued--;
+	}
+	button_queue[queued++] = buttons;
+}
+
+// Writes one frame with the pending motion and the oldest button change.
+static int write_frame(void) {
+	struct input_event events[5];
+	struct timespec now;
+	uint8_t buttons = queued ? button_queue[0] : sent_buttons;
+	int count = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	memset(events, 0, sizeof(events));
+	if (acc_dx != 0) {
+		events[count].type = EV_REL;
+		events[count].code = REL_X;
+		events[count++].value = acc_dx;
+	}
+	if (acc_dy != 0) {
+		events[count].type = EV_REL;
+		events[count].code = REL_Y;
+		events[count++].value = acc_dy;
+	}
+	if ((buttons ^ sent_buttons) & REMOTE_BUTTON_LEFT) {
+		events[count].type = EV_KEY;
+		events[count].code = BTN_LEFT;
+		events[count++].value = !!(buttons & REMOTE_BUTTON_LEFT);
+	}
+	if ((buttons ^ sent_buttons) & REMOTE_BUTTON_RIGHT) {
+		events[count].type = EV_KEY;
+		events[count].code = BTN_RIGHT;
+		events[count++].value = !!(buttons & REMOTE_BUTTON_RIGHT);
+	}
+	events[count].type = EV_SYN;
+	events[count++].code = SYN_REPORT;
+	for (int i = 0; i < count; i++) {
+		events[i].time.tv_sec = now.tv_sec;
+		events[i].time.tv_usec = now.tv_nsec / 1000;
+	}
+
+	// Below PIPE_BUF the frame is written whole or not at all
+	if (write(event_pipe[1], events, (size_t)count * sizeof(events[0])) < 0) {
+		return -1;
+	}
+	acc_dx = acc_dy = 0;
+	sent_buttons = buttons;
+	if (queued) {
+		memmove(button_queue, button_queue + 1, (size_t)--queued);
+	}
+	return 0;
+}
+
+// Writes the pending motion and button changes to the pipe, one frame per button change.
+static void flush_frame(void) {
+	while (acc_dx != 0 || acc_dy != 0 || queued > 0) {
+		if (write_frame() < 0) {
+			return;		// Event loop busy: keep accumulating
+		}
+	}
+}
+
+// Checks the sequence number of a datagram and applies it.
+static void handle_datagram(const uint8_t *buffer, ssize_t size) {
+	remote_packet_t packet;
+
+	pthread_mutex_lock(&stats_lock);
+	if (size < 0 || remote_decode(buffer, (size_t)size, &packet) < 0) {
+		stats.invalid++;
+		pthread_mutex_unlock(&stats_lock);
+		return;
+	}
+	stats.received++;
+	if (acc_dx != 0 || acc_dy != 0 || queued > 0) {
+		stats.coalesced++;
+	}
+
+	int32_t ahead = (int32_t)(packet.seq - next_seq);
+	if (!synced || packet.session != session) {
+		// First datagram, or the sender restarted
+		synced = 1;
+		session = packet.session;
+		seen = 1;
+		next_seq = packet.seq + 1;
+	} else if (ahead >= 0) {
+		// Newest so far; the numbers skipped are lost unless they come late
+		stats.lost += (unsigned long long)ahead;
+		seen = (ahead + 1 < REMOTE_WINDOW) ? (seen << (ahead + 1)) | 1 : 1;
+		next_seq = packet.seq + 1;
+	} else {
+		uint32_t age = next_seq - 1 - packet.seq;
+		if (age >= REMOTE_WINDOW) {
+			stats.stale++;
+		} else if (seen & (1ULL << age)) {
+			stats.duplicates++;
+		} else {
+			// Late: its motion still counts, its buttons are outdated
+			seen |= 1ULL << age;
+			stats.lost--;
+			stats.late++;
+			acc_dx += packet.dx;
+			acc_dy += packet.dy;
+		}
+		last_rx_ns = monotonic_ns();
+		pthread_mutex_unlock(&stats_lock);
+		return;
+	}
+	pthread_mutex_unlock(&stats_lock);
+
+	acc_dx += packet.dx;
+	acc_dy += packet.dy;
+	set_buttons(packet.buttons & (REMOTE_BUTTON_LEFT | REMOTE_BUTTON_RIGHT));
+	last_rx_ns = monotonic_ns();
+}
+
+// Receiver thread: datagrams in, evdev frames out.
+static void *receiver_thread(void *arg) {
+	(void)arg;
+	uint8_t buffer[REMOTE_PACKET_SIZE + 1];
+
+	for (;;) {
+		int pending = (acc_dx != 0 || acc_dy != 0 || queued > 0);
+		struct pollfd pfds[3] = {
+			{ .fd = sock_fd, .events = POLLIN },
+			{ .fd = stop_pipe[0], .events = POLLIN },
+			{ .fd = event_pipe[1], .events = pending ? POLLOUT : 0 }
+		};
+
+		// Held buttons wait for the next datagram at most button_timeout_ns
+		int timeout_ms = -1;
+		if (rx_buttons != 0) {
+			uint64_t now = monotonic_ns();
+			uint64_t deadline = last_rx_ns + button_timeout_ns;
+			timeout_ms = (now >= deadline) ? 0 : (int)((deadline - now + 999999ULL) / 1000000ULL);
+		}
+
+		if (poll(pfds, 3, timeout_ms) < 0 && errno != EINTR) {
+			ERROR_PRINT("Remote input: poll failed: %s\n", strerror(errno));
+			break;
+		}
+		if (pfds[1].revents) {
+			break;
+		}
+
+		if (pfds[0].revents & POLLIN) {
+			ssize_t size;
+			while ((size = recv(sock_fd, buffer, sizeof(buffer), MSG_DONTWAIT)) >= 0 || errno == EINTR) {
+				if (size >= 0) {
+					handle_datagram(buffer, size);
+				}
+			}
+		}
+
+		if (rx_buttons != 0 && monotonic_ns() >= last_rx_ns + button_timeout_ns) {
+			INFO_PRINT("Remote input silent, releasing the buttons\n");
+			set_buttons(0);
+			pthread_mutex_lock(&stats_lock);
+			stats.button_timeouts++;
+			pthread_mutex_unlock(&stats_lock);
+		}
+
+		flush_frame();
+	}
+	return NULL;
+}
+
+// Starts receiving datagrams on a UDP socket.
+int remote_start(const char *listen, int button_timeout_ms) {
+	struct addrinfo *addresses = resolve(listen, 1);
+	if (addresses == NULL) {
+		return -1;
+	}
+
+	for (struct addrinfo *ai = addresses; ai != NULL; ai = ai->ai_next) {
+		sock_fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+		if (sock_fd < 0) {
+			continue;
+		}
+		int one = 1;
+		setsockopt(sock_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		if (bind(sock_fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+			break;
+		}
+		close(sock_fd);
+		sock_fd = -1;
+	}
+	freeaddrinfo(addresses);
+	if (sock_fd < 0) {
+		ERROR_PRINT("Cannot listen on UDP %s: %s\n", listen, strerror(errno));
+		return -1;
+	}
+
+	if (pipe2(event_pipe, O_CLOEXEC | O_NONBLOCK) < 0 || pipe2(stop_pipe, O_CLOEXEC) < 0) {
+		ERROR_PRINT("Cannot create remote input pipes: %s\n", strerror(errno));
+		remote_stop();
+		return -1;
+	}
+
+	memset(&stats, 0, sizeof(stats));
+	synced = 0;
+	acc_dx = acc_dy = 0;
+	rx_buttons = sent_buttons = 0;
+	queued = 0;
+	button_timeout_ns = (uint64_t)button_timeout_ms * 1000000ULL;
+
+	// Signals stay with the main thread, which owns the running flag
+	sigset_t all, old;
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+	int err = pthread_create(&thread, precision_thread_attr(), receiver_thread, NULL);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (err != 0) {
+		ERROR_PRINT("Cannot start remote input: %s\n", strerror(err));
+		remote_stop();
+		return -1;
+	}
+	started = 1;
+
+	INFO_PRINT("Receiving mouse input on UDP port %d\n", remote_port());
+	return event_pipe[0];
+}
+
+// Tells whether the input comes from the UDP receiver.
+int remote_active(void) {
+	return started;
+}
+
+// Returns the UDP port the receiver is bound to.
+int remote_port(void) {
+	struct sockaddr_storage addr;
+	socklen_t len = sizeof(addr);
+
+	if (sock_fd < 0 || getsockname(sock_fd, (struct sockaddr *)&addr, &len) < 0) {
+		return 0;
+	}
+	if (addr.ss_family == AF_INET6) {
+		return ntohs(((struct sockaddr_in6 *)&addr)->sin6_port);
+	}
+	return ntohs(((struct sockaddr_in *)&addr)->sin_port);
+}
+
+// Copies the counters of the receiver.
+void remote_get_stats(remote_stats_t *out) {
+	pthread_mutex_lock(&stats_lock);
+	*out = stats;
+	pthread_mutex_unlock(&stats_lock);
+}
+
+// Prints the counters of the receiver on one line.
+void remote_report(void) {
+	remote_stats_t s;
+
+	remote_get_stats(&s);
+	INFO_PRINT("Remote input: %llu datagrams, %llu lost, %llu late, %llu duplicates, %llu stale, "
+		"%llu invalid, %llu coalesced, %llu button timeouts\n", s.received, s.lost, s.late,
+		s.duplicates, s.stale, s.invalid, s.coalesced, s.button_timeouts);
+}
+
+// Stops the receiver.
+void remote_stop(void) {
+	if (started) {
+		char stop = 0;
+		if (write(stop_pipe[1], &stop, 1) < 0) {
+			pthread_cancel(thread);
+		}
+		pthread_join(thread, NULL);
+		started = 0;
+	}
+
+	if (sock_fd >= 0) {
+		close(sock_fd);
+		sock_fd = -1;
+	}
+	for (int i = 0; i < 2; i++) {
+		if (stop_pipe[i] >= 0) {
+			close(stop_pipe[i]);
+			stop_pipe[i] = -1;
+		}
+	}
+	// The read end belongs to the caller
+	if (event_pipe[1] >= 0) {
+		close(event_pipe[1]);
+		event_pipe[1] = -1;
+	}
+	event_pipe[0] = -1;
+}
+
+// Opens a UDP socket connected to a receiver.
+int remote_connect(const char *target) {
+	struct addrinfo *addresses = resolve(target, 0);
+	int fd = -1;
+
+	if (addresses == NULL) {
+		return -1;
+	}
+	for (struct addrinfo *ai = addresses; ai != NULL; ai = ai->ai_next) {
+		fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+		if (fd < 0) {
+			continue;
+		}
+		if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+			break;
+		}
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(addresses);
+	if (fd < 0) {
+		ERROR_PRINT("Cannot reach UDP %s: %s\n", target, strerror(errno));
+		return -1;
+	}
+
+	// Ask routers for low delay (IPv4 only, harmless elsewhere)
+	int tos = IPTOS_LOWDELAY;
+	setsockopt(fd, IPPROTO_IP, IP_TOS, &tos, sizeof(tos));
+	return fd;
+}
+
+// Sends one datagram and clears the motion it carries.
+static void send_packet(int fd, remote_packet_t *packet, unsigned long *sent) {
+	uint8_t buffer[REMOTE_PACKET_SIZE];
+
+	packet->sent_us = monotonic_ns() / 1000ULL;
+	remote_encode(packet, buffer);
+	// Refused while the receiver is down: the next datagrams carry on
+	if (send(fd, buffer, sizeof(buffer), MSG_NOSIGNAL) == (ssize_t)sizeof(buffer)) {
+		(*sent)++;
+	}
+	packet->seq++;
+	packet->dx = packet->dy = 0;
+}
+
+// Forwards the events of a local device to a receiver.
+int remote_forward(const char *device_path, const char *target) {
+	struct input_event events[64];
+	remote_packet_t packet = { 0, 0, 0, 0, 0, 0 };
+	unsigned long sent = 0;
+	int changed = 0;
+
+	int sock = remote_connect(target);
+	if (sock < 0) {
+		return -1;
+	}
+	int fd = open(device_path, O_RDONLY | O_NONBLOCK);
+	if (fd < 0) {
+		ERROR_PRINT("Cannot open file %s: %s\n", device_path, strerror(errno));
+		close(sock);
+		return -1;
+	}
+
+	// A new session tells the receiver to restart its sequence checks
+	packet.session = (uint32_t)(monotonic_ns() ^ ((uint64_t)getpid() << 16));
+
+	INFO_PRINT("Forwarding %s to %s, press Ctrl+C to stop\n", device_path, target);
+
+	uint64_t last_send_ns = monotonic_ns();
+	while (running) {
+		struct pollfd pfd = { .fd = fd, .events = POLLIN };
+		int ready = poll(&pfd, 1, REMOTE_KEEPALIVE_MS);
+		if (ready < 0 && errno != EINTR) {
+			break;
+		}
+
+		if (ready > 0) {
+			ssize_t bytes_read = read(fd, events, sizeof(events));
+			if (bytes_read <= 0) {
+				if (bytes_read == -1 && (errno == EINTR || errno == EAGAIN)) continue;
+				INFO_PRINT("Mouse device disconnected\n");
+				break;
+			}
+
+			for (size_t i = 0; i < (size_t)bytes_read / sizeof(struct input_event); i++) {
+				const struct input_event *ie = &events[i];
+				if (ie->type == EV_REL && ie->code == REL_X) {
+					packet.dx += ie->value;
+					changed = 1;
+				} else if (ie->type == EV_REL && ie->code == REL_Y) {
+					packet.dy += ie->value;
+					changed = 1;
+				} else if (ie->type == EV_KEY && (ie->code == BTN_LEFT || ie->code == BTN_RIGHT)) {
+					uint8_t bit = (ie->code == BTN_LEFT) ? REMOTE_BUTTON_LEFT : REMOTE_BUTTON_RIGHT;
+					packet.buttons = ie->value ? (packet.buttons | bit) : (packet.buttons & ~bit);
+					changed = 1;
+				} else if (ie->type == EV_SYN && ie->code == SYN_REPORT && changed) {
+					// One datagram per frame, sent as soon as the frame is complete
+					send_packet(sock, &packet, &sent);
+					last_send_ns = monotonic_ns();
+					changed = 0;
+				}
+			}
+		}
+
+		// Keep-alive: lets the receiver tell a held button from a lost sender
+		if (monotonic_ns() - last_send_ns >= REMOTE_KEEPALIVE_MS * 1000000ULL) {
+			send_packet(sock, &packet, &sent);
+			last_send_ns = monotonic_ns();
+		}
+	}
+
+	// Release the buttons on the receiver side
+	packet.buttons = 0;
+	send_packet(sock, &packet, &sent);
+
+	close(fd);
+	close(sock);
+	INFO_PRINT("%lu datagrams sent\n", sent);
+	return 0;
+}
@@ -0,0 +1,285 @@
+/**
+ * @file replay.c
+ * @brief Records input event streams and replays them deterministically.
+ *
+ * Recordings hold the raw input_event stream of a device with its original
+ * timestamps. They can be fed back straight into the event pipeline, or
+ * through a uinput virtual mouse, at real time, scaled or maximum speed.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/ioctl.h>
+#include <sys/select.h>
+#include <linux/uinput.h>
+
+#include "replay.h"
+#include "global.h"
+
+
+// Reads CLOCK_MONOTONIC in nanoseconds.
+static uint64_t monotonic_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Sleeps until an absolute CLOCK_MONOTONIC deadline.
+static void sleep_until_ns(uint64_t deadline) {
+	struct timespec ts = {
+		.tv_sec = (time_t)(deadline / 1000000000ULL),
+		.tv_nsec = (long)(deadline % 1000000000ULL)
+	};
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR && running);
+}
+
+// Opens a recording and checks its header.
+static FILE *open_recording(const char *path) {
+	char magic[8];
+
+	FILE *fp = fopen(path, "rb");
+	if (fp == NULL) {
+		ERROR_PRINT("Cannot open recording %s: %s\n", path, strerror(errno));
+		return NULL;
+	}
+
+	if (fread(magic, 1, sizeof(magic), fp) != sizeof(magic) || memcmp(magic, RECORD_MAGIC, sizeof(magic)) != 0) {
+		ERROR_PRINT("%s is not an event recording\n", path);
+		fclose(fp);
+		return NULL;
+	}
+
+	return fp;
+}
+
+// Captures the event stream of an input device into a recording file.
+int record_events(const char *device_path, const char *path) {
+	struct input_event events[64];
+	long count = 0;
+	int failed = 0;
+
+	int fd = open(device_path, O_RDONLY | O_NONBLOCK);
+	if (fd < 0) {
+		ERROR_PRINT("Cannot open file %s: %s\n", device_path, strerror(errno));
+		return -1;
+	}
+
+	FILE *fp = fopen(path, "wb");
+	if (fp == NULL) {
+		ERROR_PRINT("Cannot create recording %s: %s\n", path, strerror(errno));
+		close(fd);
+		return -1;
+	}
+	if (fwrite(RECORD_MAGIC, 1, 8, fp) != 8) {
+		ERROR_PRINT("Cannot write recording %s: %s\n", path, strerror(errno));
+		fclose(fp);
+		close(fd);
+		return -1;
+	}
+
+	INFO_PRINT("Recording %s to %s, press Ctrl+C to stop\n", device_path, path);
+
+	while (running && !failed) {
+		fd_set readfds;
+		struct timeval timeout = { 0, 50000 };
+
+		FD_ZERO(&readfds);
+		FD_SET(fd, &readfds);
+		int select_result = select(fd + 1, &readfds, NULL, NULL, &timeout);
+		if (select_result <= 0) {
+			if (select_result == -1 && errno != EINTR) break;
+			continue;
+		}
+
+		ssize_t bytes_read = read(fd, events, sizeof(events));
+		if (bytes_read <= 0) {
+			if (bytes_read == -1 && (errno == EINTR || errno == EAGAIN)) continue;
+			INFO_PRINT("Mouse device disconnected\n");
+			break;
+		}
+
+		for (size_t i = 0; i < (size_t)bytes_read / sizeof(struct input_event); i++) {
+			record_event_t rec = {
+				.time_us = (uint64_t)events[i].time.tv_sec * 1000000ULL + (uint64_t)events[i].time.tv_usec,
+				.type = events[i].type,
+				.code = events[i].code,
+				.value = events[i].value
+			};
+			if (fwrite(&rec, sizeof(rec), 1, fp) != 1) {
+				ERROR_PRINT("Cannot write recording %s: %s\n", path, strerror(errno));
+				failed = 1;
+				break;
+			}
+			count++;
+		}
+	}
+
+	// Buffered events are only on disk once fclose() succeeds
+	if (fclose(fp) != 0 && !failed) {
+		ERROR_PRINT("Cannot write recording %s: %s\n", path, strerror(errno));
+		failed = 1;
+	}
+	close(fd);
+	if (failed) {
+		ERROR_PRINT("Recording %s is incomplete\n", path);
+		return -1;
+	}
+	INFO_PRINT("%ld events recorded\n", count);
+	return 0;
+}
+
+// Feeds a recording to a handler, paced against the original timestamps.
+long replay_events(const char *path, double speed, replay_handler_t handler, void *ctx) {
+	record_event_t rec;
+	struct input_event ie;
+	uint64_t first_us = 0;
+	uint64_t start_ns = monotonic_ns();
+	long count = 0;
+
+	FILE *fp = open_recording(path);
+	if (fp == NULL) {
+		return -1;
+	}
+
+	while (running && fread(&rec, sizeof(rec), 1, fp) == 1) {
+		if (count == 0) {
+			first_us = rec.time_us;
+		}
+
+		if (speed > 0) {
+			sleep_until_ns(start_ns + (uint64_t)((double)(rec.time_us - first_us) * 1000.0 / speed));
+		}
+
+		memset(&ie, 0, sizeof(ie));
+		ie.time.tv_sec = (time_t)(rec.time_us / 1000000ULL);
+		ie.time.tv_usec = (suseconds_t)(rec.time_us % 1000000ULL);
+		ie.type = rec.type;
+		ie.code = rec.code;
+		ie.value = rec.value;
+		handler(&ie, ctx);
+		count++;
+	}
+
+	fclose(fp);
+	DEBUG_PRINT("%ld events replayed from %s\n", count, path);
+	return count;
+}
+
+// Finds the event device node of a uinput device from its sysfs name.
+static void find_event_node(const char *sysname, char *event_path, size_t size) {
+	char dir_path[128];
+	struct dirent *entry;
+
+	event_path[0] = '\0';
+	snprintf(dir_path, sizeof(dir_path), "/sys/devices/virtual/input/%s", sysname);
+
+	// udev may need a moment to populate the device directory
+	for (int retry = 0; retry < 20 && event_path[0] == '\0'; retry++) {
+		DIR *dir = opendir(dir_path);
+		if (dir != NULL) {
+			while ((entry = readdir(dir)) != NULL) {
+				if (strncmp(entry->d_name, "event", 5) == 0) {
+					snprintf(event_path, size, "/dev/input/%.32s", entry->d_name);
+					break;
+				}
+			}
+			closedir(dir);
+		}
+		if (event_path[0] == '\0') {
+			usleep(50000);
+		}
+	}
+}
+
+// Creates a uinput virtual mouse with relative axes and three buttons.
+int create_uinput_mouse(const char *name, char *event_path, size_t size) {
+	struct uinput_setup setup;
+	char sysname[64];
+
+	int fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+	if (fd < 0) {
+		ERROR_PRINT("Cannot open /dev/uinput: %s\n", strerror(errno));
+		return -1;
+	}
+
+	ioctl(fd, UI_SET_EVBIT, EV_KEY);
+	ioctl(fd, UI_SET_KEYBIT, BTN_LEFT);
+	ioctl(fd, UI_SET_KEYBIT, BTN_RIGHT);
+	ioctl(fd, UI_SET_KEYBIT, BTN_MIDDLE);
+	ioctl(fd, UI_SET_EVBIT, EV_REL);
+	ioctl(fd, UI_SET_RELBIT, REL_X);
+	ioctl(fd, UI_SET_RELBIT, REL_Y);
+	ioctl(fd, UI_SET_RELBIT, REL_WHEEL);
+
+	memset(&setup, 0, sizeof(setup));
+	setup.id.bustype = BUS_VIRTUAL;
+	setup.id.vendor = 0x0001;
+	setup.id.product = 0x0001;
+	snprintf(setup.name, sizeof(setup.name), "%s", name);
+
+	if (ioctl(fd, UI_DEV_SETUP, &setup) < 0 || ioctl(fd, UI_DEV_CREATE) < 0) {
+		ERROR_PRINT("Cannot create uinput device: %s\n", strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	if (ioctl(fd, UI_GET_SYSNAME(sizeof(sysname)), sysname) >= 0) {
+		char node[64];
+		find_event_node(sysname, node, sizeof(node));
+		INFO_PRINT("Virtual mouse created: %s\n", node[0] ? node : sysname);
+		if (event_path != NULL) {
+			snprintf(event_path, size, "%s", node);
+		}
+	} else if (event_path != NULL && size > 0) {
+		event_path[0] = '\0';
+	}
+
+	return fd;
+}
+
+// Destroys a virtual mouse created with create_uinput_mouse().
+void destroy_uinput_mouse(int fd) {
+	if (fd < 0) return;
+	ioctl(fd, UI_DEV_DESTROY);
+	close(fd);
+}
+
+// Forwards one replayed event to the uinput device.
+static void uinput_handler(struct input_event *ie, void *ctx) {
+	int fd = *(int *)ctx;
+
+	// The kernel stamps events written to uinput
+	ie->time.tv_sec = 0;
+	ie->time.tv_usec = 0;
+	if (write(fd, ie, sizeof(*ie)) != sizeof(*ie)) {
+		DEBUG_PRINT("uinput write failed: %s\n", strerror(errno));
+	}
+}
+
+// Replays a recording through a uinput virtual mouse.
+int replay_to_uinput(const char *path, double speed) {
+	int fd = create_uinput_mouse(REPLAY_DEVICE_NAME, NULL, 0);
+	if (fd < 0) {
+		return -1;
+	}
+
+	// Leave time for udev and for the daemon to open the new device
+	sleep(1);
+
+	long count = replay_events(path, speed, uinput_handler, &fd);
+
+	destroy_uinput_mouse(fd);
+	if (count < 0) {
+		return -1;
+	}
+
+	INFO_PRINT("%ld events replayed through uinput\n", count);
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,504 @@
+/**
+ * @file stress.c
+ * @brief Synthetic high-rate input against a daemon under test.
+ *
+ * A uinput mouse sends a deterministic traffic pattern at up to 8000 frames
+ * per second, paced on absolute deadlines so a late frame does not shift
+ * the ones after it. The daemon under test is another instance of this
+ * binary; its control socket is polled without blocking the generator, so
+ * reading its counters does not slow the traffic down.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <linux/input.h>
+
+#include "stress.h"
+#include "config.h"
+#include "gpio_control.h"
+#include "replay.h"
+#include "global.h"
+
+
+// Constant pattern velocity (counts per second), at least one count per frame at 8000 Hz
+#define CONSTANT_SPEED_X 8000
+#define CONSTANT_SPEED_Y 4000
+
+// Circle pattern radius (in counts)
+#define CIRCLE_RADIUS 2000
+
+// Flick pattern: a burst of FLICK_MS at FLICK_SPEED counts per second, every FLICK_PERIOD_MS
+#define FLICK_PERIOD_MS 500
+#define FLICK_MS 40
+#define FLICK_SPEED 60000
+
+// Largest jitter on each axis (in counts)
+#define JITTER_COUNTS 3
+
+// Longest wait for the daemon to drain its backlog once the traffic stops (in milliseconds)
+#define DRAIN_MS 3000
+
+static const char *pattern_names[] = { "constant", "circle", "flick", "jitter", "buttons" };
+
+// Cosine of the circle vertices, 64 per turn (scaled by 4096)
+static const int cosine[64] = {
+	4096, 4076, 4017, 3920, 3784, 3612, 3406, 3166, 2896, 2598, 2276, 1931, 1567, 1189, 799, 401,
+	0, -401, -799, -1189, -1567, -1931, -2276, -2598, -2896, -3166, -3406, -3612, -3784, -3920, -4017, -4076,
+	-4096, -4076, -4017, -3920, -3784, -3612, -3406, -3166, -2896, -2598, -2276, -1931, -1567, -1189, -799, -401,
+	0, 401, 799, 1189, 1567, 1931, 2276, 2598, 2896, 3166, 3406, 3612, 3784, 3920, 4017, 4076
+};
+
+/**
+ * Counters of the daemon under test, from its status line.
+ */
+typedef struct {
+	unsigned long long frames;
+	unsigned long long syn_dropped;
+	unsigned long long motion_p99_us;
+	unsigned long long button_p99_us;
+} daemon_status_t;
+
+/**
+ * Control connection to the daemon under test, with one request in flight.
+ */
+typedef struct {
+	int fd;
+	int pending;			// A status request awaits its reply
+	unsigned long long sent_at;	// Frames sent when the request went out
+	size_t len;
+	char line[512];
+} control_link_t;
+
+
+// Reads CLOCK_MONOTONIC in nanoseconds.
+static uint64_t monotonic_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Parses a pattern name.
+int parse_stress_pattern(const char *name) {
+	for (int i = 0; i < NUM_STRESS_PATTERNS; i++) {
+		if (name != NULL && strcmp(name, pattern_names[i]) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+// Returns the name of a STRESS_* value.
+const char *stress_pattern_name(int pattern) {
+	return pattern_names[pattern];
+}
+
+// Counts moved during frame index at a constant speed, fractions carried over.
+static int constant_counts(int speed, int rate_hz, uint64_t index) {
+	return (int)((index + 1) * (uint64_t)speed / (uint64_t)rate_hz - index * (uint64_t)speed / (uint64_t)rate_hz);
+}
+
+// Position on the circle after frame index, linear between two vertices.
+static void circle_position(int rate_hz, uint64_t index, int *x, int *y) {
+	// Fixed-point turn fraction: 64 vertices of 4096 steps, one turn per second
+	uint64_t phase = (index % (uint64_t)rate_hz) * 64ULL * 4096ULL / (uint64_t)rate_hz;
+	int vertex = (int)(phase / 4096);
+	int frac = (int)(phase % 4096);
+	int next = (vertex + 1) % 64;
+	int cx = cosine[vertex] + (cosine[next] - cosine[vertex]) * frac / 4096;
+	int sx = cosine[(vertex + 48) % 64] + (cosine[(next + 48) % 64] - cosine[(vertex + 48) % 64]) * frac / 4096;
+
+	*x = CIRCLE_RADIUS * cx / 4096;
+	*y = CIRCLE_RADIUS * sx / 4096;
+}
+
+// Computes frame number index of a pattern.
+void stress_frame(int pattern, int rate_hz, uint64_t index, stress_frame_t *frame) {
+	memset(frame, 0, sizeof(*frame));
+
+	switch (pattern) {
+		case STRESS_CONSTANT:
+			frame->dx = constant_counts(CONSTANT_SPEED_X, rate_hz, index);
+			frame->dy = constant_counts(CONSTANT_SPEED_Y, rate_hz, index);
+			break;
+
+		case STRESS_CIRCLE: {
+			int x0, y0, x1, y1;
+			circle_position(rate_hz, index, &x0, &y0);
+			circle_position(rate_hz, index + 1, &x1, &y1);
+			frame->dx = x1 - x0;
+			frame->dy = y1 - y0;
+			break;
+		}
+
+		case STRESS_FLICK: {
+			uint64_t period = (uint64_t)rate_hz * FLICK_PERIOD_MS / 1000;
+			uint64_t burst = (uint64_t)rate_hz * FLICK_MS / 1000;
+			if (period == 0 || index % period < burst) {
+				int direction = ((index / (period ? period : 1)) & 1) ? -1 : 1;
+				frame->dx = direction * constant_counts(FLICK_SPEED, rate_hz, index);
+				frame->dy = constant_counts(FLICK_SPEED / 8, rate_hz, index);
+			}
+			break;
+		}
+
+		case STRESS_JITTER: {
+			// Hash of the index: the same noise on every run
+			uint32_t h = (uint32_t)(index * 2654435761ULL);
+			h ^= h >> 15;
+			h *= 2246822519u;
+			h ^= h >> 13;
+			frame->dx = (int)(h % (2 * JITTER_COUNTS + 1)) - JITTER_COUNTS;
+			frame->dy = (int)((h >> 8) % (2 * JITTER_COUNTS + 1)) - JITTER_COUNTS;
+			if (frame->dx == 0 && frame->dy == 0) {
+				frame->dx = ((h >> 16) & 1) ? 1 : -1;
+			}
+			break;
+		}
+
+		case STRESS_BUTTONS:
+			// Gray sequence: left down, right down, left up, right up
+			frame->buttons = (int)(((index + 1) & 3) ^ (((index + 1) & 3) >> 1));
+			break;
+	}
+
+	// The input core does not deliver empty frames: nothing to send
+	frame->send = (frame->dx != 0 || frame->dy != 0 || pattern == STRESS_BUTTONS);
+}
+
+// Starts this binary as the daemon under test on the virtual mouse.
+static pid_t start_daemon(const char *config_path, const char *event_path, const char *socket_path) {
+	char self[512];
+	const char *argv[16];
+	int argc = 0;
+
+	ssize_t len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+	if (len < 0) {
+		ERROR_PRINT("Cannot locate own binary: %s\n", strerror(errno));
+		return -1;
+	}
+	self[len] = '\0';
+
+	argv[argc++] = self;
+	argv[argc++] = "-c";
+	argv[argc++] = config_path;
+	argv[argc++] = "-D";
+	argv[argc++] = event_path;
+	argv[argc++] = "--control";
+	argv[argc++] = socket_path;
+	if (output_backend == OUTPUT_NULL) {
+		argv[argc++] = "--output";
+		argv[argc++] = "null";
+	} else if (output_backend == OUTPUT_IKBD) {
+		argv[argc++] = "--output";
+		argv[argc++] = "ikbd";
+		argv[argc++] = "--ikbd-tty";
+		argv[argc++] = config.ikbd_device;
+	}
+	argv[argc] = NULL;
+
+	pid_t pid = fork();
+	if (pid == 0) {
+		// Keep the report alone on stdout; errors of the daemon still reach stderr
+		int null_fd = open("/dev/null", O_WRONLY);
+		if (null_fd >= 0) {
+			dup2(null_fd, STDOUT_FILENO);
+			close(null_fd);
+		}
+		execv(self, (char *const *)argv);
+		_exit(127);
+	}
+	if (pid < 0) {
+		ERROR_PRINT("Cannot start daemon under test: %s\n", strerror(errno));
+	}
+	return pid;
+}
+
+// Connects to the control socket of the daemon, waiting for it to come up.
+static int connect_control(const char *socket_path, pid_t pid) {
+	struct sockaddr_un addr;
+	uint64_t deadline = monotonic_ns() + 5000000000ULL;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", socket_path);
+
+	while (monotonic_ns() < deadline && waitpid(pid, NULL, WNOHANG) == 0) {
+		int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (fd < 0) {
+			break;
+		}
+		if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+			return fd;
+		}
+		close(fd);
+		usleep(10000);
+	}
+	ERROR_PRINT("Daemon under test did not open its control socket\n");
+	return -1;
+}
+
+// Reads the value of a key=value field of a status line.
+static unsigned long long status_field(const char *line, const char *key) {
+	char pattern[32];
+	snprintf(pattern, sizeof(pattern), " %s=", key);
+	const char *at = strstr(line, pattern);
+	return at ? strtoull(at + strlen(pattern), NULL, 10) : 0;
+}
+
+// Sends a status request, unless one is already in flight.
+static void request_status(control_link_t *link, unsigned long long sent) {
+	if (link->pending) return;
+	if (send(link->fd, "status\n", 7, MSG_DONTWAIT | MSG_NOSIGNAL) == 7) {
+		link->pending = 1;
+		link->sent_at = sent;
+	}
+}
+
+// Reads the reply to a status request without waiting. Returns 1 once a reply is complete.
+static int poll_status(control_link_t *link, daemon_status_t *status) {
+	if (!link->pending) return 0;
+
+	ssize_t bytes = recv(link->fd, link->line + link->len, sizeof(link->line) - 1 - link->len, MSG_DONTWAIT);
+	if (bytes <= 0) {
+		return 0;
+	}
+	link->len += (size_t)bytes;
+	link->line[link->len] = '\0';
+
+	char *end = strchr(link->line, '\n');
+	if (end == NULL) {
+		if (link->len == sizeof(link->line) - 1) link->len = 0;
+		return 0;
+	}
+	*end = '\0';
+	status->frames = status_field(link->line, "frames");
+	status->syn_dropped = status_field(link->line, "syn_dropped");
+	status->motion_p99_us = status_field(link->line, "motion_p99_us");
+	status->button_p99_us = status_field(link->line, "button_p99_us");
+	link->pending = 0;
+	link->len = 0;
+	return 1;
+}
+
+// Sends a command and waits for its reply.
+static int query(control_link_t *link, const char *command, daemon_status_t *status) {
+	uint64_t deadline = monotonic_ns() + 2000000000ULL;
+	char request[32];
+
+	// Drop a reply still in flight
+	while (link->pending && monotonic_ns() < deadline) {
+		poll_status(link, status);
+		usleep(1000);
+	}
+	snprintf(request, sizeof(request), "%s\n", command);
+	if (send(link->fd, request, strlen(request), MSG_NOSIGNAL) < 0) {
+		return -1;
+	}
+	link->pending = 1;
+	while (monotonic_ns() < deadline) {
+		if (poll_status(link, status)) {
+			return 0;
+		}
+		usleep(1000);
+	}
+	return -1;
+}
+
+// Reads the CPU time of a process (user + system, in clock ticks).
+static unsigned long long process_cpu_ticks(pid_t pid) {
+	char path[64], buffer[1024];
+	unsigned long utime = 0, stime = 0;
+
+	snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+	FILE *fp = fopen(path, "r");
+	if (fp == NULL) {
+		return 0;
+	}
+	size_t len = fread(buffer, 1, sizeof(buffer) - 1, fp);
+	fclose(fp);
+	buffer[len] = '\0';
+
+	// The command name may hold spaces: fields start after its closing parenthesis
+	char *fields = strrchr(buffer, ')');
+	if (fields == NULL || sscanf(fields + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) != 2) {
+		return 0;
+	}
+	return (unsigned long long)utime + stime;
+}
+
+// Writes one frame to the virtual mouse. Returns 0 on success, -1 if uinput refused it.
+static int send_frame(int fd, const stress_frame_t *frame, int *buttons) {
+	struct input_event events[5];
+	int count = 0;
+
+	memset(events, 0, sizeof(events));
+	if (frame->dx) {
+		events[count].type = EV_REL;
+		events[count].code = REL_X;
+		events[count++].value = frame->dx;
+	}
+	if (frame->dy) {
+		events[count].type = EV_REL;
+		events[count].code = REL_Y;
+		events[count++].value = frame->dy;
+	}
+	for (int button = 0; button < 2; button++) {
+		int pressed = (frame->buttons >> button) & 1;
+		if (pressed != ((*buttons >> button) & 1)) {
+			events[count].type = EV_KEY;
+			events[count].code = button ? BTN_RIGHT : BTN_LEFT;
+			events[count++].value = pressed;
+		}
+	}
+	events[count].type = EV_SYN;
+	events[count++].code = SYN_REPORT;
+
+	ssize_t size = (ssize_t)(count * sizeof(events[0]));
+	if (write(fd, events, (size_t)size) != size) {
+		return -1;
+	}
+	*buttons = frame->buttons;
+	return 0;
+}
+
+// Sleeps until an absolute CLOCK_MONOTONIC time.
+static void sleep_until(uint64_t time_ns) {
+	struct timespec ts = {
+		.tv_sec = (time_t)(time_ns / 1000000000ULL),
+		.tv_nsec = (long)(time_ns % 1000000000ULL)
+	};
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR && running);
+}
+
+// Runs the daemon under test on a uinput mouse and sends it a traffic pattern.
+int run_stress(const char *config_path, const stress_params_t *params) {
+	char event_path[64], socket_path[108];
+	control_link_t link = { -1, 0, 0, 0, "" };
+	daemon_status_t base, status;
+	int result = -1;
+
+	int uinput_fd = create_uinput_mouse("Atari USB mouse stress", event_path, sizeof(event_path));
+	if (uinput_fd < 0 || event_path[0] == '\0') {
+		destroy_uinput_mouse(uinput_fd);
+		return -1;
+	}
+
+	snprintf(socket_path, sizeof(socket_path), "/tmp/atari_usb_mouse_stress.%d.sock", (int)getpid());
+	pid_t daemon_pid = start_daemon(config_path, event_path, socket_path);
+	if (daemon_pid < 0) {
+		destroy_uinput_mouse(uinput_fd);
+		return -1;
+	}
+	link.fd = connect_control(socket_path, daemon_pid);
+	if (link.fd < 0 || query(&link, "reset", &status) < 0 || query(&link, "status", &base) < 0) {
+		goto stop;
+	}
+
+	INFO_PRINT("Stress: %s pattern at %d frames/s for %d s on %s\n", stress_pattern_name(params->pattern),
+		params->rate_hz, params->seconds, event_path);
+
+	unsigned long long sent = 0, refused = 0, late = 0, max_backlog = 0;
+	uint64_t period_ns = 1000000000ULL / (uint64_t)params->rate_hz;
+	uint64_t total = (uint64_t)params->rate_hz * (uint64_t)params->seconds;
+	uint64_t sample_ns = STRESS_SAMPLE_MS * 1000000ULL;
+	int buttons = 0;
+	long tick_hz = sysconf(_SC_CLK_TCK);
+	unsigned long long cpu_start = process_cpu_ticks(daemon_pid);
+	uint64_t start = monotonic_ns();
+	uint64_t next_sample = start + sample_ns;
+
+	for (uint64_t index = 0; index < total && running; index++) {
+		uint64_t deadline = start + index * period_ns;
+		sleep_until(deadline);
+
+		uint64_t now = monotonic_ns();
+		if (now > deadline + period_ns) {
+			late++;
+		}
+
+		stress_frame_t frame;
+		stress_frame(params->pattern, params->rate_hz, index, &frame);
+		if (frame.send) {
+			if (send_frame(uinput_fd, &frame, &buttons) == 0) {
+				sent++;
+			} else {
+				refused++;
+			}
+		}
+
+		// Backlog: frames sent when the daemon was asked, not processed when it answered
+		if (poll_status(&link, &status)) {
+			unsigned long long done = status.frames - base.frames;
+			if (link.sent_at > done && link.sent_at - done > max_backlog) {
+				max_backlog = link.sent_at - done;
+			}
+		}
+		if (now >= next_sample) {
+			request_status(&link, sent);
+			next_sample += sample_ns;
+		}
+	}
+
+	// Release the buttons, then let the daemon catch up
+	stress_frame_t idle = { 1, 0, 0, 0 };
+	if (buttons != 0 && send_frame(uinput_fd, &idle, &buttons) == 0) {
+		sent++;
+	}
+	uint64_t traffic_ns = monotonic_ns() - start;
+	uint64_t drain_end = monotonic_ns() + DRAIN_MS * 1000000ULL;
+	unsigned long long previous = ~0ULL;
+	while (monotonic_ns() < drain_end) {
+		if (query(&link, "status", &status) < 0) {
+			ERROR_PRINT("Daemon under test stopped answering\n");
+			goto stop;
+		}
+		if (status.frames - base.frames >= sent || status.frames == previous) {
+			break;
+		}
+		previous = status.frames;
+		usleep(STRESS_SAMPLE_MS * 1000);
+	}
+	unsigned long long cpu_ticks = process_cpu_ticks(daemon_pid) - cpu_start;
+	uint64_t elapsed_ns = monotonic_ns() - start;
+
+	unsigned long long processed = status.frames - base.frames;
+	unsigned long long syn_dropped = status.syn_dropped - base.syn_dropped;
+	double cpu_percent = (tick_hz > 0 && elapsed_ns > 0) ?
+		(double)cpu_ticks * 1e11 / (double)tick_hz / (double)elapsed_ns : 0.0;
+
+	INFO_PRINT("Stress: %llu frames sent in %.2f s (%llu refused by uinput, %llu late), %llu processed, "
+		"%llu lost, %llu SYN_DROPPED, backlog up to %llu frames\n",
+		sent, (double)traffic_ns / 1e9, refused, late, processed, sent > processed ? sent - processed : 0ULL,
+		syn_dropped, max_backlog);
+	INFO_PRINT("Stress: daemon p99 latency %llu us (motion), %llu us (buttons), CPU %.1f%%\n",
+		status.motion_p99_us, status.button_p99_us, cpu_percent);
+
+	printf("{\"stress\":\"%s\",\"rate_hz\":%d,\"seconds\":%d,\"sent\":%llu,\"refused\":%llu,\"late\":%llu,"
+		"\"processed\":%llu,\"lost\":%llu,\"syn_dropped\":%llu,\"max_backlog\":%llu,"
+		"\"motion_p99_us\":%llu,\"button_p99_us\":%llu,\"cpu_percent\":%.1f}\n",
+		stress_pattern_name(params->pattern), params->rate_hz, params->seconds, sent, refused, late,
+		processed, sent > processed ? sent - processed : 0ULL, syn_dropped, max_backlog,
+		status.motion_p99_us, status.button_p99_us, cpu_percent);
+	fflush(stdout);
+	result = 0;
+
+stop:
+	if (link.fd >= 0) {
+		close(link.fd);
+	}
+	kill(daemon_pid, SIGTERM);
+	waitpid(daemon_pid, NULL, 0);
+	destroy_uinput_mouse(uinput_fd);
+	return result;
+}
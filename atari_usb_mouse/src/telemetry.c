@@ -0,0 +1,262 @@
+/**
+ * @file telemetry.c
+ * @brief Machine-readable JSON-lines feed of motion, pulse and latency data.
+ *
+ * Records are serialised by hand into a reusable buffer and queued in a
+ * bounded ring. The ring is drained to stdout only as far as poll() says
+ * the consumer has room, so a slow or stalled consumer only costs dropped
+ * records, never latency. stdout is left blocking: its file description
+ * may be shared with stderr or the shell, and the feed is its only writer.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "telemetry.h"
+#include "gpio_control.h"
+#include "monitor.h"
+#include "latency.h"
+#include "global.h"
+
+
+/**
+ * Motion, pulse and latency data accumulated for one record.
+ *
+ * A record covers a single input frame (events up to SYN_REPORT), or every
+ * frame seen during the aggregation interval when one is configured.
+ */
+typedef struct {
+	uint64_t first_event_ns;	// Input timestamp of the first event of the record
+	uint64_t frame_start_ns;	// Input timestamp of the first event of the current frame
+	uint32_t frames;		// Number of input frames merged into the record
+	int rel_x;			// Sum of raw REL_X deltas
+	int rel_y;			// Sum of raw REL_Y deltas
+	int pulses_x;			// Quadrature steps emitted on the X axis
+	int pulses_y;			// Quadrature steps emitted on the Y axis
+	uint64_t latency_sum_ns;	// Sum of per-frame input-to-output latencies
+	uint64_t latency_max_ns;	// Worst per-frame input-to-output latency
+} telemetry_frame_t;
+
+
+uint64_t telemetry_dropped = 0;
+
+static telemetry_frame_t frame;
+static uint64_t record_seq = 0;
+static uint64_t interval_ns = 0;
+static uint64_t record_open_ns = 0;	// Event clock time at which the pending record started
+static int last_buttons = 0;
+
+// Bounded ring between the event loop and stdout
+static char queue[TELEMETRY_QUEUE_SIZE];
+static size_t queue_head = 0;		// Offset of the first unwritten byte
+static size_t queue_len = 0;		// Number of queued bytes
+static int enabled = 0;
+static int consumer_gone = 0;		// Set once the reader closed the pipe
+
+// Reusable serialisation buffer for one record
+static char record[256];
+
+
+// Converts an input event timestamp to nanoseconds.
+static inline uint64_t timeval_to_ns(const struct timeval *tv) {
+	return (uint64_t)tv->tv_sec * 1000000000ULL + (uint64_t)tv->tv_usec * 1000ULL;
+}
+
+// Appends a string without its terminator.
+static char *put_str(char *p, const char *s) {
+	while (*s) {
+		*p++ = *s++;
+	}
+	return p;
+}
+
+// Appends an unsigned decimal number.
+static char *put_u64(char *p, uint64_t v) {
+	char digits[20];
+	int n = 0;
+
+	do {
+		digits[n++] = (char)('0' + v % 10);
+		v /= 10;
+	} while (v);
+
+	while (n) {
+		*p++ = digits[--n];
+	}
+	return p;
+}
+
+// Appends a signed decimal number.
+static char *put_i64(char *p, int64_t v) {
+	if (v < 0) {
+		*p++ = '-';
+		return put_u64(p, (uint64_t)(-(v + 1)) + 1);
+	}
+	return put_u64(p, (uint64_t)v);
+}
+
+// Copies a serialised record into the ring, or drops it if it does not fit.
+static void queue_record(const char *data, size_t len) {
+	if (consumer_gone || len > sizeof(queue) - queue_len) {
+		telemetry_dropped++;
+		return;
+	}
+
+	size_t tail = (queue_head + queue_len) % sizeof(queue);
+	size_t first = sizeof(queue) - tail;
+	if (first > len) {
+		first = len;
+	}
+	memcpy(queue + tail, data, first);
+	memcpy(queue, data + first, len - first);
+	queue_len += len;
+}
+
+// Serialises the pending record and resets the accumulator.
+static void emit_record(void) {
+	char *p = record;
+
+	p = put_str(p, "{\"seq\":");
+	p = put_u64(p, record_seq++);
+	p = put_str(p, ",\"t\":");
+	p = put_u64(p, frame.first_event_ns);
+	p = put_str(p, ",\"frames\":");
+	p = put_u64(p, frame.frames);
+	p = put_str(p, ",\"dx\":");
+	p = put_i64(p, frame.rel_x);
+	p = put_str(p, ",\"dy\":");
+	p = put_i64(p, frame.rel_y);
+	p = put_str(p, ",\"px\":");
+	p = put_i64(p, frame.pulses_x);
+	p = put_str(p, ",\"py\":");
+	p = put_i64(p, frame.pulses_y);
+	p = put_str(p, ",\"btn\":");
+	p = put_u64(p, (uint64_t)last_buttons);
+	p = put_str(p, ",\"lat_us\":");
+	p = put_u64(p, frame.frames ? frame.latency_sum_ns / frame.frames / 1000 : 0);
+	p = put_str(p, ",\"lat_max_us\":");
+	p = put_u64(p, frame.latency_max_ns / 1000);
+	p = put_str(p, ",\"poll_hz\":");
+	p = put_u64(p, stats.polling_rate_hz);
+	p = put_str(p, ",\"dropped\":");
+	p = put_u64(p, telemetry_dropped);
+	p = put_str(p, "}\n");
+
+	queue_record(record, (size_t)(p - record));
+	memset(&frame, 0, sizeof(frame));
+}
+
+// Prepares the JSON-lines writer on stdout.
+int telemetry_init(unsigned int interval_ms) {
+	interval_ns = (uint64_t)interval_ms * 1000000ULL;
+	memset(&frame, 0, sizeof(frame));
+
+	// A vanished consumer must show up as EPIPE, not kill the daemon
+	signal(SIGPIPE, SIG_IGN);
+
+	enabled = 1;
+	DEBUG_PRINT("JSON-lines telemetry enabled (interval: %u ms)\n", interval_ms);
+	return 0;
+}
+
+// Flushes what the consumer accepts.
+void telemetry_cleanup(void) {
+	if (!enabled) return;
+
+	if (frame.frames) {
+		emit_record();
+	}
+	telemetry_flush();
+	enabled = 0;
+}
+
+// Accounts a motion event of the current frame.
+void telemetry_add_motion(int axis, int rel, int pulses, const struct timeval *event_tv) {
+	if (frame.frame_start_ns == 0) {
+		frame.frame_start_ns = timeval_to_ns(event_tv);
+	}
+
+	if (axis == 0) {
+		frame.rel_x += rel;
+		frame.pulses_x += pulses;
+	} else {
+		frame.rel_y += rel;
+		frame.pulses_y += pulses;
+	}
+}
+
+// Closes the current input frame and queues a record when due.
+void telemetry_frame_end(int buttons, const struct timeval *event_tv) {
+	uint64_t now = event_clock_ns();
+	uint64_t start = frame.frame_start_ns ? frame.frame_start_ns : timeval_to_ns(event_tv);
+	uint64_t latency = (now > start) ? now - start : 0;
+
+	if (frame.frames == 0) {
+		frame.first_event_ns = start;
+		record_open_ns = now;
+	}
+	frame.frames++;
+	frame.frame_start_ns = 0;
+	frame.latency_sum_ns += latency;
+	if (latency > frame.latency_max_ns) {
+		frame.latency_max_ns = latency;
+	}
+	last_buttons = buttons;
+
+	if (interval_ns == 0 || now - record_open_ns >= interval_ns) {
+		emit_record();
+	}
+	telemetry_flush();
+}
+
+// Writes as much queued data as the consumer accepts without blocking.
+void telemetry_flush(void) {
+	// Close an aggregation interval that expired while the input was idle
+	if (interval_ns && frame.frames && event_clock_ns() - record_open_ns >= interval_ns) {
+		emit_record();
+	}
+
+	while (queue_len > 0 && !consumer_gone) {
+		// Writable means room for PIPE_BUF bytes: a write that size does not block
+		struct pollfd pfd = { .fd = STDOUT_FILENO, .events = POLLOUT };
+		if (poll(&pfd, 1, 0) <= 0) {
+			break;
+		}
+
+		struct iovec iov[2];
+		int iovcnt = 1;
+		size_t first = sizeof(queue) - queue_head;
+		size_t length = (queue_len < PIPE_BUF) ? queue_len : PIPE_BUF;
+
+		iov[0].iov_base = queue + queue_head;
+		iov[0].iov_len = (first < length) ? first : length;
+		if (iov[0].iov_len < length) {
+			iov[1].iov_base = queue;
+			iov[1].iov_len = length - iov[0].iov_len;
+			iovcnt = 2;
+		}
+
+		ssize_t written = writev(STDOUT_FILENO, iov, iovcnt);
+		if (written < 0) {
+			if (errno == EINTR) continue;
+			if (errno == EPIPE) {
+				// Reader went away: keep running, count everything as dropped
+				consumer_gone = 1;
+				queue_len = 0;
+			}
+			break;
+		}
+
+		queue_head = (queue_head + (size_t)written) % sizeof(queue);
+		queue_len -= (size_t)written;
+	}
+}
\ No newline at end of file
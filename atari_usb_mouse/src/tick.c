@@ -0,0 +1,202 @@
+/**
+ * @file tick.c
+ * @brief Fixed-rate output: at most one quadrature step per axis and per tick.
+ *
+ * Burst mode emits each event's pulse train as soon as it arrives, so the
+ * output timing follows the input. Here motion is only accumulated by the
+ * event path and a steady ticker drains it, which bounds both the edge rate
+ * seen by the IKBD and the CPU time spent per unit of time.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+
+#include "tick.h"
+#include "monitor.h"
+#include "precision.h"
+#include "global.h"
+
+
+static quadrature_state_t *tick_state = NULL;
+static uint64_t period_ns = 0;
+static int started = 0;
+
+// Steps still to emit on X and Y, protected by lock
+static int pending[2] = { 0, 0 };
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t idle_cond = PTHREAD_COND_INITIALIZER;
+
+// Time of the next tick on the output clock
+static uint64_t next_tick_ns = 0;
+
+static pthread_t thread;
+static int thread_running = 0;
+static int stopping = 0;
+
+
+// Emits one step on every axis with queued motion. Called with lock held.
+static void emit_tick(void) {
+	for (int axis = 0; axis < 2; axis++) {
+		if (pending[axis] != 0) {
+			int direction = (pending[axis] > 0) ? 1 : -1;
+			pending[axis] -= direction;
+			quadrature_step(tick_state, axis, direction);
+		}
+	}
+}
+
+// Sleeps until an absolute CLOCK_MONOTONIC time.
+static void sleep_until(uint64_t time_ns) {
+	struct timespec ts = {
+		.tv_sec = (time_t)(time_ns / 1000000000ULL),
+		.tv_nsec = (long)(time_ns % 1000000000ULL)
+	};
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+// Tick thread of the GPIO backend.
+static void *tick_thread(void *arg) {
+	(void)arg;
+
+	pthread_mutex_lock(&lock);
+	while (!stopping) {
+		if (pending[0] == 0 && pending[1] == 0) {
+			pthread_cond_broadcast(&idle_cond);
+			pthread_cond_wait(&work_cond, &lock);
+			continue;
+		}
+
+		// After an idle period the grid restarts from now
+		uint64_t now = output_clock_ns();
+		if (next_tick_ns < now) {
+			next_tick_ns = now;
+		}
+		uint64_t wake_ns = next_tick_ns;
+		pthread_mutex_unlock(&lock);
+
+		if (wake_ns > now) {
+			sleep_until(wake_ns);
+		}
+
+		pthread_mutex_lock(&lock);
+		emit_tick();
+
+		// Late ticks are not caught up: keep the next one half a period away at least
+		uint64_t emitted = output_clock_ns();
+		next_tick_ns += period_ns;
+		if (next_tick_ns < emitted + period_ns / 2) {
+			next_tick_ns = emitted + period_ns / 2;
+		}
+	}
+	pthread_cond_broadcast(&idle_cond);
+	pthread_mutex_unlock(&lock);
+	return NULL;
+}
+
+// Starts the fixed-rate output.
+int tick_start(quadrature_state_t *state, unsigned int period_us) {
+	tick_state = state;
+	period_ns = (uint64_t)period_us * 1000ULL;
+	pending[0] = pending[1] = 0;
+	next_tick_ns = 0;
+	stopping = 0;
+
+	if (output_backend != OUTPUT_NULL) {
+		sigset_t all, old;
+
+		// Signals stay with the main thread, which owns the running flag
+		sigfillset(&all);
+		pthread_sigmask(SIG_BLOCK, &all, &old);
+		int err = pthread_create(&thread, precision_thread_attr(), tick_thread, NULL);
+		pthread_sigmask(SIG_SETMASK, &old, NULL);
+		if (err != 0) {
+			ERROR_PRINT("Cannot start tick thread: %s\n", strerror(err));
+			return -1;
+		}
+		thread_running = 1;
+	}
+
+	started = 1;
+	DEBUG_PRINT("Fixed-rate output started, one step per axis every %u us\n", period_us);
+	return 0;
+}
+
+// Stops the tick thread.
+void tick_stop(void) {
+	if (!started) return;
+
+	pthread_mutex_lock(&lock);
+	stopping = 1;
+	pending[0] = pending[1] = 0;
+	pthread_cond_signal(&work_cond);
+	pthread_mutex_unlock(&lock);
+
+	if (thread_running) {
+		pthread_join(thread, NULL);
+		thread_running = 0;
+	}
+	started = 0;
+}
+
+// Queues quadrature steps on one axis.
+void tick_add(int axis, int steps) {
+	pthread_mutex_lock(&lock);
+	if (pending[0] == 0 && pending[1] == 0) {
+		// Motion after idle: the first step goes out on the next tick or now
+		uint64_t now = output_clock_ns();
+		if (next_tick_ns < now) {
+			next_tick_ns = now;
+		}
+		pthread_cond_signal(&work_cond);
+	}
+	int total = pending[axis] + steps;
+	if (total > TICK_MAX_PENDING || total < -TICK_MAX_PENDING) {
+		int kept = (total > 0) ? TICK_MAX_PENDING : -TICK_MAX_PENDING;
+		stats.steps_dropped += (unsigned long long)abs(total - kept);
+		total = kept;
+	}
+	pending[axis] = total;
+	pthread_mutex_unlock(&lock);
+}
+
+// Runs the ticks due up to an output clock time (null backend only).
+void tick_advance(uint64_t time_ns) {
+	if (!started || thread_running) return;
+
+	pthread_mutex_lock(&lock);
+	while ((pending[0] != 0 || pending[1] != 0) && next_tick_ns <= time_ns) {
+		output_sync_clock(next_tick_ns);
+		emit_tick();
+		next_tick_ns += period_ns;
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+// Waits until every queued step has been emitted.
+void tick_flush(void) {
+	if (!started) return;
+
+	if (!thread_running) {
+		tick_advance(UINT64_MAX);
+		return;
+	}
+
+	pthread_mutex_lock(&lock);
+	while (!stopping && (pending[0] != 0 || pending[1] != 0)) {
+		pthread_cond_wait(&idle_cond, &lock);
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+// Tells whether the fixed-rate output is running.
+int tick_enabled(void) {
+	return started;
+}
@@ -0,0 +1,270 @@
+/**
+ * @file vcd.c
+ * @brief Value Change Dump of the mouse lines, for GTKWave or sigrok.
+ *
+ * The output path only copies each transition into a bounded queue under
+ * a mutex nobody else holds for long. A writer thread wakes when the queue
+ * is half full or every VCD_DRAIN_MS, takes the whole queue at once and
+ * formats it into the file outside the lock, so text formatting and disk
+ * I/O never delay an edge.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+
+#include "vcd.h"
+#include "gpio_control.h"
+#include "precision.h"
+#include "global.h"
+
+
+// Wire names and VCD identifiers, in line order
+static const char *line_names[NUM_LINES] = { "XA", "XB", "YA", "YB", "LEFT", "RIGHT" };
+static const char line_ids[NUM_LINES] = { '!', '"', '#', '$', '%', '&' };
+
+static FILE *file = NULL;
+static char file_path[PATH_MAX];
+static pthread_t thread;
+static int thread_running = 0;
+static uint64_t origin_ns = 0;		// Output clock time of #0, set by the first transition
+static int origin_set = 0;
+static uint64_t last_time_ns = 0;
+static int wait_for_room = 0;
+
+// Levels as last written to the file, owned by the writer
+static uint32_t written_levels = 0;
+
+// Transitions not written yet, protected by lock
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_cond;
+static pthread_cond_t room_cond = PTHREAD_COND_INITIALIZER;
+static edge_record_t queue[VCD_QUEUE_SIZE];
+static size_t queue_head = 0;		// Index of the oldest queued transition
+static size_t queued = 0;
+static int stopping = 0;
+static unsigned long long written = 0;
+static unsigned long long dropped = 0;
+
+// Transitions taken from the queue by the writer
+static edge_record_t batch[VCD_QUEUE_SIZE];
+
+
+// Appends an unsigned decimal number.
+static char *put_u64(char *p, uint64_t v) {
+	char digits[20];
+	int n = 0;
+
+	do {
+		digits[n++] = (char)('0' + v % 10);
+		v /= 10;
+	} while (v);
+	while (n) {
+		*p++ = digits[--n];
+	}
+	return p;
+}
+
+// Formats one transition as VCD text.
+size_t vcd_format_change(char *buffer, uint64_t time_ns, uint64_t *last_ns, uint32_t levels, uint32_t changed) {
+	char *p = buffer;
+
+	// Timestamps only move forward: a transition stamped earlier joins the last one
+	if (time_ns > *last_ns) {
+		*p++ = '#';
+		p = put_u64(p, time_ns);
+		*p++ = '\n';
+		*last_ns = time_ns;
+	}
+	for (int line = 0; line < NUM_LINES; line++) {
+		if (changed & (1u << line)) {
+			*p++ = (levels & (1u << line)) ? '1' : '0';
+			*p++ = line_ids[line];
+			*p++ = '\n';
+		}
+	}
+	return (size_t)(p - buffer);
+}
+
+// Writes the header and the initial levels.
+static void write_header(uint32_t levels) {
+	time_t now = time(NULL);
+	char date[64];
+
+	strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", localtime(&now));
+	fprintf(file, "$date %s $end\n", date);
+	fprintf(file, "$version atari_usb_mouse %s $end\n", VERSION);
+	fprintf(file, "$timescale 1ns $end\n");
+	fprintf(file, "$scope module atari_mouse $end\n");
+	for (int line = 0; line < NUM_LINES; line++) {
+		fprintf(file, "$var wire 1 %c %s $end\n", line_ids[line], line_names[line]);
+	}
+	fprintf(file, "$upscope $end\n$enddefinitions $end\n#0\n$dumpvars\n");
+	for (int line = 0; line < NUM_LINES; line++) {
+		fprintf(file, "%c%c\n", (levels & (1u << line)) ? '1' : '0', line_ids[line]);
+	}
+	fprintf(file, "$end\n");
+}
+
+// Formats a batch of transitions into the file.
+static void write_batch(size_t count) {
+	char text[32 + 4 * NUM_LINES];
+
+	for (size_t i = 0; i < count; i++) {
+		// Against the file rather than the record: a dropped record must not leave a line wrong
+		uint32_t changed = batch[i].lines ^ written_levels;
+		if (changed == 0) {
+			continue;
+		}
+		written_levels = batch[i].lines;
+
+		if (!origin_set) {
+			origin_ns = batch[i].time_ns - VCD_LEAD_NS;
+			origin_set = 1;
+		}
+		uint64_t time_ns = (batch[i].time_ns > origin_ns) ? batch[i].time_ns - origin_ns : 0;
+		size_t length = vcd_format_change(text, time_ns, &last_time_ns, batch[i].lines, changed);
+		fwrite(text, 1, length, file);
+	}
+}
+
+// Writer: takes the whole queue when half full or every VCD_DRAIN_MS.
+static void *writer_thread(void *arg) {
+	(void)arg;
+	struct timespec deadline;
+
+	pthread_mutex_lock(&lock);
+	for (;;) {
+		if (!stopping && queued < VCD_QUEUE_SIZE / 2) {
+			clock_gettime(CLOCK_MONOTONIC, &deadline);
+			deadline.tv_nsec += VCD_DRAIN_MS * 1000000L;
+			deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+			deadline.tv_nsec %= 1000000000L;
+			pthread_cond_timedwait(&work_cond, &lock, &deadline);
+		}
+
+		size_t count = queued;
+		size_t first = VCD_QUEUE_SIZE - queue_head;
+		if (first > count) first = count;
+		memcpy(batch, queue + queue_head, first * sizeof(batch[0]));
+		memcpy(batch + first, queue, (count - first) * sizeof(batch[0]));
+		queue_head = (queue_head + count) % VCD_QUEUE_SIZE;
+		queued = 0;
+		written += count;
+		int stop = stopping;
+		pthread_cond_broadcast(&room_cond);
+		pthread_mutex_unlock(&lock);
+
+		write_batch(count);
+		if (stop) {
+			return NULL;
+		}
+		pthread_mutex_lock(&lock);
+	}
+}
+
+// Creates a VCD file with one wire per mouse line and starts its writer.
+int vcd_open(const char *path, uint32_t levels, int lossless) {
+	file = fopen(path, "w");
+	if (file == NULL) {
+		ERROR_PRINT("Cannot create VCD file %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	snprintf(file_path, sizeof(file_path), "%s", path);
+	write_header(levels);
+
+	written_levels = levels;
+	origin_set = 0;
+	last_time_ns = 0;
+	wait_for_room = lossless;
+	queue_head = queued = 0;
+	written = dropped = 0;
+	stopping = 0;
+
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&work_cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	// Signals stay with the main thread, which owns the running flag
+	sigset_t all, old;
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+	int err = pthread_create(&thread, precision_thread_attr(), writer_thread, NULL);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (err != 0) {
+		ERROR_PRINT("Cannot start VCD writer: %s\n", strerror(err));
+		fclose(file);
+		file = NULL;
+		return -1;
+	}
+	thread_running = 1;
+
+	DEBUG_PRINT("VCD dump written to %s\n", path);
+	return 0;
+}
+
+// Queues a line transition.
+void vcd_record(uint64_t time_ns, uint32_t levels, uint32_t changed) {
+	if (!thread_running) return;
+
+	pthread_mutex_lock(&lock);
+	while (wait_for_room && queued == VCD_QUEUE_SIZE && !stopping) {
+		pthread_cond_signal(&work_cond);
+		pthread_cond_wait(&room_cond, &lock);
+	}
+	if (queued == VCD_QUEUE_SIZE) {
+		// Live output: losing a trace record beats delaying an edge
+		dropped++;
+	} else {
+		edge_record_t *rec = &queue[(queue_head + queued) % VCD_QUEUE_SIZE];
+		rec->time_ns = time_ns;
+		rec->lines = levels;
+		rec->changed = changed;
+		if (++queued == VCD_QUEUE_SIZE / 2) {
+			pthread_cond_signal(&work_cond);
+		}
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+// Writes the queued transitions, stops the writer and closes the file.
+void vcd_close(void) {
+	if (!thread_running) return;
+
+	pthread_mutex_lock(&lock);
+	stopping = 1;
+	pthread_cond_signal(&work_cond);
+	pthread_mutex_unlock(&lock);
+	pthread_join(thread, NULL);
+	thread_running = 0;
+	pthread_cond_destroy(&work_cond);
+
+	// Close the last transition so viewers show it with some width
+	fprintf(file, "#%llu\n", (unsigned long long)last_time_ns + 1);
+
+	// Buffered text is only on disk once fclose() succeeds
+	int failed = ferror(file);
+	if (fclose(file) != 0) {
+		failed = 1;
+	}
+	file = NULL;
+	if (failed) {
+		ERROR_PRINT("Cannot write VCD dump %s: %s\n", file_path, strerror(errno));
+		ERROR_PRINT("VCD dump %s is incomplete\n", file_path);
+	}
+
+	if (dropped) {
+		ERROR_PRINT("VCD dump: %llu transitions written, %llu dropped (queue full)\n", written, dropped);
+	} else {
+		DEBUG_PRINT("VCD dump: %llu transitions written\n", written);
+	}
+}
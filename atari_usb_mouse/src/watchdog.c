@@ -0,0 +1,245 @@
+/**
+ * @file watchdog.c
+ * @brief systemd readiness and watchdog, and pipeline stall detection.
+ *
+ * Notifications are sent on $NOTIFY_SOCKET directly, as sd_notify() does,
+ * to avoid a dependency on libsystemd. Stages mark themselves busy with a
+ * coarse timestamp (no system call on the hot path), and a low-rate thread
+ * reports those that stay busy too long without progress.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "watchdog.h"
+#include "precision.h"
+#include "global.h"
+
+
+static const char *stage_names[NUM_STAGES] = { "Input", "Output" };
+
+// Start of the busy period of every stage, in coarse microseconds (0 = idle)
+static volatile uint32_t busy_since[NUM_STAGES];
+
+// Busy period already reported as stalled: the stage is stalled while it lasts
+static volatile uint32_t stalled_at[NUM_STAGES];
+
+static unsigned int stall_counts[NUM_STAGES];
+static uint32_t stall_threshold_us = 0;
+
+// Stall detector thread
+static pthread_t thread;
+static int thread_running = 0;
+static int stopping = 0;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t stop_cond;
+
+// systemd notification socket, -1 when not started with Type=notify
+static int notify_fd = -1;
+static struct sockaddr_un notify_addr;
+static socklen_t notify_len;
+
+// Watchdog ping period, 0 when the watchdog is disabled
+static uint64_t ping_interval_ns = 0;
+static uint64_t next_ping_ns = 0;
+
+
+// Reads CLOCK_MONOTONIC_COARSE in nanoseconds (no system call, tick resolution).
+static uint64_t coarse_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Returns a busy timestamp: coarse microseconds, wrapping, never 0.
+static uint32_t busy_stamp(void) {
+	uint32_t now = (uint32_t)(coarse_ns() / 1000ULL);
+	return now ? now : 1;
+}
+
+// Reports the end of a stall when a busy period ends.
+static void end_busy(int stage, uint32_t since, uint32_t now) {
+	if (since != 0 && since == stalled_at[stage]) {
+		INFO_PRINT("%s stage recovered after %u us\n", stage_names[stage], now - since);
+	}
+}
+
+// Marks a stage busy from now.
+void stall_enter(int stage) {
+	if (stall_threshold_us) {
+		busy_since[stage] = busy_stamp();
+	}
+}
+
+// Marks a stage idle, reporting the end of a stall.
+void stall_leave(int stage) {
+	uint32_t since = busy_since[stage];
+	if (since == 0) {
+		return;
+	}
+	busy_since[stage] = 0;
+	end_busy(stage, since, busy_stamp());
+}
+
+// Restarts the stall deadline of a busy stage that made progress.
+void stall_progress(int stage) {
+	uint32_t since = busy_since[stage];
+	if (since == 0) {
+		return;
+	}
+	uint32_t now = busy_stamp();
+	busy_since[stage] = now;
+	end_busy(stage, since, now);
+}
+
+// Reports stages busy for longer than the threshold.
+static void *detector_thread(void *arg) {
+	(void)arg;
+	uint64_t interval_ns = (uint64_t)stall_threshold_us * 500ULL;
+	struct timespec deadline;
+
+	pthread_mutex_lock(&lock);
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	while (!stopping) {
+		deadline.tv_nsec += (long)(interval_ns % 1000000000ULL);
+		deadline.tv_sec += (time_t)(interval_ns / 1000000000ULL) + deadline.tv_nsec / 1000000000L;
+		deadline.tv_nsec %= 1000000000L;
+		pthread_cond_timedwait(&stop_cond, &lock, &deadline);
+
+		uint32_t now = busy_stamp();
+		for (int stage = 0; stage < NUM_STAGES; stage++) {
+			uint32_t since = busy_since[stage];
+			if (since != 0 && since != stalled_at[stage] && now - since > stall_threshold_us) {
+				stalled_at[stage] = since;
+				stall_counts[stage]++;
+				ERROR_PRINT("%s stage stalled: busy for %u us without progress\n", stage_names[stage], now - since);
+			}
+		}
+	}
+	pthread_mutex_unlock(&lock);
+	return NULL;
+}
+
+// Opens the systemd notification socket named by $NOTIFY_SOCKET.
+static void open_notify_socket(void) {
+	const char *path = getenv("NOTIFY_SOCKET");
+	if (path == NULL || path[0] == '\0' || strlen(path) >= sizeof(notify_addr.sun_path)) {
+		return;
+	}
+
+	memset(&notify_addr, 0, sizeof(notify_addr));
+	notify_addr.sun_family = AF_UNIX;
+	memcpy(notify_addr.sun_path, path, strlen(path));
+	notify_len = (socklen_t)(offsetof(struct sockaddr_un, sun_path) + strlen(path));
+	if (path[0] == '@') {
+		notify_addr.sun_path[0] = '\0';	// Abstract namespace
+	}
+
+	notify_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (notify_fd < 0) {
+		ERROR_PRINT("Cannot create notification socket: %s\n", strerror(errno));
+	}
+}
+
+// Starts the stall detector and reads the systemd watchdog period.
+int watchdog_init(int stall_us) {
+	open_notify_socket();
+
+	// The watchdog belongs to the main process only
+	const char *usec = getenv("WATCHDOG_USEC");
+	const char *pid = getenv("WATCHDOG_PID");
+	if (notify_fd >= 0 && usec != NULL && (pid == NULL || atoi(pid) == getpid())) {
+		ping_interval_ns = strtoull(usec, NULL, 10) * 1000ULL / 2;
+		DEBUG_PRINT("systemd watchdog enabled, ping every %llu ms\n",
+			(unsigned long long)(ping_interval_ns / 1000000ULL));
+	}
+
+	if (stall_us <= 0) {
+		return 0;
+	}
+	stall_threshold_us = (uint32_t)stall_us;
+
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&stop_cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	// Signals stay with the main thread, which owns the running flag
+	sigset_t all, old;
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+	int err = pthread_create(&thread, precision_thread_attr(), detector_thread, NULL);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (err != 0) {
+		ERROR_PRINT("Cannot start stall detector: %s\n", strerror(err));
+		stall_threshold_us = 0;
+		return -1;
+	}
+	thread_running = 1;
+	DEBUG_PRINT("Stall detector started, threshold %d us\n", stall_us);
+	return 0;
+}
+
+// Stops the stall detector and closes the notification socket.
+void watchdog_cleanup(void) {
+	if (thread_running) {
+		pthread_mutex_lock(&lock);
+		stopping = 1;
+		pthread_cond_signal(&stop_cond);
+		pthread_mutex_unlock(&lock);
+		pthread_join(thread, NULL);
+		thread_running = 0;
+
+		if (stall_counts[STAGE_INPUT] || stall_counts[STAGE_OUTPUT]) {
+			INFO_PRINT("Stalls: input %u, output %u\n", stall_counts[STAGE_INPUT], stall_counts[STAGE_OUTPUT]);
+		}
+	}
+	stall_threshold_us = 0;
+
+	if (notify_fd >= 0) {
+		close(notify_fd);
+		notify_fd = -1;
+	}
+}
+
+// Sends a state string to systemd.
+void watchdog_notify(const char *state) {
+	if (notify_fd < 0) {
+		return;
+	}
+	if (sendto(notify_fd, state, strlen(state), MSG_NOSIGNAL, (struct sockaddr *)&notify_addr, notify_len) < 0) {
+		DEBUG_PRINT("Cannot notify systemd: %s\n", strerror(errno));
+	}
+}
+
+// Pings the systemd watchdog, unless a stage is stalled.
+void watchdog_ping(void) {
+	if (ping_interval_ns == 0) {
+		return;
+	}
+
+	uint64_t now = coarse_ns();
+	if (now < next_ping_ns) {
+		return;
+	}
+	for (int stage = 0; stage < NUM_STAGES; stage++) {
+		uint32_t since = busy_since[stage];
+		if (since != 0 && since == stalled_at[stage]) {
+			return;
+		}
+	}
+	watchdog_notify("WATCHDOG=1");
+	next_ping_ns = now + ping_interval_ns;
+}